@@ -0,0 +1,97 @@
+/** @file BufferPool.hpp
+  *
+  * A bounded pool of aligned I/O buffers shared between a reader
+  * and its consumers.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_BUFFERPOOL_HPP_
+#define _VOLGEN_BUFFERPOOL_HPP_
+
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+namespace volgen {
+
+
+/**  A fixed number of aligned buffers. get() blocks until a buffer
+  *  is returned to the pool, which bounds the memory in flight and
+  *  applies back pressure to the producer.
+ **/
+class BufferPool {
+
+  public:
+
+    BufferPool ( size_t count, size_t bufsz, size_t align = 4096 )
+        : _bufsz(bufsz)
+    {
+        for ( size_t i = 0; i < count; ++i ) {
+            void * buf = NULL;
+            if ( ::posix_memalign(&buf, align, bufsz) == 0 )
+                _bufs.push_back((char*) buf);
+        }
+        _free = _bufs;
+    }
+
+    ~BufferPool()
+    {
+        for ( size_t i = 0; i < _bufs.size(); ++i )
+            ::free(_bufs[i]);
+    }
+
+    BufferPool ( const BufferPool & ) = delete;
+    BufferPool& operator= ( const BufferPool & ) = delete;
+
+    char* get()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _cond.wait(lock, [this]{ return ! _free.empty(); });
+
+        char * buf = _free.back();
+        _free.pop_back();
+
+        return buf;
+    }
+
+    void put ( char * buf )
+    {
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _free.push_back(buf);
+        }
+        _cond.notify_one();
+    }
+
+    size_t bufsize() const { return _bufsz; }
+    size_t count() const   { return _bufs.size(); }
+
+  private:
+
+    std::vector<char*>       _bufs;
+    std::vector<char*>       _free;
+    std::mutex               _lock;
+    std::condition_variable  _cond;
+    size_t                   _bufsz;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_BUFFERPOOL_HPP_
@@ -44,7 +44,15 @@ class DirNode {
 
   public:
 
-    DirNode() : dnodesz(VOLGEN_NODESIZE) {}
+    DirNode()
+        : dnodesz(VOLGEN_NODESIZE),
+          tdsize(0),
+          tfsize(0),
+          tfiles(0),
+          tdirs(0),
+          tcsize(0),
+          ratio(1.0)
+    {}
 
     uint64_t getFileSize() const
     {
@@ -87,6 +95,18 @@ class DirNode {
     FileNodeSet  files;
     uint32_t     dnodesz;
 
+    /* rolled-up totals for the subtree rooted at this node,
+     * maintained by VolGen::rollup() and VolGen::adjustSizes() */
+    uint64_t     tdsize;
+    uint64_t     tfsize;
+    uint64_t     tfiles;
+    uint64_t     tdirs;
+
+    /* estimated compressed subtree size and the sampled compression
+     * ratio of this directory's files, set by VolGen::estimate() */
+    uint64_t     tcsize;
+    float        ratio;
+
 };
 
 }  // namespace
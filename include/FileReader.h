@@ -0,0 +1,85 @@
+/**
+  * @file FileReader.h
+  *
+  * Sequential, large block file reader used for hashing and copying
+  * volume contents with minimal page cache disruption.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_FILEREADER_H_
+#define _VOLGEN_FILEREADER_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <string>
+
+
+namespace volgen {
+
+
+#define VOLGEN_IOALIGN        4096
+#define VOLGEN_READ_BUFSZ     (4 * 1024 * 1024)
+#define VOLGEN_READAHEAD      4
+#define VOLGEN_DIRECTIO_MIN   (256ULL * 1024 * 1024)
+
+
+/**  Reads a file front to back in large aligned chunks, either into
+  *  its own buffer or into caller provided aligned buffers (a reader
+  *  created with a zero buffer size has none of its own). Files at
+  *  or above VOLGEN_DIRECTIO_MIN are read with O_DIRECT where the
+  *  filesystem allows it. Smaller files are read through the page
+  *  cache with sequential readahead hints, dropping consumed pages
+  *  behind the reader so a full pass does not evict the cache.
+ **/
+class FileReader {
+
+  public:
+
+    explicit FileReader ( size_t bufsz = VOLGEN_READ_BUFSZ );
+    ~FileReader();
+
+    FileReader ( const FileReader & ) = delete;
+    FileReader& operator= ( const FileReader & ) = delete;
+
+    bool         open  ( const std::string & path, bool direct = true );
+    void         close();
+
+    ssize_t      read  ( const char ** data );
+    ssize_t      read  ( char * buf, size_t bufsz );
+
+    const struct stat&  getStat() const  { return _sb; }
+    uint64_t            getOffset() const { return _offset; }
+    bool                isDirect() const  { return _direct; }
+    int                 getError() const  { return _errno; }
+
+  private:
+
+    int          _fd;
+    char *       _buf;
+    size_t       _bufsz;
+    uint64_t     _offset;
+    bool         _direct;
+    int          _errno;
+    struct stat  _sb;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_FILEREADER_H_
@@ -0,0 +1,95 @@
+/**
+  * @file OutputWriter.h
+  *
+  * Buffered writer for machine readable output.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_OUTPUTWRITER_H_
+#define _VOLGEN_OUTPUTWRITER_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_OUTPUT_BUFSZ   (1024 * 1024)
+
+
+enum OutputFormat {
+    VOLGEN_FORMAT_TEXT = 0,
+    VOLGEN_FORMAT_JSON,
+    VOLGEN_FORMAT_NDJSON,
+    VOLGEN_FORMAT_CSV
+};
+
+
+/**  Writes to a file descriptor through a large buffer, formatting
+  *  numbers with std::to_chars and quoting strings for JSON or CSV
+  *  directly into the buffer. Nothing is formatted by iostreams.
+ **/
+class OutputWriter {
+
+  public:
+
+    explicit OutputWriter ( int fd = 1, size_t bufsz = VOLGEN_OUTPUT_BUFSZ );
+    ~OutputWriter();
+
+    OutputWriter ( const OutputWriter & ) = delete;
+    OutputWriter& operator= ( const OutputWriter & ) = delete;
+
+    bool  open   ( const std::string & filename );
+    bool  flush();
+    bool  close();
+
+    OutputWriter&  put    ( char c );
+    OutputWriter&  write  ( const char * str, size_t len );
+    OutputWriter&  write  ( const char * str );
+    OutputWriter&  write  ( const std::string & str );
+    OutputWriter&  number ( uint64_t val );
+    OutputWriter&  number ( double val, int precision );
+
+    OutputWriter&  json   ( const std::string & str );
+    OutputWriter&  csv    ( const std::string & str );
+
+    bool  good() const { return ( _error == 0 ); }
+    int   getError() const { return _error; }
+
+    static int   GetFormat ( const std::string & name );
+
+  private:
+
+    char*  reserve ( size_t len );
+
+  private:
+
+    std::vector<char>  _buf;
+    size_t             _pos;
+    int                _fd;
+    bool               _owned;
+    int                _error;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_OUTPUTWRITER_H_
@@ -0,0 +1,82 @@
+/**
+  * @file ReedSolomon.h
+  *
+  * Systematic Reed-Solomon erasure coding over GF(2^8).
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_REEDSOLOMON_H_
+#define _VOLGEN_REEDSOLOMON_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_RS_MAXSHARDS   256
+
+
+/**  An (N + K) systematic erasure code. The encoding matrix is the
+  *  identity for the N data shards followed by a K x N Cauchy matrix
+  *  for the parity shards, so any N of the N + K shards recover the
+  *  data. Region arithmetic uses split nibble lookup tables with an
+  *  AVX2 or SSSE3 shuffle kernel when the CPU supports it, selected
+  *  once at runtime, and a scalar table otherwise.
+ **/
+class ReedSolomon {
+
+  public:
+
+    ReedSolomon ( int ndata, int nparity );
+
+    int      getDataShards() const   { return _ndata; }
+    int      getParityShards() const { return _nparity; }
+
+    void     encode  ( const uint8_t * const * data, uint8_t ** parity,
+                       size_t len ) const;
+
+    bool     decodeRow ( const std::vector<int> & shards, int target,
+                         std::vector<uint8_t> & coeffs ) const;
+
+    static void         Combine ( const uint8_t * coeffs, const uint8_t * const * src,
+                                  int nsrc, uint8_t * dst, size_t len );
+    static void         MulAdd  ( uint8_t c, const uint8_t * src, uint8_t * dst,
+                                  size_t len );
+    static const char*  GetKernelName();
+
+    static uint8_t      Mul ( uint8_t a, uint8_t b );
+    static uint8_t      Inv ( uint8_t a );
+
+  private:
+
+    uint8_t  getRow ( int shard, int col ) const;
+
+  private:
+
+    int                   _ndata;
+    int                   _nparity;
+    std::vector<uint8_t>  _matrix;   // K x N parity rows
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_REEDSOLOMON_H_
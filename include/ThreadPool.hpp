@@ -0,0 +1,148 @@
+/** @file ThreadPool.hpp
+  *
+  * A simple fixed size pool of worker threads used by VolGen for
+  * running independent tasks in parallel.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_THREADPOOL_HPP_
+#define _VOLGEN_THREADPOOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace volgen {
+
+
+/**  A fixed set of worker threads servicing a FIFO task queue.
+  *  The queue depth may be bounded, in which case push() blocks
+  *  until a slot is available; this keeps producers from running
+  *  arbitrarily far ahead of the workers.
+ **/
+class ThreadPool {
+
+  public:
+
+    typedef std::function<void()>  Task;
+
+    explicit ThreadPool ( size_t nthreads = 0, size_t maxq = 0 )
+        : _maxq(maxq),
+          _active(0),
+          _stop(false)
+    {
+        if ( nthreads == 0 )
+            nthreads = ThreadPool::DefaultThreads();
+
+        for ( size_t i = 0; i < nthreads; ++i )
+            _threads.emplace_back(&ThreadPool::run, this);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _space.notify_all();
+
+        for ( size_t i = 0; i < _threads.size(); ++i )
+            _threads[i].join();
+    }
+
+    ThreadPool ( const ThreadPool & ) = delete;
+    ThreadPool& operator= ( const ThreadPool & ) = delete;
+
+    void push ( Task task )
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        if ( _maxq > 0 )
+            _space.wait(lock, [this]{ return _stop || _tasks.size() < _maxq; });
+
+        _tasks.push_back(std::move(task));
+        _cond.notify_one();
+    }
+
+    /**  Blocks until the queue is drained and all workers are idle */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _idle.wait(lock, [this]{ return _tasks.empty() && _active == 0; });
+    }
+
+    size_t size() const { return _threads.size(); }
+
+    static size_t DefaultThreads()
+    {
+        size_t n = std::thread::hardware_concurrency();
+        return ( n == 0 ) ? 1 : n;
+    }
+
+  private:
+
+    void run()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                _cond.wait(lock, [this]{ return _stop || ! _tasks.empty(); });
+
+                if ( _tasks.empty() )
+                    return;
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+                _active++;
+            }
+            _space.notify_one();
+
+            task();
+
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                _active--;
+                if ( _tasks.empty() && _active == 0 )
+                    _idle.notify_all();
+            }
+        }
+    }
+
+  private:
+
+    std::vector<std::thread>  _threads;
+    std::deque<Task>          _tasks;
+    std::mutex                _lock;
+    std::condition_variable   _cond;
+    std::condition_variable   _space;
+    std::condition_variable   _idle;
+    size_t                    _maxq;
+    size_t                    _active;
+    bool                      _stop;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_THREADPOOL_HPP_
@@ -0,0 +1,103 @@
+/**
+  * @file VolArchive.h
+  *
+  * Minimal ustar/pax archive support for volume bundles and images.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLARCHIVE_H_
+#define _VOLGEN_VOLARCHIVE_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_TAR_BLOCK       512
+#define VOLGEN_TAR_EOFSZ       (2 * VOLGEN_TAR_BLOCK)
+#define VOLGEN_BUNDLE_NAME     ".volgen_bundle.tar"
+#define VOLGEN_BUNDLE_INDEX    ".volgen_bundle.idx"
+
+
+/**  An entry of a bundle index, giving the offset of a member's
+  *  data within the bundle so it can be extracted with one read.
+ **/
+struct BundleEntry {
+    std::string  name;
+    uint64_t     offset;
+    uint64_t     size;
+
+    BundleEntry() : offset(0), size(0) {}
+};
+
+typedef std::vector<BundleEntry>  BundleIndex;
+
+
+/**  A member of a tar image, with the offset of its data */
+struct TarMember {
+    uint64_t     offset;
+    uint64_t     size;
+    mode_t       mode;
+    time_t       mtime;
+    char         type;
+    std::string  link;
+
+    TarMember() : offset(0), size(0), mode(0644), mtime(0), type('0') {}
+};
+
+typedef std::map<std::string, TarMember>  TarMemberMap;
+
+
+/**  Static helpers for writing and reading tar streams. Headers are
+  *  plain ustar, with a pax extended header preceding any entry whose
+  *  name or size does not fit the ustar fields.
+ **/
+class VolArchive {
+
+  public:
+
+    static void      AddHeader    ( std::string & out, const std::string & name,
+                                    uint64_t size, time_t mtime, mode_t mode,
+                                    char type = '0', const std::string & link = "" );
+    static uint64_t  GetHeaderSize ( const std::string & name, uint64_t size );
+    static uint64_t  GetEntrySize  ( const std::string & name, uint64_t size );
+    static uint64_t  GetPadding    ( uint64_t size );
+
+    static bool      WriteBundle  ( const std::string & bundle,
+                                    const std::string & idxfile,
+                                    const std::vector<std::string> & names,
+                                    const std::vector<std::string> & sources );
+
+    static bool      ReadIndex    ( const std::string & idxfile, BundleIndex & index );
+    static bool      WriteIndex   ( const std::string & idxfile, const BundleIndex & index );
+
+    static uint64_t  GetOctal     ( const char * field, size_t len );
+    static bool      ReadBlock    ( int fd, uint64_t off, char * blk );
+    static bool      ScanImage    ( int fd, TarMemberMap & members );
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLARCHIVE_H_
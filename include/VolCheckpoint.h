@@ -0,0 +1,122 @@
+/**
+  * @file VolCheckpoint.h
+  *
+  * Append-only checkpoint of a directory scan.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLCHECKPOINT_H_
+#define _VOLGEN_VOLCHECKPOINT_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DirNode.hpp"
+
+
+namespace volgen {
+
+
+#define VOLGEN_CKPTFILE        "volgen.ckpt"
+#define VOLGEN_CKPT_MAGIC      "volgen-checkpoint"
+#define VOLGEN_CKPT_VERSION    1
+#define VOLGEN_CKPT_BUFSZ      (1024 * 1024)
+#define VOLGEN_CKPT_INTERVAL   5
+
+
+/**  A directory of the checkpoint, its own files only */
+struct CheckpointDir {
+    uint64_t     size;
+    uint64_t     blks;
+    FileNodeSet  files;
+
+    CheckpointDir() : size(0), blks(0) {}
+};
+
+typedef std::map<std::string, CheckpointDir>  CheckpointMap;
+
+
+/**  Records the progress of a scan as a log of text records, appended
+  *  to the checkpoint file:
+  *
+  *    P <path>                          directory entered (pending)
+  *    D <size> <blks> <nfiles> <path>   directory completed, followed
+  *    F <size> <blks> <link> <name>     by a record of each of its files
+  *    T                                 scan completed
+  *
+  *  A directory is completed only once its whole subtree is, so the
+  *  completed directories are whole subtrees and the pending ones left
+  *  without a D record are the frontier of an interrupted scan. Records
+  *  are buffered and written at most every VOLGEN_CKPT_INTERVAL seconds,
+  *  or when the buffer fills; a record cut short by an interruption is
+  *  discarded on resume.
+ **/
+class VolCheckpoint {
+
+  public:
+
+    VolCheckpoint ( const std::string & filename, const std::string & root,
+                    size_t blksz );
+    ~VolCheckpoint();
+
+    VolCheckpoint ( const VolCheckpoint & ) = delete;
+    VolCheckpoint& operator= ( const VolCheckpoint & ) = delete;
+
+    bool      open     ( bool resume );
+    bool      finish();
+
+    void      begin    ( const std::string & path );
+    void      complete ( const std::string & path, uint64_t size, uint64_t blks,
+                         const DirNode * dnode );
+
+    bool      isComplete ( const std::string & path ) const;
+    bool      isFinished() const   { return _finished; }
+
+    CheckpointMap&  getDirs()      { return _dirs; }
+
+    const std::string&  getFileName() const  { return _filename; }
+    size_t    getCompleted() const { return _completed; }
+    size_t    getPending() const   { return _pending; }
+
+  private:
+
+    bool      load ( off_t & valid );
+    bool      flush ( bool sync );
+
+  private:
+
+    std::string     _filename;
+    std::string     _root;
+    size_t          _blksz;
+    int             _fd;
+    std::string     _buf;
+    time_t          _flushed;
+    CheckpointMap   _dirs;
+    size_t          _completed;
+    size_t          _pending;
+    bool            _finished;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLCHECKPOINT_H_
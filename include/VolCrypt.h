@@ -0,0 +1,152 @@
+/**
+  * @file VolCrypt.h
+  *
+  * Segmented authenticated encryption of volume images.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLCRYPT_H_
+#define _VOLGEN_VOLCRYPT_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "VolIndex.h"
+
+
+namespace volgen {
+
+
+#define VOLGEN_CRYPT_EXT       ".vgc"
+#define VOLGEN_CRYPT_MAGIC     "VGCRYPT1"
+#define VOLGEN_CRYPT_VERSION   2
+#define VOLGEN_CRYPT_SEGMENT   (1024 * 1024)
+#define VOLGEN_CRYPT_HDRSZ     4096
+#define VOLGEN_CRYPT_AADSZ     32
+#define VOLGEN_CRYPT_KEYLEN    32
+#define VOLGEN_CRYPT_NONCELEN  12
+#define VOLGEN_CRYPT_TAGLEN    16
+#define VOLGEN_CRYPT_INDEXSEG  UINT64_MAX
+
+
+/**  AES-256-GCM is chosen where the cpu has AES instructions, as
+  *  ChaCha20-Poly1305 is the faster of the two without them.
+ **/
+enum CryptCipher {
+    VOLGEN_CIPHER_NONE = 0,
+    VOLGEN_CIPHER_AESGCM,
+    VOLGEN_CIPHER_CHACHA,
+    VOLGEN_CIPHER_MAX
+};
+
+
+struct CryptTag {
+    unsigned char  tag[VOLGEN_CRYPT_TAGLEN];
+};
+
+typedef std::vector<CryptTag>  CryptTagList;
+
+
+/**  The first block of an encrypted image. The leading
+  *  VOLGEN_CRYPT_AADSZ bytes (magic, version, cipher, segment size
+  *  and nonce) are authenticated with every segment. The index
+  *  location is filled in once the image is complete.
+ **/
+struct CryptHeader {
+    int            cipher;
+    uint32_t       segsz;
+    unsigned char  nonce[VOLGEN_CRYPT_NONCELEN];
+    uint64_t       indexoff;
+    uint64_t       indexlen;
+    CryptTag       indextag;
+
+    CryptHeader() : cipher(VOLGEN_CIPHER_NONE), segsz(VOLGEN_CRYPT_SEGMENT),
+                    nonce(), indexoff(0), indexlen(0), indextag() {}
+};
+
+
+/**  Encrypts and decrypts images as a sequence of fixed size segments,
+  *  each sealed on its own with a nonce derived from the image nonce
+  *  and the segment number. The tags of the segments and the offset
+  *  and size of each file within the archive are kept in an index,
+  *  sealed as a segment of its own at the end of the image, so a file
+  *  is recovered by decrypting only the segments holding it.
+  *
+  *  An image is laid out as:
+  *
+  *    [header block][segments ...][index, padded to the block size]
+  *
+  *  Segments are stored without their tags, keeping every write of the
+  *  image block aligned. seal() and open() may be called concurrently.
+ **/
+class VolCrypt {
+
+  public:
+
+    VolCrypt();
+    ~VolCrypt();
+
+    VolCrypt ( const VolCrypt & ) = delete;
+    VolCrypt& operator= ( const VolCrypt & ) = delete;
+
+    bool      loadKey   ( const std::string & keyfile );
+    bool      isKeyed() const    { return _keyed; }
+
+    void      setCipher ( int cipher );
+    int       getCipher() const  { return _cipher; }
+
+    bool      initHeader ( CryptHeader & hdr ) const;
+
+    bool      seal ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                     CryptTag & tag ) const;
+    bool      open ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                     const CryptTag & tag ) const;
+
+    bool      extract ( const std::string & image, const std::vector<std::string> & names,
+                        const std::string & outdir ) const;
+
+    static void         PackHeader   ( const CryptHeader & hdr, char * buf );
+    static bool         UnpackHeader ( const char * buf, CryptHeader & hdr );
+    static void         PackIndex    ( std::string & buf, uint64_t length,
+                                       const CryptTagList & tags,
+                                       const IndexEntryList & files );
+    static bool         UnpackIndex  ( const std::string & buf, uint64_t & length,
+                                       CryptTagList & tags, IndexEntryList & files );
+
+    static int          DetectCipher();
+    static bool         HasAesAccel();
+    static const char*  GetCipherName ( int cipher );
+
+  private:
+
+    bool      crypt ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                      unsigned char * tag, bool enc ) const;
+
+  private:
+
+    unsigned char   _key[VOLGEN_CRYPT_KEYLEN];
+    int             _cipher;
+    bool            _keyed;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLCRYPT_H_
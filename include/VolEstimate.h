@@ -0,0 +1,88 @@
+/**
+  * @file VolEstimate.h
+  *
+  * Compressed size estimation by sampling.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLESTIMATE_H_
+#define _VOLGEN_VOLESTIMATE_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "DirNode.hpp"
+
+struct ZSTD_CCtx_s;
+
+
+namespace volgen {
+
+
+#define VOLGEN_SAMPLE_BLOCK    (64 * 1024)
+#define VOLGEN_SAMPLE_PCT      1
+#define VOLGEN_ESTIMATE_LEVEL  1
+#define VOLGEN_ESTIMATE_MARGIN 10
+
+
+/**  Estimates the compression ratio of directories with zstd. The
+  *  files of a run of directories are treated as one stream of bytes,
+  *  from which a block of VOLGEN_SAMPLE_BLOCK is read at every 'stride'
+  *  bytes, so the bytes read are a fixed percentage of the data. A
+  *  directory that receives no sample takes the ratio of its run.
+  *  One instance is used per thread, holding its compression context
+  *  and buffers.
+ **/
+class VolEstimate {
+
+  public:
+
+    explicit VolEstimate ( int pct = VOLGEN_SAMPLE_PCT, int level = VOLGEN_ESTIMATE_LEVEL );
+    ~VolEstimate();
+
+    VolEstimate ( const VolEstimate & ) = delete;
+    VolEstimate& operator= ( const VolEstimate & ) = delete;
+
+    bool      sample ( const std::vector<DirNode*> & dirs );
+
+    uint64_t  getSampled() const     { return _sampled; }
+    uint64_t  getCompressed() const  { return _compressed; }
+    uint64_t  getStride() const      { return _stride; }
+
+  private:
+
+    bool      sampleFile ( const FileNode & file, uint64_t first,
+                           uint64_t & raw, uint64_t & comp );
+
+  private:
+
+    struct ZSTD_CCtx_s *  _cctx;
+    std::vector<char>     _buf;
+    std::vector<char>     _dst;
+    uint64_t              _stride;
+    int                   _level;
+    uint64_t              _sampled;
+    uint64_t              _compressed;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLESTIMATE_H_
@@ -30,8 +30,20 @@
 #include <inttypes.h>
 #include <sys/types.h>
 
+#include <functional>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
 #include "FileNode.hpp"
 #include "DirNode.hpp"
+#include "VolManifest.h"
+#include "VolIndex.h"
+#include "VolEstimate.h"
+#include "VolCheckpoint.h"
+#include "VolProfile.h"
+#include "VolCrypt.h"
 
 #include "HeirarchicalStringTree.hpp"
 using namespace tcanetpp;
@@ -43,38 +55,88 @@ namespace volgen {
 #define VOLGEN_LICENSE       "Copyright (c)2009-2025 Timothy C. Arland <tcarland@gmail.com>"
 
 #define VOLGEN_ARCHIVEDIR    ".volgen"
+#define VOLGEN_PLANFILE      "volgen.plan"
 #define VOLGEN_DEFAULT_NAME  "Volume_"
 #define VOLGEN_VOLUME_MB     4400
 #define VOLGEN_BLOCKSIZE     512
+#define VOLGEN_BUNDLE_MIN    2
+
+
+/**  Volume packing strategies. 'next' fills volumes in tree order,
+  *  keeping directories together; 'ffd' is first-fit decreasing over
+  *  the same items, trading locality for fewer volumes; 'local' packs
+  *  each directory first-fit decreasing into volumes of its own, so
+  *  siblings share volumes and directories span as few as possible.
+ **/
+enum PackStrategy {
+    VOLGEN_PACK_NEXT = 0,
+    VOLGEN_PACK_FFD,
+    VOLGEN_PACK_LOCAL,
+    VOLGEN_PACK_MAX
+};
+
+
+/**  How files are placed in the generated volumes. 'symlink' links
+  *  each item by its absolute path; 'hardlink' and 'reflink' stage
+  *  volumes as real trees, falling back per file to a hard link and
+  *  then a symlink where the filesystem does not allow it.
+ **/
+enum LinkMode {
+    VOLGEN_LINK_SYMLINK = 0,
+    VOLGEN_LINK_HARDLINK,
+    VOLGEN_LINK_REFLINK,
+    VOLGEN_LINK_MAX
+};
 
 
 typedef tcanetpp::HeirarchicalStringTree<DirNode>  DirTree;
 
+struct BundleJob;
+class  OutputWriter;
 
-struct VolumeItem {
-    std::string  fullname;
-    std::string  name;
-    uint64_t     size;
-    float        vratio;
 
-    VolumeItem() : size(0), vratio(0.0) {}
+/**  An item of a volume: a directory subtree, a single file of the
+  *  directory 'node', or the bundle of the small files of 'node'.
+  *  Items refer to the tree rather than holding paths, which are
+  *  materialized by VolGen::getItemPath() and getItemName() when
+  *  needed. The plan is invalidated by any change to the tree.
+ **/
+struct VolumeItem {
+    DirTree::Node *   node;
+    const FileNode *  file;
+    uint64_t          size;
+    bool              bundle;
+
+    VolumeItem() : node(NULL), file(NULL), size(0), bundle(false) {}
+
+    VolumeItem ( DirTree::Node * dnode, const FileNode * fnode,
+                 uint64_t sz, bool isbundle = false )
+        : node(dnode),
+          file(fnode),
+          size(sz),
+          bundle(isbundle)
+    {}
 };
 
-typedef std::list<VolumeItem> ItemList;
+typedef std::vector<VolumeItem> ItemList;
 
 
+/**  A volume of the plan, the range [first, first + count) of the
+  *  item array. Sizes are in bytes.
+ **/
 struct Volume {
     std::string  name;
-    ItemList     items;
+    size_t       first;
+    size_t       count;
     uint64_t     size;
-    float        vtotal;
 
-    Volume() : size(0), vtotal(0.0) {}
+    Volume() : first(0), count(0), size(0) {}
 
-    Volume ( const std::string & vname )
+    Volume ( const std::string & vname, size_t firstitem )
         : name(vname),
-          size(0),
-          vtotal(0.0)
+          first(firstitem),
+          count(0),
+          size(0)
     {}
 
     bool operator< ( const Volume & v ) const
@@ -90,7 +152,111 @@ struct Volume {
     }
 };
 
-typedef std::list<Volume*> VolumeList;
+typedef std::vector<Volume> VolumeList;
+
+
+/**  A volume plan, or the plan of a subtree prior to its merge. Files
+  *  larger than the volume size 'limit' are listed in 'skipped'.
+ **/
+struct VolumePlan {
+    VolumeList                     vols;
+    ItemList                       items;
+    std::vector<const FileNode*>   skipped;
+    uint64_t                       limit;
+    int                            strategy;
+
+    VolumePlan ( uint64_t vlimit = 0, int pack = VOLGEN_PACK_NEXT )
+        : limit(vlimit),
+          strategy(pack)
+    {}
+
+    void swap ( VolumePlan & plan )
+    {
+        vols.swap(plan.vols);
+        items.swap(plan.items);
+        skipped.swap(plan.skipped);
+        std::swap(limit, plan.limit);
+        std::swap(strategy, plan.strategy);
+    }
+};
+
+
+/**  An entry of the tree as reported to a TreeVisitor during read().
+  *  The path is only valid for the duration of the call.
+ **/
+struct TreeEntry {
+    const std::string &  path;
+    uint64_t             size;
+    uint64_t             disksize;
+    bool                 dir;
+    bool                 symlink;
+};
+
+
+enum ItemType {
+    VOLGEN_ITEM_DIR = 0,
+    VOLGEN_ITEM_FILE,
+    VOLGEN_ITEM_BUNDLE
+};
+
+
+/**  An item of a finished volume: its name within the volume and its
+  *  absolute source path (the bundled directory for a bundle).
+ **/
+struct PlanEntry {
+    std::string  name;
+    std::string  path;
+    uint64_t     size;
+    int          type;
+
+    PlanEntry() : size(0), type(VOLGEN_ITEM_FILE) {}
+};
+
+
+/**  A finished volume of a PlanResult */
+struct PlanVolume {
+    std::string             name;
+    uint64_t                size;
+    std::vector<PlanEntry>  entries;
+
+    PlanVolume() : size(0) {}
+};
+
+
+typedef std::function<void(const TreeEntry&)>   TreeVisitor;
+typedef std::function<void(const PlanVolume&)>  VolumeVisitor;
+
+
+/**  The result of VolGen::plan(). It holds its own copies of every
+  *  name and path, so it stays valid when the tree changes or the
+  *  VolGen instance is gone. Results are moved, never copied.
+ **/
+class PlanResult {
+
+  public:
+
+    PlanResult() : _limit(0) {}
+
+    PlanResult ( PlanResult && ) = default;
+    PlanResult& operator= ( PlanResult && ) = default;
+
+    PlanResult ( const PlanResult & ) = delete;
+    PlanResult& operator= ( const PlanResult & ) = delete;
+
+    const std::vector<PlanVolume>&   getVolumes() const { return _vols; }
+    const std::vector<std::string>&  getSkipped() const { return _skipped; }
+    uint64_t                         getLimit() const   { return _limit; }
+    size_t                           size() const       { return _vols.size(); }
+
+  private:
+
+    friend class VolGen;
+
+    std::vector<PlanVolume>    _vols;
+    std::vector<std::string>   _skipped;
+    uint64_t                   _limit;
+
+};
 
 
 
@@ -102,13 +268,37 @@ class VolGen {
     ~VolGen();
 
     bool     read();
+    bool     readPath        ( const std::string & path );
+    bool     updateFile      ( const std::string & fqfn );
+    bool     removePath      ( const std::string & fqfn );
+    void     rollup();
+    bool     estimate();
 
     void     displayTree();
+    void     displayEstimate();
+    void     displayCheckpoint();
+    void     displayProfile();
 
-    void     createVolumes();
-    void     displayVolumes ( bool show = false );
+    void     setTreeVisitor  ( const TreeVisitor & fn );
+    bool     setCheckpoint   ( const std::string & ckptfile, bool resume );
+    void     setProfile      ( size_t topn );
+    PlanResult  plan         ( const VolumeVisitor & fn = VolumeVisitor() );
 
-    void     generateVolumes ( const std::string & volpath );
+    void     createVolumes();
+    bool     createPlan      ( VolumePlan & plan, size_t nthreads );
+    void     compareVolumes  ( std::ostream & strm, const std::vector<size_t> & sizes,
+                               const std::vector<int> & strategies );
+    void     displayVolumes  ( bool show = false );
+    bool     writeOutput     ( OutputWriter & out, int format );
+    bool     writePlan       ( const std::string & planfile );
+
+    bool     generateVolumes ( const std::string & volpath );
+    bool     generateManifests ( const std::string & volpath );
+    bool     generateIndex   ( const std::string & volpath );
+    bool     generateParity  ( const std::string & volpath, int ndata, int nparity );
+    bool     generateImages  ( const std::string & volpath,
+                               const std::vector<std::string> & targets,
+                               const VolCrypt * crypt = NULL, size_t conns = 0 );
     uint64_t getDirSize      ( const std::string & path );
 
     void     setVolumeSize   ( size_t volsz );
@@ -117,31 +307,127 @@ class VolGen {
     void     setBlockSize    ( size_t blksz );
     size_t   getBlockSize() const;
 
+    void     setThreads      ( size_t threads );
+    size_t   getThreads() const;
+
+    void     setReportLimits ( size_t topn, int maxdepth );
+
+    void     setStrategy     ( int strategy );
+    int      getStrategy() const;
+
+    void     setLinkMode     ( int mode );
+    int      getLinkMode() const;
+
+    void     setBundleSize   ( size_t kb );
+    size_t   getBundleSize() const;
+
+    void     setEstimate     ( int margin, int pct = VOLGEN_SAMPLE_PCT );
+    bool     isEstimated() const;
+
     void     setDebug ( bool d );
 
+    void     setExcludePath  ( const std::string & path );
+    bool     isExcluded      ( const std::string & path ) const;
+
+    const std::string&  getPath() const;
+    DirTree&            getTree();
+
     static std::string  GetCurrentPath();
     static std::string  GetVolumeName   ( size_t sz );
+    static uint64_t     GetVolumeLimit  ( size_t volsz );
+    static const char*  GetStrategyName ( int strategy );
+    static int          GetStrategy     ( const std::string & name );
+    static const char*  GetLinkModeName ( int mode );
+    static int          GetLinkMode     ( const std::string & name );
     static std::string  GetFileName     ( const std::string & fqfn );
     static std::string  GetPathName     ( const std::string & fqfn );
     static std::string  GetRelativePath ( const std::string & fqfn,
                                           const std::string & path );
+    static bool         MakeDirs        ( const std::string & path );
 
   private:
 
     void     reset();
     bool     readDirectory ( const std::string & path );
-    void     createVolumes ( const std::string & path );
+    void     loadCheckpoint ( const std::string & path );
+    void     loadCheckpoint ( const std::string & path, CheckpointDir & dir, bool visit );
+    void     reportTree    ( const std::function<void(DirTree::Node*)> & fn );
+    void     reportTree    ( DirTree::Node * node, int depth,
+                             const std::function<void(DirTree::Node*)> & fn );
+
+    void     createVolumes ( DirTree::Node * node, VolumePlan & plan,
+                             std::map<DirTree::Node*, VolumePlan> & plans ) const;
+    void     addVolumeItem ( VolumePlan & plan, const VolumeItem & item ) const;
+    void     mergePlan     ( VolumePlan & plan, VolumePlan & sub ) const;
+    void     packDecreasing ( VolumePlan & plan ) const;
+    void     packLocal     ( DirTree::Node * node, VolumePlan & plan,
+                             std::map<DirTree::Node*, VolumePlan> & plans ) const;
+    size_t   countSpans ( const VolumePlan & plan, DirTree::Node * root ) const;
+    bool     isSplit       ( DirTree::Node * node, uint64_t limit ) const;
+
+    uint64_t getPlanSize   ( const DirNode & dnode ) const;
+    uint64_t getPlanSize   ( const DirNode & dnode, const FileNode & file ) const;
+    uint64_t getEstimate   ( uint64_t size, float ratio ) const;
+    void     rollupEstimate ( DirTree::Node * node );
+
+    std::string  getItemPath ( const VolumeItem & item ) const;
+    std::string  getItemName ( const VolumeItem & item ) const;
+    uint64_t     getVolumeLimit() const;
+    float        getVolumeRatio ( uint64_t size ) const;
+    void     printVolumes  ( std::ostream & strm, bool show );
+    void     createManifests  ( std::vector<VolManifest> & manifests,
+                                const std::string & volpath );
+    void     addManifestItem  ( VolManifest & manifest, const VolumeItem & item,
+                                const std::string & volroot );
+    void     addManifestFiles ( VolManifest & manifest, DirTree::Node * node,
+                                const std::string & volroot );
+
+    void     addIndexFiles ( IndexEntryList & entries, DirTree::Node * node,
+                             uint32_t vol, const std::string & volroot );
+    bool     addIndexBundle ( IndexEntryList & entries, const std::string & reldir,
+                              uint32_t vol, const std::string & volroot );
+
+    bool     isBundled     ( const FileNode & file ) const;
+    size_t   countBundled  ( const DirNode & dnode, uint64_t & bytes ) const;
+    bool     hasBundle     ( const DirNode & dnode, uint64_t & bytes ) const;
+    void     addBundle     ( std::vector<BundleJob> & jobs, DirTree::Node * node,
+                             const std::string & dirpath );
+    void     expandDirectory ( std::vector<BundleJob> & jobs, DirTree::Node * node,
+                               const std::string & volpath );
+    std::string  getRelativeDir ( DirTree::Node * node ) const;
+    void     stageFile     ( const FileNode & file, const std::string & target );
+
+    void     rollup        ( DirTree::Node * node );
+    void     adjustSizes   ( DirTree::Node * node, int64_t dsz, int64_t fsz,
+                             int64_t files, int64_t dirs );
 
   private:
 
     DirTree             _dtree;
     VolumeList          _vols;
-    Volume*             _curv;
+    ItemList            _items;
+    std::vector<const FileNode*>  _skipped;
 
     std::string         _path;
+    std::string         _exclude;
+    TreeVisitor         _visitor;
+    VolCheckpoint *     _ckpt;
+    VolProfile *        _prof;
 
     size_t              _volsz;
     size_t              _blksz;
+    size_t              _threads;
+    uint64_t            _bundlesz;
+    int                 _strategy;
+    int                 _linkmode;
+    size_t              _staged[VOLGEN_LINK_MAX];
+    size_t              _topn;
+    int                 _maxdepth;
+    int                 _margin;
+    int                 _samplepct;
+    bool                _estimate;
+    uint64_t            _sampled;
+    size_t              _unread;
     bool                _debug;
 
 };
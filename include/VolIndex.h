@@ -0,0 +1,121 @@
+/**
+  * @file VolIndex.h
+  *
+  * Memory mapped path-to-volume restore index.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLINDEX_H_
+#define _VOLGEN_VOLINDEX_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_INDEXFILE       "volgen.index"
+#define VOLGEN_INDEX_MAGIC     "VGINDEX1"
+#define VOLGEN_INDEX_BLOCK     16
+
+
+/**  A file of the restore index. A non-zero 'offset' is the offset
+  *  of the file data within the bundle of its directory. The index of
+  *  an encrypted image also holds its symlinks, by 'link' target.
+ **/
+struct IndexEntry {
+    std::string  name;
+    uint32_t     volume;
+    uint64_t     size;
+    uint64_t     offset;
+    std::string  link;
+
+    IndexEntry() : volume(0), size(0), offset(0) {}
+
+    IndexEntry ( const std::string & fname, uint32_t vol, uint64_t sz, uint64_t off = 0 )
+        : name(fname),
+          volume(vol),
+          size(sz),
+          offset(off)
+    {}
+
+    bool operator< ( const IndexEntry & e ) const
+    {
+        return(name < e.name);
+    }
+};
+
+typedef std::vector<IndexEntry>  IndexEntryList;
+
+
+/**  A sorted table of every file path in the plan, mapped to its
+  *  volume. Paths are prefix compressed against the previous path,
+  *  with a full path every VOLGEN_INDEX_BLOCK entries. A table of
+  *  these restart points is binary searched, so a lookup touches
+  *  O(log n) pages of the mapped file and decodes at most one block.
+ **/
+class VolIndex {
+
+  public:
+
+    VolIndex();
+    ~VolIndex();
+
+    VolIndex ( const VolIndex & ) = delete;
+    VolIndex& operator= ( const VolIndex & ) = delete;
+
+    bool     open    ( const std::string & filename );
+    void     close();
+
+    bool     find    ( const std::string & name, IndexEntry & entry ) const;
+    size_t   match   ( const std::string & pattern, IndexEntryList & matches ) const;
+
+    const std::string&  getRoot() const       { return _root; }
+    const std::string&  getVolumeName ( uint32_t vol ) const;
+    size_t              getVolumeCount() const { return _vols.size(); }
+    size_t              size() const;
+
+    static bool  Write ( const std::string & filename, const std::string & root,
+                         const std::vector<std::string> & volumes,
+                         IndexEntryList & entries );
+
+  private:
+
+    size_t          seek    ( const std::string & key, const uint8_t *& ptr ) const;
+    bool            decode  ( const uint8_t *& ptr, IndexEntry & entry ) const;
+    std::string     firstKey ( size_t block ) const;
+
+  private:
+
+    const uint8_t *           _map;
+    size_t                    _maplen;
+    const uint8_t *           _data;
+    const uint64_t *          _blocks;
+    size_t                    _count;
+    size_t                    _nblocks;
+    std::string               _root;
+    std::vector<std::string>  _vols;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLINDEX_H_
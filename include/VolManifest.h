@@ -0,0 +1,110 @@
+/**
+  * @file VolManifest.h
+  *
+  * Per-volume manifest of files with size, mtime and a SHA-256
+  * checksum, used to verify written media against the plan.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLMANIFEST_H_
+#define _VOLGEN_VOLMANIFEST_H_
+
+#include <inttypes.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_MANIFEST_EXT     ".manifest"
+#define VOLGEN_MANIFEST_MAGIC   "# volgen manifest v1"
+#define VOLGEN_MANIFEST_BATCH   64
+
+
+class FileReader;
+
+
+/**  A single file entry of a volume manifest. The 'source' path is
+  *  the absolute path the entry was created from and is not written
+  *  to the manifest file. A symlink is recorded by its target in
+  *  'link', with no size or digest.
+ **/
+struct ManifestEntry {
+    std::string  name;
+    std::string  source;
+    uint64_t     size;
+    time_t       mtime;
+    std::string  digest;
+    std::string  link;
+
+    ManifestEntry() : size(0), mtime(0) {}
+
+    bool isLink() const  { return ! link.empty(); }
+
+    ManifestEntry ( const std::string & relname, const std::string & srcname )
+        : name(relname),
+          source(srcname),
+          size(0),
+          mtime(0)
+    {}
+};
+
+typedef std::vector<ManifestEntry>  ManifestEntryList;
+
+
+/**  The manifest of a single volume. Entries are kept in the order
+  *  added, which follows the directory tree order of the volume.
+ **/
+class VolManifest {
+
+  public:
+
+    VolManifest ( const std::string & volname = "" );
+
+    void     add     ( const std::string & name, const std::string & source );
+
+    bool     write   ( const std::string & filename ) const;
+    bool     read    ( const std::string & filename );
+
+    const std::string&   getName() const    { return _name; }
+    ManifestEntryList&   getEntries()       { return _entries; }
+    const ManifestEntryList& getEntries() const { return _entries; }
+    uint64_t             getSize() const;
+
+    static bool          HashFile       ( FileReader & reader,
+                                          const std::string & path,
+                                          ManifestEntry & entry );
+    static std::string   GetManifestName ( const std::string & volpath,
+                                           const std::string & volname );
+    static std::string   ToHex          ( const unsigned char * md, size_t len );
+
+    static std::string   Escape   ( const std::string & str );
+    static std::string   Unescape ( const std::string & str );
+
+  private:
+
+    std::string          _name;
+    ManifestEntryList    _entries;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLMANIFEST_H_
@@ -0,0 +1,141 @@
+/**
+  * @file VolParity.h
+  *
+  * Reed-Solomon parity volumes for groups of data volumes.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLPARITY_H_
+#define _VOLGEN_VOLPARITY_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "VolManifest.h"
+
+
+namespace volgen {
+
+
+#define VOLGEN_PARITY_PREFIX   "Parity_"
+#define VOLGEN_PARITY_EXT      ".par"
+#define VOLGEN_PARITY_MAGIC    "volgen parity v1"
+#define VOLGEN_PARITY_HDRSZ    4096
+#define VOLGEN_PARITY_CHUNK    (4 * 1024 * 1024)
+#define VOLGEN_PARITY_SLICE    (256 * 1024)
+
+
+/**  The header of a parity volume file, written as text into a
+  *  fixed VOLGEN_PARITY_HDRSZ block ahead of the parity data.
+ **/
+struct ParityHeader {
+    int                       group;
+    int                       ndata;
+    int                       nparity;
+    int                       index;
+    uint64_t                  length;
+    std::vector<std::string>  volumes;
+
+    ParityHeader() : group(0), ndata(0), nparity(0), index(0), length(0) {}
+
+    bool  write ( int fd ) const;
+    bool  read  ( int fd );
+};
+
+
+/**  Presents a sequence of files as one contiguous byte stream,
+  *  the 'shard' of a volume for erasure coding. Reads beyond the
+  *  end of the stream, or of a short or missing file, are zero
+  *  filled so every shard reads as a full stripe.
+ **/
+class VolStream {
+
+  public:
+
+    VolStream ( const VolManifest & manifest, const std::string & root );
+    VolStream ( const std::string & path, uint64_t offset, uint64_t length );
+    ~VolStream();
+
+    VolStream ( const VolStream & ) = delete;
+    VolStream& operator= ( const VolStream & ) = delete;
+
+    void      read ( uint8_t * buf, size_t len );
+
+    uint64_t  getLength() const { return _length; }
+    size_t    getErrors() const { return _errors; }
+
+  private:
+
+    struct Segment {
+        std::string  path;
+        uint64_t     offset;
+        uint64_t     size;
+    };
+
+    bool      openSegment();
+
+  private:
+
+    std::vector<Segment>  _segs;
+    size_t                _seg;
+    int                   _fd;
+    uint64_t              _segoff;
+    uint64_t              _length;
+    size_t                _errors;
+
+};
+
+
+/**  Creates the parity volumes for the data volumes of a plan and
+  *  reconstructs lost data volumes from the survivors. Each group
+  *  of N data volumes gets K parity files 'Parity_GG_J.par' in the
+  *  meta dir, and any N of the N + K volumes restore the group.
+  *  Shards are read in parallel, one stream per volume, while the
+  *  previous stripe is being encoded across the thread pool.
+ **/
+class VolParity {
+
+  public:
+
+    VolParity ( const std::string & voldir, int ndata, int nparity );
+
+    bool     encode      ( const std::vector<std::string> & volnames,
+                           const std::string & root, size_t nthreads );
+
+    bool     reconstruct ( const std::string & volname, const std::string & media,
+                           const std::string & outdir, size_t nthreads );
+
+    static std::string  GetParityName ( const std::string & path, int group, int index );
+
+  private:
+
+    std::string  findParity  ( int group, int index, const std::string & media ) const;
+
+  private:
+
+    std::string  _voldir;
+    int          _ndata;
+    int          _nparity;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLPARITY_H_
@@ -0,0 +1,148 @@
+/**
+  * @file VolProfile.h
+  *
+  * Latency profile of a directory scan.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLPROFILE_H_
+#define _VOLGEN_VOLPROFILE_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_PROFILE_TOP     10
+#define VOLGEN_HIST_SUBBITS    4
+#define VOLGEN_HIST_BUCKETS    ((64 - VOLGEN_HIST_SUBBITS + 1) << VOLGEN_HIST_SUBBITS)
+
+
+/**  The calls timed by the profile */
+enum ProfileOp {
+    VOLGEN_PROF_OPENDIR = 0,
+    VOLGEN_PROF_READDIR,
+    VOLGEN_PROF_LSTAT,
+    VOLGEN_PROF_STAT,
+    VOLGEN_PROF_MAX
+};
+
+
+/**  A histogram of latencies in nanoseconds. Each power of two range
+  *  is divided into 2^VOLGEN_HIST_SUBBITS buckets, as in HdrHistogram,
+  *  so a percentile is accurate to within about 6% at any magnitude
+  *  with a fixed, small table.
+ **/
+class LatencyHistogram {
+
+  public:
+
+    LatencyHistogram();
+
+    void      add ( uint64_t ns );
+    uint64_t  getPercentile ( double pct ) const;
+
+    uint64_t  getCount() const  { return _count; }
+    uint64_t  getTotal() const  { return _total; }
+    uint64_t  getMax() const    { return _max; }
+
+    static size_t    GetBucket ( uint64_t ns );
+    static uint64_t  GetBucketLimit ( size_t indx );
+
+  private:
+
+    std::vector<uint64_t>  _counts;
+    uint64_t               _count;
+    uint64_t               _total;
+    uint64_t               _max;
+
+};
+
+
+/**  The wall time taken by a directory, excluding ('self') and
+  *  including its subdirectories.
+ **/
+struct DirCost {
+    std::string  path;
+    uint64_t     self;
+    uint64_t     total;
+    uint64_t     entries;
+
+    DirCost() : self(0), total(0), entries(0) {}
+
+    bool operator< ( const DirCost & c ) const
+    {
+        return( self > c.self );
+    }
+};
+
+
+/**  Profiles a scan of the tree. The time of each call is added to the
+  *  histogram of its kind and the wall time of each directory is
+  *  charged to it, less that of its subdirectories, keeping the 'topn'
+  *  most costly directories. The scan is a single recursive walk, so
+  *  a profile is used by one thread only.
+ **/
+class VolProfile {
+
+  public:
+
+    explicit VolProfile ( size_t topn = VOLGEN_PROFILE_TOP );
+
+    void      enter ( const std::string & path );
+    void      leave ( uint64_t entries );
+
+    void      record ( int op, uint64_t ns )   { _hist[op].add(ns); }
+
+    void      display ( std::ostream & strm ) const;
+
+    static uint64_t  Now()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return( (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+    }
+
+    static const char*  GetOpName ( int op );
+
+  private:
+
+    struct Frame {
+        std::string  path;
+        uint64_t     start;
+        uint64_t     child;
+    };
+
+    LatencyHistogram      _hist[VOLGEN_PROF_MAX];
+    std::vector<Frame>    _stack;
+    std::vector<DirCost>  _top;
+    size_t                _topn;
+    uint64_t              _dirs;
+    uint64_t              _wall;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLPROFILE_H_
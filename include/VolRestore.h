@@ -0,0 +1,118 @@
+/**
+  * @file VolRestore.h
+  *
+  * Parallel restore of files from volumes and volume images.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLRESTORE_H_
+#define _VOLGEN_VOLRESTORE_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "VolIndex.h"
+
+
+namespace volgen {
+
+
+#define VOLGEN_RESTORE_WRITERS  4
+#define VOLGEN_COPY_CHUNK       (64 * 1024 * 1024)
+
+
+struct RestoreResult {
+    std::atomic<uint64_t>  files;
+    std::atomic<uint64_t>  bytes;
+    std::atomic<uint64_t>  errors;
+    uint64_t               missing;
+
+    RestoreResult() : files(0), bytes(0), errors(0), missing(0) {}
+};
+
+
+/**  Where a volume is read from: a mounted volume (or its directory
+  *  in the meta dir) or a tar image as written by VolWriter.
+ **/
+struct RestoreSource {
+    std::string  path;
+    bool         image;
+
+    RestoreSource() : image(false) {}
+};
+
+
+struct WriteSlots;
+
+
+/**  Restores files of the plan, as given by its restore index, into
+  *  a target directory. Each volume is read by a task of its own,
+  *  front to back, so several volumes are restored at once and each
+  *  is read sequentially. The directory skeleton is created once up
+  *  front, files are copied with copy_file_range() and the number of
+  *  files written at once to each target device is bounded.
+  *
+  *  Bundled files are copied straight out of their bundle by offset,
+  *  and from an image the members (and bundles) are located by
+  *  walking its tar headers, so nothing is staged.
+ **/
+class VolRestore {
+
+  public:
+
+    VolRestore ( const VolIndex & index, const std::string & outdir );
+    ~VolRestore();
+
+    VolRestore ( const VolRestore & ) = delete;
+    VolRestore& operator= ( const VolRestore & ) = delete;
+
+    void      addMedia ( const std::string & media );
+    size_t    select   ( const std::string & path );
+    bool      run      ( size_t nthreads, size_t writers = VOLGEN_RESTORE_WRITERS );
+
+    const RestoreResult&  getResult() const  { return _result; }
+
+  private:
+
+    bool      findSource ( const std::string & volname, RestoreSource & src ) const;
+    bool      createSkeleton ( size_t writers );
+    void      restoreVolume ( uint32_t vol, const RestoreSource & src,
+                              IndexEntryList & entries );
+    WriteSlots*  getSlots ( const std::string & name );
+
+  private:
+
+    typedef std::map<uint32_t, IndexEntryList>  VolumeEntries;
+
+    const VolIndex &                     _index;
+    std::string                          _outdir;
+    std::vector<std::string>             _media;
+    VolumeEntries                        _vols;
+    std::map<std::string, WriteSlots*>   _dirslots;
+    std::map<dev_t, WriteSlots*>         _devslots;
+    RestoreResult                        _result;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLRESTORE_H_
@@ -0,0 +1,128 @@
+/**
+  * @file VolUpload.h
+  *
+  * Multipart upload of volume images to S3 compatible object storage.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLUPLOAD_H_
+#define _VOLGEN_VOLUPLOAD_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace volgen {
+
+
+#define VOLGEN_UPLOAD_SCHEME    "s3://"
+#define VOLGEN_UPLOAD_PARTSZ    (16 * 1024 * 1024)
+#define VOLGEN_UPLOAD_MAXPARTSZ (5ULL * 1024 * 1024 * 1024)
+#define VOLGEN_UPLOAD_MAXPARTS  10000
+#define VOLGEN_UPLOAD_CONNS     8
+#define VOLGEN_UPLOAD_RETRIES   5
+#define VOLGEN_UPLOAD_REGION    "us-east-1"
+
+
+struct UploadPart {
+    int          number;
+    uint64_t     size;
+    std::string  etag;
+
+    UploadPart ( int num = 0, uint64_t sz = 0, const std::string & tag = "" )
+        : number(num), size(sz), etag(tag) {}
+};
+
+typedef std::vector<UploadPart>  UploadPartList;
+
+
+/**  A client of one bucket of an S3 compatible service, given as
+  *  s3://bucket[/prefix]. The endpoint and credentials are taken from
+  *  the environment as with the AWS tools: AWS_ENDPOINT_URL (for a
+  *  service such as MinIO, addressed path style), AWS_REGION,
+  *  AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY and AWS_SESSION_TOKEN.
+  *
+  *  Requests are signed with SigV4 and retried with backoff on
+  *  transport errors, throttling and server errors. Each request uses
+  *  a connection of its own from a cache, so requests made from
+  *  several threads at once run in parallel over as many connections.
+ **/
+class VolUpload {
+
+  public:
+
+    VolUpload();
+    ~VolUpload();
+
+    VolUpload ( const VolUpload & ) = delete;
+    VolUpload& operator= ( const VolUpload & ) = delete;
+
+    bool      init ( const std::string & target );
+
+    std::string  getKey ( const std::string & name ) const  { return _prefix + name; }
+    std::string  getUrl ( const std::string & key ) const;
+
+    bool      create     ( const std::string & key, std::string & uploadid );
+    bool      findUpload ( const std::string & key, std::string & uploadid );
+    bool      listParts  ( const std::string & key, const std::string & uploadid,
+                           UploadPartList & parts );
+    bool      putPart    ( const std::string & key, const std::string & uploadid,
+                           int partno, const char * buf, size_t len, std::string & etag );
+    bool      complete   ( const std::string & key, const std::string & uploadid,
+                           const UploadPartList & parts );
+    bool      abort      ( const std::string & key, const std::string & uploadid );
+
+    static bool         IsTarget  ( const std::string & target );
+    static std::string  GetMD5Hex ( const char * buf, size_t len );
+
+    struct Request;
+    struct Response;
+
+  private:
+
+    bool      perform ( Request & req, Response & rsp );
+    bool      send    ( Request & req, Response & rsp );
+    void      sign    ( const Request & req, const std::string & host, const std::string & path,
+                        std::vector<std::string> & headers );
+
+    void*     getHandle();
+    void      putHandle ( void * handle );
+
+  private:
+
+    std::string          _scheme;
+    std::string          _host;
+    std::string          _bucket;
+    std::string          _prefix;
+    std::string          _region;
+    std::string          _access;
+    std::string          _secret;
+    std::string          _token;
+    bool                 _pathstyle;
+
+    std::vector<void*>   _handles;
+    std::mutex           _lock;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLUPLOAD_H_
@@ -0,0 +1,91 @@
+/**
+  * @file VolVerify.h
+  *
+  * Verifies mounted volume media, or a volume image, against a
+  * volume manifest.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLVERIFY_H_
+#define _VOLGEN_VOLVERIFY_H_
+
+#include <string>
+#include <vector>
+
+#include "VolManifest.h"
+
+
+namespace volgen {
+
+
+struct VerifyJob;
+
+
+/**  Verify results for a single volume */
+struct VerifyResult {
+    size_t    verified;
+    size_t    missing;
+    size_t    sizediff;
+    size_t    mismatch;
+    size_t    errors;
+    uint64_t  bytes;
+
+    VerifyResult()
+        : verified(0), missing(0), sizediff(0),
+          mismatch(0), errors(0), bytes(0)
+    {}
+
+    bool ok() const
+    {
+        return ( missing == 0 && sizediff == 0 && mismatch == 0 && errors == 0 );
+    }
+};
+
+
+/**  VolVerify streams the files of a mounted volume in on-disk
+  *  order using a single reader with large aligned reads, so the
+  *  device sees one sequential pass. Checksums are computed by a
+  *  pool of hashing threads fed from a bounded set of buffers,
+  *  so hashing overlaps the reads rather than adding to them. A tar
+  *  image is verified the same way, its members read in image order.
+ **/
+class VolVerify {
+
+  public:
+
+    VolVerify ( const VolManifest & manifest, const std::string & root );
+
+    bool                 run ( size_t nthreads );
+    const VerifyResult&  getResult() const { return _result; }
+
+  private:
+
+    bool                 runImage     ( size_t nthreads );
+    void                 checkDigests ( const std::vector<VerifyJob> & jobs );
+    void                 orderEntries ( std::vector<size_t> & order );
+
+  private:
+
+    const VolManifest &  _manifest;
+    std::string          _root;
+    VerifyResult         _result;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLVERIFY_H_
@@ -0,0 +1,97 @@
+/**
+  * @file VolWatch.h
+  *
+  * Maintains a live VolGen directory tree from filesystem change
+  * notifications, re-planning the volume set as the tree changes.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLWATCH_H_
+#define _VOLGEN_VOLWATCH_H_
+
+#include <map>
+#include <string>
+
+#include "VolGen.h"
+
+
+namespace volgen {
+
+
+#define VOLGEN_WATCH_INTERVAL_MS   1000
+#define VOLGEN_WATCH_EVBUFSZ       65536
+
+
+/**  VolWatch keeps the DirTree of a VolGen instance current by
+  *  applying filesystem events as they occur. A filesystem-wide
+  *  fanotify mark is used when permitted (CAP_SYS_ADMIN), which
+  *  avoids a watch per directory; otherwise inotify watches are
+  *  placed on every directory in the tree.
+  *
+  *  Once events settle, the volume plan is recreated from the
+  *  in-memory tree and written to the plan file.
+ **/
+class VolWatch {
+
+  public:
+
+    VolWatch ( VolGen * vgen );
+    ~VolWatch();
+
+    bool     init();
+    void     run  ( const std::string & planfile );
+    void     stop();
+
+    void     setInterval ( int msecs );
+    bool     isFanotify() const;
+
+  private:
+
+    typedef std::map<int, std::string>  WatchMap;
+    typedef std::map<std::string, int>  WatchPathMap;
+
+    bool     initFanotify();
+    bool     initInotify();
+
+    bool     addWatches    ( DirTree::Node * node );
+    bool     addWatch      ( const std::string & path );
+    void     removeWatches ( const std::string & path );
+
+    bool     readFanotify();
+    bool     readInotify();
+
+    void     pathChanged   ( const std::string & path, bool isdir, bool removed );
+    void     rescan();
+
+  private:
+
+    VolGen *            _vgen;
+    int                 _fd;
+    int                 _mntfd;
+    int                 _interval;
+    bool                _fanotify;
+    bool                _dirty;
+    volatile bool       _run;
+
+    WatchMap            _wds;
+    WatchPathMap        _wpaths;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLWATCH_H_
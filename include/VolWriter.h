@@ -0,0 +1,105 @@
+/**
+  * @file VolWriter.h
+  *
+  * Pipelined writer of volume images to multiple targets.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_VOLWRITER_H_
+#define _VOLGEN_VOLWRITER_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "VolManifest.h"
+#include "VolCrypt.h"
+
+
+namespace volgen {
+
+
+#define VOLGEN_WRITER_BUFSZ    (4 * 1024 * 1024)
+#define VOLGEN_WRITER_RING     8
+#define VOLGEN_IMAGE_EXT       ".tar"
+
+
+struct WriteTarget;
+
+
+/**  Writes volumes as tar images to one or more targets at once. A
+  *  target is a directory, receiving <volume>.tar for each volume
+  *  assigned to it, or a block device, which holds a single volume.
+  *  Volumes are assigned to the targets in turn.
+  *
+  *  Each target has a reader, which builds the archive stream into a
+  *  ring of aligned buffers, and a writer draining the ring to the
+  *  target with O_DIRECT. The reader runs ahead into the next volume
+  *  while the current one is written, bounded by the ring, so the
+  *  time taken is that of the slowest target rather than the sum of
+  *  reading and writing.
+  *
+  *  With a VolCrypt set each image is encrypted on the way, as
+  *  <volume>.tar.vgc, by a third stage between the two that seals the
+  *  segments of each buffer in parallel on a shared pool.
+  *
+  *  A target given as s3://bucket[/prefix] receives each image as an
+  *  object, streamed from the ring as a multipart upload with several
+  *  parts in flight at once (see VolUpload).
+ **/
+class VolWriter {
+
+  public:
+
+    explicit VolWriter ( const std::vector<std::string> & targets,
+                         size_t ring = VOLGEN_WRITER_RING );
+    ~VolWriter();
+
+    VolWriter ( const VolWriter & ) = delete;
+    VolWriter& operator= ( const VolWriter & ) = delete;
+
+    void      add  ( const VolManifest & manifest );
+    void      setCrypt ( const VolCrypt * crypt );
+    void      setConnections ( size_t conns );
+    bool      run();
+
+    uint64_t  getBytes() const   { return _bytes; }
+
+    static std::string  GetImageName ( const std::string & target,
+                                       const std::string & volname );
+
+  private:
+
+    bool      init();
+
+  private:
+
+    std::vector<std::string>    _targets;
+    std::vector<WriteTarget*>   _outs;
+    std::vector<VolManifest>    _vols;
+    const VolCrypt *            _crypt;
+    size_t                      _conns;
+    size_t                      _ring;
+    uint64_t                    _bytes;
+
+};
+
+}  // namespace
+
+#endif  // _VOLGEN_VOLWRITER_H_
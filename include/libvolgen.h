@@ -0,0 +1,114 @@
+/**
+  * @file libvolgen.h
+  *
+  * C interface to the volgen engine.
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#ifndef _VOLGEN_LIBVOLGEN_H_
+#define _VOLGEN_LIBVOLGEN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*  Incremented on any incompatible change to this interface */
+#define VOLGEN_ABI_VERSION      1
+
+/*  volgen_item_t types */
+#define VOLGEN_TYPE_DIR         0
+#define VOLGEN_TYPE_FILE        1
+#define VOLGEN_TYPE_BUNDLE      2
+
+/*  volgen_generate() flags */
+#define VOLGEN_GEN_MANIFEST     0x01
+#define VOLGEN_GEN_INDEX        0x02
+
+
+typedef struct volgen_s       volgen_t;
+typedef struct volgen_plan_s  volgen_plan_t;
+
+
+/**  A directory or file reported during volgen_scan() */
+typedef struct {
+    const char *  path;
+    uint64_t      size;
+    uint64_t      disksize;
+    int           dir;
+    int           symlink;
+} volgen_entry_t;
+
+
+/**  An item of a volume */
+typedef struct {
+    const char *  name;
+    const char *  path;
+    uint64_t      size;
+    int           type;
+} volgen_item_t;
+
+
+/**  A volume of a plan. The items are valid as long as the plan */
+typedef struct {
+    const char *           name;
+    uint64_t               size;
+    size_t                 nitems;
+    const volgen_item_t *  items;
+} volgen_volume_t;
+
+
+typedef void (*volgen_entry_fn)  ( const volgen_entry_t * entry, void * arg );
+typedef void (*volgen_volume_fn) ( const volgen_volume_t * vol, void * arg );
+
+
+/*  Functions returning int return 0 on success and -1 on error.
+ *  A volgen_t must not be used by more than one thread at a time. */
+
+int          volgen_abi_version ( void );
+const char*  volgen_version     ( void );
+
+volgen_t*    volgen_create      ( const char * path );
+void         volgen_destroy     ( volgen_t * vg );
+
+int          volgen_set_volume_size ( volgen_t * vg, size_t mb );
+int          volgen_set_strategy    ( volgen_t * vg, const char * name );
+int          volgen_set_bundle_size ( volgen_t * vg, size_t kb );
+int          volgen_set_link_mode   ( volgen_t * vg, const char * name );
+int          volgen_set_threads     ( volgen_t * vg, size_t threads );
+int          volgen_set_exclude     ( volgen_t * vg, const char * path );
+
+int          volgen_scan        ( volgen_t * vg, volgen_entry_fn fn, void * arg );
+
+volgen_plan_t*  volgen_plan     ( volgen_t * vg, volgen_volume_fn fn, void * arg );
+size_t       volgen_plan_count  ( const volgen_plan_t * plan );
+int          volgen_plan_volume ( const volgen_plan_t * plan, size_t indx,
+                                  volgen_volume_t * vol );
+size_t       volgen_plan_skipped ( const volgen_plan_t * plan );
+void         volgen_plan_free   ( volgen_plan_t * plan );
+
+int          volgen_generate    ( volgen_t * vg, const char * voldir, int flags );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _VOLGEN_LIBVOLGEN_H_
@@ -0,0 +1,187 @@
+/**
+  * @file   FileReader.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_FILEREADER_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "FileReader.h"
+
+
+namespace volgen {
+
+
+FileReader::FileReader ( size_t bufsz )
+    : _fd(-1),
+      _buf(NULL),
+      _bufsz(bufsz),
+      _offset(0),
+      _direct(false),
+      _errno(0)
+{
+    _bufsz = ((_bufsz + VOLGEN_IOALIGN - 1) / VOLGEN_IOALIGN) * VOLGEN_IOALIGN;
+
+    if ( _bufsz > 0 && ::posix_memalign((void**) &_buf, VOLGEN_IOALIGN, _bufsz) != 0 )
+        _buf = NULL;
+
+    std::memset(&_sb, 0, sizeof(_sb));
+}
+
+
+FileReader::~FileReader()
+{
+    this->close();
+    ::free(_buf);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Opens the file for reading. Large regular files are opened with
+  *  O_DIRECT when 'direct' is set, falling back to buffered reads if
+  *  the filesystem refuses it.
+ **/
+bool
+FileReader::open ( const std::string & path, bool direct )
+{
+    this->close();
+
+    _errno = 0;
+
+    _fd = ::open(path.c_str(), O_RDONLY | O_NOATIME | O_CLOEXEC);
+
+    if ( _fd < 0 && errno == EPERM )  // O_NOATIME requires ownership
+        _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( _fd < 0 || ::fstat(_fd, &_sb) < 0 ) {
+        _errno = errno;
+        this->close();
+        return false;
+    }
+
+    if ( ! S_ISREG(_sb.st_mode) ) {
+        _errno = ( S_ISDIR(_sb.st_mode) ) ? EISDIR : EINVAL;
+        this->close();
+        return false;
+    }
+
+    if ( direct && (uint64_t) _sb.st_size >= VOLGEN_DIRECTIO_MIN ) {
+        int flags = ::fcntl(_fd, F_GETFL);
+        if ( flags >= 0 && ::fcntl(_fd, F_SETFL, flags | O_DIRECT) == 0 )
+            _direct = true;
+    }
+
+    if ( ! _direct ) {
+        ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        ::posix_fadvise(_fd, 0, VOLGEN_READ_BUFSZ * VOLGEN_READAHEAD, POSIX_FADV_WILLNEED);
+    }
+
+    return true;
+}
+
+
+void
+FileReader::close()
+{
+    if ( _fd >= 0 )
+        ::close(_fd);
+
+    _fd     = -1;
+    _offset = 0;
+    _direct = false;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Reads the next chunk of the file, setting 'data' to the internal
+  *  buffer. Returns the number of bytes read, 0 at end of file or -1
+  *  on error.
+ **/
+ssize_t
+FileReader::read ( const char ** data )
+{
+    if ( _buf == NULL ) {
+        _errno = ENOMEM;
+        return -1;
+    }
+
+    *data = _buf;
+
+    return this->read(_buf, _bufsz);
+}
+
+
+/**  Reads the next chunk of the file into the given buffer, which
+  *  must be aligned to VOLGEN_IOALIGN with a size that is a multiple
+  *  of it for direct I/O.
+ **/
+ssize_t
+FileReader::read ( char * buf, size_t bufsz )
+{
+    if ( _fd < 0 )
+        return -1;
+
+    size_t  rd = 0;
+    ssize_t r  = 0;
+
+    /* fill the buffer so callers always see full chunks until EOF */
+    while ( rd < bufsz )
+    {
+        r = ::pread(_fd, buf + rd, bufsz - rd, _offset + rd);
+
+        if ( r < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            if ( errno == EINVAL && _direct && (rd % VOLGEN_IOALIGN) == 0 ) {
+                int flags = ::fcntl(_fd, F_GETFL);
+                ::fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+                _direct = false;
+                continue;
+            }
+            _errno = errno;
+            return -1;
+        }
+        if ( r == 0 )
+            break;
+
+        rd += r;
+
+        if ( _direct && (rd % VOLGEN_IOALIGN) != 0 )
+            break;  // short read at EOF
+    }
+
+    if ( ! _direct && rd > 0 ) {
+        ::posix_fadvise(_fd, _offset + (bufsz * VOLGEN_READAHEAD), bufsz, POSIX_FADV_WILLNEED);
+        ::posix_fadvise(_fd, _offset, rd, POSIX_FADV_DONTNEED);
+    }
+
+    _offset += rd;
+
+    return rd;
+}
+
+}  // namespace
+
+// _VOLGEN_FILEREADER_CPP_
@@ -0,0 +1,260 @@
+/**
+  * @file   OutputWriter.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_OUTPUTWRITER_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+#include "OutputWriter.h"
+
+
+namespace volgen {
+
+
+OutputWriter::OutputWriter ( int fd, size_t bufsz )
+    : _buf(bufsz),
+      _pos(0),
+      _fd(fd),
+      _owned(false),
+      _error(0)
+{}
+
+OutputWriter::~OutputWriter()
+{
+    this->close();
+}
+
+// -------------------------------------------------------------- //
+
+bool
+OutputWriter::open ( const std::string & filename )
+{
+    this->close();
+
+    _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if ( _fd < 0 ) {
+        _error = errno;
+        std::cout << "OutputWriter: Error opening '" << filename << "' : "
+            << strerror(_error) << std::endl;
+        return false;
+    }
+
+    _owned = true;
+    _error = 0;
+
+    return true;
+}
+
+
+bool
+OutputWriter::flush()
+{
+    size_t off = 0;
+
+    while ( off < _pos && _error == 0 )
+    {
+        ssize_t wr = ::write(_fd, &_buf[off], _pos - off);
+
+        if ( wr < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            _error = errno;
+            break;
+        }
+        off += wr;
+    }
+
+    _pos = 0;
+
+    return ( _error == 0 );
+}
+
+
+bool
+OutputWriter::close()
+{
+    bool result = this->flush();
+
+    if ( _owned && _fd >= 0 ) {
+        if ( ::close(_fd) < 0 && result ) {
+            _error = errno;
+            result = false;
+        }
+        _fd    = 1;
+        _owned = false;
+    }
+
+    return result;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Returns room for 'len' bytes in the buffer, flushing as needed */
+char*
+OutputWriter::reserve ( size_t len )
+{
+    if ( _pos + len > _buf.size() ) {
+        this->flush();
+        if ( len > _buf.size() )
+            _buf.resize(len);
+    }
+
+    return &_buf[_pos];
+}
+
+
+OutputWriter&
+OutputWriter::put ( char c )
+{
+    *this->reserve(1) = c;
+    _pos++;
+
+    return *this;
+}
+
+
+OutputWriter&
+OutputWriter::write ( const char * str, size_t len )
+{
+    std::memcpy(this->reserve(len), str, len);
+    _pos += len;
+
+    return *this;
+}
+
+
+OutputWriter&
+OutputWriter::write ( const char * str )
+{
+    return this->write(str, std::strlen(str));
+}
+
+
+OutputWriter&
+OutputWriter::write ( const std::string & str )
+{
+    return this->write(str.data(), str.length());
+}
+
+
+OutputWriter&
+OutputWriter::number ( uint64_t val )
+{
+    char * p = this->reserve(24);
+
+    _pos += std::to_chars(p, p + 24, val).ptr - p;
+
+    return *this;
+}
+
+
+OutputWriter&
+OutputWriter::number ( double val, int precision )
+{
+    char * p = this->reserve(64);
+    std::to_chars_result r = std::to_chars(p, p + 64, val, std::chars_format::fixed, precision);
+
+    if ( r.ec == std::errc() )
+        _pos += r.ptr - p;
+
+    return *this;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Writes the string as a quoted JSON string */
+OutputWriter&
+OutputWriter::json ( const std::string & str )
+{
+    static const char hex[] = "0123456789abcdef";
+
+    this->put('"');
+
+    for ( size_t i = 0; i < str.length(); ++i )
+    {
+        unsigned char c = str[i];
+
+        switch ( c ) {
+            case '"':  this->write("\\\"", 2); break;
+            case '\\': this->write("\\\\", 2); break;
+            case '\n': this->write("\\n", 2);  break;
+            case '\r': this->write("\\r", 2);  break;
+            case '\t': this->write("\\t", 2);  break;
+            default:
+                if ( c < 0x20 ) {
+                    char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                    this->write(esc, sizeof(esc));
+                } else {
+                    this->put(c);
+                }
+        }
+    }
+
+    return this->put('"');
+}
+
+
+/**  Writes the string as a CSV field, quoted only when required */
+OutputWriter&
+OutputWriter::csv ( const std::string & str )
+{
+    if ( str.find_first_of(",\"\r\n") == std::string::npos )
+        return this->write(str);
+
+    this->put('"');
+
+    for ( size_t i = 0; i < str.length(); ++i ) {
+        if ( str[i] == '"' )
+            this->put('"');
+        this->put(str[i]);
+    }
+
+    return this->put('"');
+}
+
+// -------------------------------------------------------------- //
+
+/**  Returns the format of the given name, or -1 if not known */
+int
+OutputWriter::GetFormat ( const std::string & name )
+{
+    if ( name.compare("text") == 0 )
+        return VOLGEN_FORMAT_TEXT;
+    if ( name.compare("json") == 0 )
+        return VOLGEN_FORMAT_JSON;
+    if ( name.compare("ndjson") == 0 )
+        return VOLGEN_FORMAT_NDJSON;
+    if ( name.compare("csv") == 0 )
+        return VOLGEN_FORMAT_CSV;
+
+    return -1;
+}
+
+}  // namespace
+
+// _VOLGEN_OUTPUTWRITER_CPP_
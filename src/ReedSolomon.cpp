@@ -0,0 +1,331 @@
+/**
+  * @file   ReedSolomon.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_REEDSOLOMON_CPP_
+
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define VOLGEN_RS_X86 1
+#endif
+
+#include "ReedSolomon.h"
+
+
+namespace volgen {
+
+// -------------------------------------------------------------- //
+// GF(2^8) tables, generator polynomial x^8 + x^4 + x^3 + x^2 + 1
+
+struct GFTables {
+    uint8_t  exp[512];
+    uint8_t  log[256];
+    uint8_t  mul[256][256];
+    uint8_t  lo[256][16];   // c * x      for x in [0,16)
+    uint8_t  hi[256][16];   // c * (x<<4) for x in [0,16)
+
+    GFTables()
+    {
+        unsigned int x = 1;
+
+        for ( int i = 0; i < 255; ++i ) {
+            exp[i] = exp[i + 255] = x;
+            log[x] = i;
+            x <<= 1;
+            if ( x & 0x100 )
+                x ^= 0x11d;
+        }
+        exp[510] = exp[511] = 0;
+        log[0]   = 0;
+
+        for ( int a = 0; a < 256; ++a ) {
+            for ( int b = 0; b < 256; ++b )
+                mul[a][b] = ( a == 0 || b == 0 ) ? 0 : exp[log[a] + log[b]];
+            for ( int n = 0; n < 16; ++n ) {
+                lo[a][n] = mul[a][n];
+                hi[a][n] = mul[a][n << 4];
+            }
+        }
+    }
+};
+
+static const GFTables&
+GF()
+{
+    static const GFTables tables;
+    return tables;
+}
+
+// -------------------------------------------------------------- //
+// Region kernels: dst ^= c * src
+
+typedef void (*MulAddFn)( const uint8_t * lo, const uint8_t * hi, const uint8_t * mul,
+                          const uint8_t * src, uint8_t * dst, size_t len );
+
+static void
+MulAddScalar ( const uint8_t *, const uint8_t *, const uint8_t * mul,
+               const uint8_t * src, uint8_t * dst, size_t len )
+{
+    for ( size_t i = 0; i < len; ++i )
+        dst[i] ^= mul[src[i]];
+}
+
+#ifdef VOLGEN_RS_X86
+
+__attribute__((target("ssse3")))
+static void
+MulAddSSSE3 ( const uint8_t * lo, const uint8_t * hi, const uint8_t * mul,
+              const uint8_t * src, uint8_t * dst, size_t len )
+{
+    const __m128i tlo  = _mm_loadu_si128((const __m128i*) lo);
+    const __m128i thi  = _mm_loadu_si128((const __m128i*) hi);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+        __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        d = _mm_xor_si128(d, _mm_xor_si128(l, h));
+        _mm_storeu_si128((__m128i*) (dst + i), d);
+    }
+
+    MulAddScalar(lo, hi, mul, src + i, dst + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void
+MulAddAVX2 ( const uint8_t * lo, const uint8_t * hi, const uint8_t * mul,
+             const uint8_t * src, uint8_t * dst, size_t len )
+{
+    const __m256i tlo  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) lo));
+    const __m256i thi  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) hi));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for ( ; i + 64 <= len; i += 64 )
+    {
+        __m256i s0 = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i s1 = _mm256_loadu_si256((const __m256i*) (src + i + 32));
+        __m256i d0 = _mm256_loadu_si256((const __m256i*) (dst + i));
+        __m256i d1 = _mm256_loadu_si256((const __m256i*) (dst + i + 32));
+
+        __m256i l0 = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s0, mask));
+        __m256i h0 = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s0, 4), mask));
+        __m256i l1 = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s1, mask));
+        __m256i h1 = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s1, 4), mask));
+
+        d0 = _mm256_xor_si256(d0, _mm256_xor_si256(l0, h0));
+        d1 = _mm256_xor_si256(d1, _mm256_xor_si256(l1, h1));
+
+        _mm256_storeu_si256((__m256i*) (dst + i), d0);
+        _mm256_storeu_si256((__m256i*) (dst + i + 32), d1);
+    }
+
+    MulAddSSSE3(lo, hi, mul, src + i, dst + i, len - i);
+}
+
+#endif  // VOLGEN_RS_X86
+
+
+struct Kernel {
+    MulAddFn      fn;
+    const char *  name;
+
+    Kernel() : fn(&MulAddScalar), name("scalar")
+    {
+#ifdef VOLGEN_RS_X86
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports("avx2") ) {
+            fn   = &MulAddAVX2;
+            name = "avx2";
+        } else if ( __builtin_cpu_supports("ssse3") ) {
+            fn   = &MulAddSSSE3;
+            name = "ssse3";
+        }
+#endif
+    }
+};
+
+static const Kernel&
+GetKernel()
+{
+    static const Kernel kernel;
+    return kernel;
+}
+
+// -------------------------------------------------------------- //
+
+ReedSolomon::ReedSolomon ( int ndata, int nparity )
+    : _ndata(ndata),
+      _nparity(nparity),
+      _matrix(ndata * nparity)
+{
+    /* Cauchy rows: 1 / (x_j + y_i), x_j = N + j, y_i = i */
+    for ( int j = 0; j < _nparity; ++j )
+        for ( int i = 0; i < _ndata; ++i )
+            _matrix[(j * _ndata) + i] = ReedSolomon::Inv((uint8_t) ((_ndata + j) ^ i));
+}
+
+// -------------------------------------------------------------- //
+
+/**  Computes the K parity shards for the N data shards of 'len' bytes */
+void
+ReedSolomon::encode ( const uint8_t * const * data, uint8_t ** parity,
+                      size_t len ) const
+{
+    for ( int j = 0; j < _nparity; ++j )
+        ReedSolomon::Combine(&_matrix[j * _ndata], data, _ndata, parity[j], len);
+}
+
+
+/**  Determines the coefficients recovering data shard 'target' from
+  *  the N available shards given by index (data shards 0..N-1, parity
+  *  shards N..N+K-1). Returns false if the shards are insufficient.
+ **/
+bool
+ReedSolomon::decodeRow ( const std::vector<int> & shards, int target,
+                         std::vector<uint8_t> & coeffs ) const
+{
+    const int n = _ndata;
+
+    if ( (int) shards.size() != n )
+        return false;
+
+    std::vector<uint8_t> m(n * n), inv(n * n, 0);
+
+    for ( int r = 0; r < n; ++r ) {
+        if ( shards[r] < 0 || shards[r] >= _ndata + _nparity )
+            return false;
+        for ( int c = 0; c < n; ++c )
+            m[(r * n) + c] = this->getRow(shards[r], c);
+        inv[(r * n) + r] = 1;
+    }
+
+    /* Gauss-Jordan elimination */
+    for ( int c = 0; c < n; ++c )
+    {
+        int p = c;
+        while ( p < n && m[(p * n) + c] == 0 )
+            ++p;
+        if ( p == n )
+            return false;
+
+        if ( p != c ) {
+            for ( int k = 0; k < n; ++k ) {
+                std::swap(m[(p * n) + k], m[(c * n) + k]);
+                std::swap(inv[(p * n) + k], inv[(c * n) + k]);
+            }
+        }
+
+        uint8_t f = ReedSolomon::Inv(m[(c * n) + c]);
+        for ( int k = 0; k < n; ++k ) {
+            m[(c * n) + k]   = ReedSolomon::Mul(m[(c * n) + k], f);
+            inv[(c * n) + k] = ReedSolomon::Mul(inv[(c * n) + k], f);
+        }
+
+        for ( int r = 0; r < n; ++r )
+        {
+            uint8_t e = m[(r * n) + c];
+            if ( r == c || e == 0 )
+                continue;
+            for ( int k = 0; k < n; ++k ) {
+                m[(r * n) + k]   ^= ReedSolomon::Mul(e, m[(c * n) + k]);
+                inv[(r * n) + k] ^= ReedSolomon::Mul(e, inv[(c * n) + k]);
+            }
+        }
+    }
+
+    coeffs.assign(inv.begin() + (target * n), inv.begin() + ((target + 1) * n));
+
+    return true;
+}
+
+
+uint8_t
+ReedSolomon::getRow ( int shard, int col ) const
+{
+    if ( shard < _ndata )
+        return ( shard == col ) ? 1 : 0;
+
+    return _matrix[((shard - _ndata) * _ndata) + col];
+}
+
+// -------------------------------------------------------------- //
+
+/**  Computes dst = sum(coeffs[i] * src[i]) over 'len' bytes */
+void
+ReedSolomon::Combine ( const uint8_t * coeffs, const uint8_t * const * src,
+                       int nsrc, uint8_t * dst, size_t len )
+{
+    std::memset(dst, 0, len);
+
+    for ( int i = 0; i < nsrc; ++i )
+        ReedSolomon::MulAdd(coeffs[i], src[i], dst, len);
+}
+
+
+void
+ReedSolomon::MulAdd ( uint8_t c, const uint8_t * src, uint8_t * dst, size_t len )
+{
+    if ( c == 0 )
+        return;
+
+    if ( c == 1 ) {
+        for ( size_t i = 0; i < len; ++i )
+            dst[i] ^= src[i];
+        return;
+    }
+
+    const GFTables & gf = GF();
+    GetKernel().fn(gf.lo[c], gf.hi[c], gf.mul[c], src, dst, len);
+}
+
+
+const char*
+ReedSolomon::GetKernelName()
+{
+    return GetKernel().name;
+}
+
+
+uint8_t
+ReedSolomon::Mul ( uint8_t a, uint8_t b )
+{
+    return GF().mul[a][b];
+}
+
+
+uint8_t
+ReedSolomon::Inv ( uint8_t a )
+{
+    if ( a == 0 )
+        return 0;
+
+    const GFTables & gf = GF();
+    return gf.exp[255 - gf.log[a]];
+}
+
+}  // namespace
+
+// _VOLGEN_REEDSOLOMON_CPP_
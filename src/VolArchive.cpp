@@ -0,0 +1,473 @@
+/**
+  * @file   VolArchive.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLARCHIVE_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "VolArchive.h"
+#include "VolManifest.h"
+#include "FileReader.h"
+
+#include "util/StringUtils.h"
+using namespace tcanetpp;
+
+
+namespace volgen {
+
+
+#define VOLGEN_TAR_NAMESZ    100
+#define VOLGEN_TAR_MAXSIZE   077777777777ULL
+
+
+static void
+SetOctal ( char * field, size_t len, uint64_t val )
+{
+    field[len - 1] = '\0';
+
+    for ( size_t i = len - 1; i > 0; --i ) {
+        field[i - 1] = '0' + (val & 07);
+        val >>= 3;
+    }
+}
+
+
+static bool
+NeedsPax ( const std::string & name, uint64_t size, const std::string & link )
+{
+    return ( name.length() > VOLGEN_TAR_NAMESZ || size > VOLGEN_TAR_MAXSIZE
+        || link.length() > VOLGEN_TAR_NAMESZ );
+}
+
+
+static std::string
+PaxRecord ( const std::string & key, const std::string & val )
+{
+    /* the record length includes its own digits */
+    size_t len = key.length() + val.length() + 3;
+    size_t n   = len + StringUtils::ToString(len).length();
+
+    if ( StringUtils::ToString(n).length() != StringUtils::ToString(len).length() )
+        n++;
+
+    std::ostringstream rec;
+    rec << n << " " << key << "=" << val << "\n";
+
+    return rec.str();
+}
+
+
+static std::string
+PaxData ( const std::string & name, uint64_t size, const std::string & link )
+{
+    std::string data;
+
+    if ( name.length() > VOLGEN_TAR_NAMESZ )
+        data.append(PaxRecord("path", name));
+    if ( size > VOLGEN_TAR_MAXSIZE )
+        data.append(PaxRecord("size", StringUtils::ToString(size)));
+    if ( link.length() > VOLGEN_TAR_NAMESZ )
+        data.append(PaxRecord("linkpath", link));
+
+    return data;
+}
+
+
+static void
+AddUstar ( std::string & out, const std::string & name, uint64_t size,
+           time_t mtime, mode_t mode, char type, const std::string & link )
+{
+    char hdr[VOLGEN_TAR_BLOCK];
+
+    std::memset(hdr, 0, sizeof(hdr));
+    std::strncpy(&hdr[0], name.c_str(), VOLGEN_TAR_NAMESZ);
+    std::strncpy(&hdr[157], link.c_str(), VOLGEN_TAR_NAMESZ);
+
+    SetOctal(&hdr[100], 8,  mode & 07777);
+    SetOctal(&hdr[108], 8,  0);
+    SetOctal(&hdr[116], 8,  0);
+    SetOctal(&hdr[124], 12, ( size > VOLGEN_TAR_MAXSIZE ) ? 0 : size);
+    SetOctal(&hdr[136], 12, ( mtime < 0 ) ? 0 : std::min((uint64_t) mtime, (uint64_t) VOLGEN_TAR_MAXSIZE));
+    hdr[156] = type;
+    std::memcpy(&hdr[257], "ustar", 6);
+    std::memcpy(&hdr[263], "00", 2);
+
+    std::memset(&hdr[148], ' ', 8);
+
+    unsigned int sum = 0;
+    for ( size_t i = 0; i < sizeof(hdr); ++i )
+        sum += (unsigned char) hdr[i];
+
+    ::snprintf(&hdr[148], 8, "%06o", sum);
+    hdr[155] = ' ';
+
+    out.append(hdr, sizeof(hdr));
+}
+
+
+/**  Writes all of 'len' bytes, retrying short and interrupted writes */
+static bool
+WriteAll ( int fd, const char * buf, size_t len )
+{
+    while ( len > 0 )
+    {
+        ssize_t w = ::write(fd, buf, len);
+        if ( w < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+        buf += w;
+        len -= w;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Appends the header block(s) of an entry to 'out'. The 'link'
+  *  target applies to symbolic link entries.
+ **/
+void
+VolArchive::AddHeader ( std::string & out, const std::string & name,
+                        uint64_t size, time_t mtime, mode_t mode, char type,
+                        const std::string & link )
+{
+    if ( NeedsPax(name, size, link) )
+    {
+        std::string pax = PaxData(name, size, link);
+
+        AddUstar(out, "PaxHeader/" + name.substr(0, VOLGEN_TAR_NAMESZ - 10),
+                 pax.length(), mtime, 0644, 'x', "");
+        out.append(pax);
+        out.append(VolArchive::GetPadding(pax.length()), '\0');
+    }
+
+    AddUstar(out, name, size, mtime, mode, type, link);
+}
+
+
+uint64_t
+VolArchive::GetHeaderSize ( const std::string & name, uint64_t size )
+{
+    uint64_t sz = VOLGEN_TAR_BLOCK;
+
+    if ( NeedsPax(name, size, "") ) {
+        uint64_t plen = PaxData(name, size, "").length();
+        sz += VOLGEN_TAR_BLOCK + plen + VolArchive::GetPadding(plen);
+    }
+
+    return sz;
+}
+
+
+/**  Returns the archive bytes used by an entry: header and padded data */
+uint64_t
+VolArchive::GetEntrySize ( const std::string & name, uint64_t size )
+{
+    return VolArchive::GetHeaderSize(name, size) + size + VolArchive::GetPadding(size);
+}
+
+
+uint64_t
+VolArchive::GetPadding ( uint64_t size )
+{
+    uint64_t r = size % VOLGEN_TAR_BLOCK;
+    return ( r == 0 ) ? 0 : VOLGEN_TAR_BLOCK - r;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Writes an uncompressed bundle of the given source files, stored
+  *  under 'names', along with its index. A source that changed size
+  *  since the scan is stored with its size at the time of the write.
+  *  A source that cannot be read is left out of the bundle and its
+  *  index, and fails the bundle once the others are written.
+ **/
+bool
+VolArchive::WriteBundle ( const std::string & bundle, const std::string & idxfile,
+                          const std::vector<std::string> & names,
+                          const std::vector<std::string> & sources )
+{
+    FileReader  reader(256 * 1024);
+    BundleIndex index;
+    std::string hdr;
+    uint64_t    pos    = 0;
+    size_t      errors = 0;
+    bool        result = true;
+
+    int fd = ::open(bundle.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if ( fd < 0 ) {
+        std::cout << "VolArchive: Error creating bundle '" << bundle << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    for ( size_t i = 0; i < names.size() && result; ++i )
+    {
+        if ( ! reader.open(sources[i], false) ) {
+            std::cout << "VolArchive: Error reading '" << sources[i] << "' : "
+                << strerror(reader.getError()) << std::endl;
+            errors++;
+            continue;
+        }
+
+        const struct stat & sb = reader.getStat();
+        BundleEntry entry;
+
+        hdr.clear();
+        VolArchive::AddHeader(hdr, names[i], sb.st_size, sb.st_mtime, sb.st_mode);
+
+        entry.name   = names[i];
+        entry.size   = sb.st_size;
+        entry.offset = pos + hdr.length();
+
+        uint64_t left = sb.st_size;
+        const char * data = NULL;
+        ssize_t rd;
+
+        if ( ! WriteAll(fd, hdr.data(), hdr.length()) )
+            result = false;
+        pos += hdr.length();
+
+        while ( result && left > 0 && (rd = reader.read(&data)) > 0 )
+        {
+            size_t len = ( (uint64_t) rd > left ) ? left : rd;
+            if ( ! WriteAll(fd, data, len) )
+                result = false;
+            left -= len;
+            pos  += len;
+        }
+
+        /* zero fill a file that shrank so the header stays correct */
+        std::string pad(left + VolArchive::GetPadding(sb.st_size), '\0');
+
+        if ( left > 0 )
+            std::cout << "VolArchive: Warning, short read for '" << sources[i] << "'" << std::endl;
+        if ( result && ! pad.empty() && ! WriteAll(fd, pad.data(), pad.length()) )
+            result = false;
+        pos += pad.length();
+
+        reader.close();
+        index.push_back(entry);
+    }
+
+    std::string eof(VOLGEN_TAR_EOFSZ, '\0');
+
+    if ( result && ! WriteAll(fd, eof.data(), eof.length()) )
+        result = false;
+
+    if ( ::close(fd) < 0 )
+        result = false;
+
+    if ( ! result ) {
+        std::cout << "VolArchive: Error writing bundle '" << bundle << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if ( ! VolArchive::WriteIndex(idxfile, index) )
+        return false;
+
+    if ( errors > 0 ) {
+        std::cout << "VolArchive: " << errors << " file(s) could not be read into bundle '"
+            << bundle << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolArchive::ReadIndex ( const std::string & idxfile, BundleIndex & index )
+{
+    std::ifstream ifs(idxfile.c_str());
+    std::string   line;
+
+    if ( ! ifs )
+        return false;
+
+    index.clear();
+
+    while ( std::getline(ifs, line) )
+    {
+        std::vector<std::string> fields;
+        StringUtils::split(line, '\t', std::back_inserter(fields));
+
+        if ( fields.size() != 3 )
+            return false;
+
+        BundleEntry entry;
+        entry.offset = ::strtoull(fields[0].c_str(), NULL, 10);
+        entry.size   = ::strtoull(fields[1].c_str(), NULL, 10);
+        entry.name   = VolManifest::Unescape(fields[2]);
+
+        index.push_back(entry);
+    }
+
+    return true;
+}
+
+
+bool
+VolArchive::WriteIndex ( const std::string & idxfile, const BundleIndex & index )
+{
+    std::ofstream ofs(idxfile.c_str(), std::ios::out | std::ios::trunc);
+
+    if ( ! ofs ) {
+        std::cout << "VolArchive: Error creating index '" << idxfile << "'" << std::endl;
+        return false;
+    }
+
+    for ( size_t i = 0; i < index.size(); ++i )
+        ofs << index[i].offset << '\t' << index[i].size << '\t'
+            << VolManifest::Escape(index[i].name) << '\n';
+
+    ofs.close();
+
+    return ( ! ofs.fail() );
+}
+
+// -------------------------------------------------------------- //
+
+uint64_t
+VolArchive::GetOctal ( const char * field, size_t len )
+{
+    uint64_t val = 0;
+
+    for ( size_t i = 0; i < len && field[i] != '\0'; ++i ) {
+        if ( field[i] >= '0' && field[i] <= '7' )
+            val = (val << 3) + (field[i] - '0');
+    }
+
+    return val;
+}
+
+
+bool
+VolArchive::ReadBlock ( int fd, uint64_t off, char * blk )
+{
+    ssize_t rd;
+
+    while ( (rd = ::pread(fd, blk, VOLGEN_TAR_BLOCK, off)) < 0 && errno == EINTR )
+        ;
+
+    return ( rd == VOLGEN_TAR_BLOCK );
+}
+
+
+/**  Walks the headers of a tar image, collecting its members. Only the
+  *  headers are read, the data of each member is skipped over.
+ **/
+bool
+VolArchive::ScanImage ( int fd, TarMemberMap & members )
+{
+    char        hdr[VOLGEN_TAR_BLOCK];
+    uint64_t    off = 0;
+    std::string paxpath, paxlink;
+    uint64_t    paxsize = UINT64_MAX;
+
+    while ( VolArchive::ReadBlock(fd, off, hdr) && hdr[0] != '\0' )
+    {
+        if ( std::memcmp(&hdr[257], "ustar", 5) != 0 )
+            return false;
+
+        uint64_t size = VolArchive::GetOctal(&hdr[124], 12);
+        char     type = hdr[156];
+
+        if ( type == 'x' )
+        {
+            std::string pax(size, '\0');
+
+            if ( ::pread(fd, &pax[0], size, off + VOLGEN_TAR_BLOCK) != (ssize_t) size )
+                return false;
+
+            for ( size_t pos = 0; pos < pax.size(); )
+            {
+                size_t len = ::strtoull(pax.c_str() + pos, NULL, 10);
+                size_t sp  = pax.find(' ', pos);
+                size_t eq  = pax.find('=', pos);
+
+                if ( len == 0 || sp == std::string::npos || eq == std::string::npos
+                     || pos + len > pax.size() )
+                    break;
+
+                std::string key = pax.substr(sp + 1, eq - sp - 1);
+                std::string val = pax.substr(eq + 1, pos + len - eq - 2);
+
+                if ( key == "path" )
+                    paxpath = val;
+                else if ( key == "linkpath" )
+                    paxlink = val;
+                else if ( key == "size" )
+                    paxsize = ::strtoull(val.c_str(), NULL, 10);
+
+                pos += len;
+            }
+
+            off += VOLGEN_TAR_BLOCK + size + VolArchive::GetPadding(size);
+            continue;
+        }
+
+        TarMember   m;
+        std::string name(hdr, ::strnlen(hdr, 100));
+
+        if ( hdr[345] != '\0' )
+            name = std::string(&hdr[345], ::strnlen(&hdr[345], 155)) + "/" + name;
+
+        m.offset = off + VOLGEN_TAR_BLOCK;
+        m.size   = ( paxsize != UINT64_MAX ) ? paxsize : size;
+        m.mode   = VolArchive::GetOctal(&hdr[100], 8);
+        m.mtime  = VolArchive::GetOctal(&hdr[136], 12);
+        m.type   = type;
+        m.link   = ( ! paxlink.empty() ) ? paxlink : std::string(&hdr[157], ::strnlen(&hdr[157], 100));
+
+        if ( type == '2' || type == '5' )
+            m.size = 0;
+
+        members[( paxpath.empty() ) ? name : paxpath] = m;
+
+        off += VOLGEN_TAR_BLOCK + m.size + VolArchive::GetPadding(m.size);
+        paxpath.clear();
+        paxlink.clear();
+        paxsize = UINT64_MAX;
+    }
+
+    return true;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLARCHIVE_CPP_
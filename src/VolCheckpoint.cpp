@@ -0,0 +1,388 @@
+/**
+  * @file   VolCheckpoint.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLCHECKPOINT_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include "VolCheckpoint.h"
+
+
+namespace volgen {
+
+
+/**  Escapes the field separators of a path */
+static void
+AppendEscaped ( std::string & buf, const std::string & str )
+{
+    for ( size_t i = 0; i < str.size(); ++i ) {
+        switch ( str[i] ) {
+            case '\\': buf.append("\\\\"); break;
+            case '\n': buf.append("\\n");  break;
+            case '\t': buf.append("\\t");  break;
+            default:   buf.push_back(str[i]);
+        }
+    }
+}
+
+
+static std::string
+Unescape ( const std::string & str )
+{
+    std::string  r;
+
+    for ( size_t i = 0; i < str.size(); ++i ) {
+        if ( str[i] == '\\' && i + 1 < str.size() ) {
+            ++i;
+            r.push_back(( str[i] == 'n' ) ? '\n' : ( str[i] == 't' ) ? '\t' : str[i]);
+        } else {
+            r.push_back(str[i]);
+        }
+    }
+
+    return r;
+}
+
+
+/**  Splits a record into at most 'max' tab separated fields, the last
+  *  field taking the remainder of the line.
+ **/
+static size_t
+SplitRecord ( const std::string & line, std::vector<std::string> & fields, size_t max )
+{
+    size_t pos = 0;
+
+    fields.clear();
+
+    while ( fields.size() + 1 < max ) {
+        size_t tab = line.find('\t', pos);
+        if ( tab == std::string::npos )
+            break;
+        fields.push_back(line.substr(pos, tab - pos));
+        pos = tab + 1;
+    }
+    fields.push_back(line.substr(pos));
+
+    return fields.size();
+}
+
+// -------------------------------------------------------------- //
+
+VolCheckpoint::VolCheckpoint ( const std::string & filename,
+                               const std::string & root, size_t blksz )
+    : _filename(filename),
+      _root(root),
+      _blksz(blksz),
+      _fd(-1),
+      _flushed(0),
+      _completed(0),
+      _pending(0),
+      _finished(false)
+{}
+
+
+VolCheckpoint::~VolCheckpoint()
+{
+    if ( _fd >= 0 ) {
+        this->flush(true);
+        ::close(_fd);
+    }
+}
+
+// -------------------------------------------------------------- //
+
+/**  Opens the checkpoint for appending. When resuming, the completed
+  *  directories are first loaded and any partial record at the end of
+  *  the file is cut away. A checkpoint of a different root, or one
+  *  that cannot be read, is started anew.
+ **/
+bool
+VolCheckpoint::open ( bool resume )
+{
+    off_t valid = 0;
+
+    if ( resume && ! this->load(valid) ) {
+        std::cout << "VolCheckpoint: No usable checkpoint in '" << _filename
+                  << "', starting a new scan" << std::endl;
+        _dirs.clear();
+        _completed = _pending = 0;
+        _finished  = false;
+        valid      = 0;
+    }
+
+    _fd = ::open(_filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+    if ( _fd < 0 ) {
+        std::cout << "VolCheckpoint: Error opening '" << _filename << "' : "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if ( ::ftruncate(_fd, valid) < 0 || ::lseek(_fd, valid, SEEK_SET) < 0 ) {
+        std::cout << "VolCheckpoint: Error truncating '" << _filename << "' : "
+                  << strerror(errno) << std::endl;
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    if ( valid == 0 ) {
+        _buf.append(VOLGEN_CKPT_MAGIC).append("\t");
+        _buf.append(std::to_string(VOLGEN_CKPT_VERSION)).append("\t");
+        _buf.append(std::to_string(_blksz)).append("\t");
+        AppendEscaped(_buf, _root);
+        _buf.append("\n");
+    }
+
+    _flushed = ::time(NULL);
+
+    return this->flush(true);
+}
+
+
+/**  Marks the scan as completed and closes the checkpoint */
+bool
+VolCheckpoint::finish()
+{
+    if ( _fd < 0 )
+        return false;
+
+    if ( ! _finished )
+        _buf.append("T\n");
+
+    _finished = true;
+
+    bool r = this->flush(true);
+
+    ::close(_fd);
+    _fd = -1;
+
+    return r;
+}
+
+// -------------------------------------------------------------- //
+
+void
+VolCheckpoint::begin ( const std::string & path )
+{
+    if ( _fd < 0 )
+        return;
+
+    _buf.append("P\t");
+    AppendEscaped(_buf, path);
+    _buf.append("\n");
+}
+
+
+/**  Records a directory whose subtree has been read, with its files.
+  *  The buffer is written out when full or when the interval since the
+  *  last write has passed.
+ **/
+void
+VolCheckpoint::complete ( const std::string & path, uint64_t size, uint64_t blks,
+                          const DirNode * dnode )
+{
+    if ( _fd < 0 )
+        return;
+
+    size_t nfiles = ( dnode != NULL ) ? dnode->files.size() : 0;
+
+    _buf.append("D\t").append(std::to_string(size)).append("\t");
+    _buf.append(std::to_string(blks)).append("\t");
+    _buf.append(std::to_string(nfiles)).append("\t");
+    AppendEscaped(_buf, path);
+    _buf.append("\n");
+
+    if ( dnode != NULL )
+    {
+        FileNodeSet::const_iterator fIter;
+
+        for ( fIter = dnode->files.begin(); fIter != dnode->files.end(); ++fIter )
+        {
+            const std::string & name = fIter->getFileName();
+
+            _buf.append("F\t").append(std::to_string(fIter->getFileSize())).append("\t");
+            _buf.append(std::to_string(fIter->getDiskSize())).append("\t");
+            _buf.append(( fIter->symlink ) ? "1\t" : "0\t");
+            AppendEscaped(_buf, name.substr(name.find_last_of('/') + 1));
+            _buf.append("\n");
+        }
+    }
+
+    if ( _buf.size() >= VOLGEN_CKPT_BUFSZ ) {
+        this->flush(false);
+    } else {
+        time_t now = ::time(NULL);
+        if ( now - _flushed >= VOLGEN_CKPT_INTERVAL ) {
+            this->flush(true);
+            _flushed = now;
+        }
+    }
+}
+
+
+bool
+VolCheckpoint::isComplete ( const std::string & path ) const
+{
+    return( _dirs.find(path) != _dirs.end() );
+}
+
+// -------------------------------------------------------------- //
+
+/**  Loads the completed directories of the checkpoint, setting 'valid'
+  *  to the length of the file up to the last whole record.
+ **/
+bool
+VolCheckpoint::load ( off_t & valid )
+{
+    std::ifstream             ifs(_filename.c_str(), std::ios::in | std::ios::binary);
+    std::vector<std::string>  fields;
+    std::set<std::string>     pending;
+    std::string               line;
+    std::string               dpath;
+    CheckpointDir             dir;
+    size_t                    nfiles = 0;
+    off_t                     offset = 0;
+
+    if ( ! ifs || ! std::getline(ifs, line) || ifs.eof() )
+        return false;
+
+    if ( SplitRecord(line, fields, 4) != 4
+         || fields[0].compare(VOLGEN_CKPT_MAGIC) != 0
+         || ::atoi(fields[1].c_str()) != VOLGEN_CKPT_VERSION
+         || ::strtoull(fields[2].c_str(), NULL, 10) != _blksz
+         || Unescape(fields[3]).compare(_root) != 0 )
+        return false;
+
+    offset = valid = line.size() + 1;
+
+    // a line without its newline is a record cut short
+    while ( std::getline(ifs, line) && ! ifs.eof() )
+    {
+        offset += line.size() + 1;
+
+        if ( line.empty() )
+            break;
+
+        char type = line[0];
+
+        if ( nfiles > 0 )
+        {
+            if ( type != 'F' || SplitRecord(line, fields, 5) != 5 )
+                break;
+
+            FileNode fn(dpath + "/" + Unescape(fields[4]),
+                        ::strtoull(fields[1].c_str(), NULL, 10),
+                        ::strtoull(fields[2].c_str(), NULL, 10));
+            fn.symlink = ( fields[3].compare("1") == 0 );
+            dir.files.insert(fn);
+
+            if ( --nfiles > 0 )
+                continue;
+        }
+        else if ( type == 'P' )
+        {
+            if ( SplitRecord(line, fields, 2) != 2 )
+                break;
+            pending.insert(Unescape(fields[1]));
+        }
+        else if ( type == 'D' )
+        {
+            if ( SplitRecord(line, fields, 5) != 5 )
+                break;
+
+            dpath    = Unescape(fields[4]);
+            dir      = CheckpointDir();
+            dir.size = ::strtoull(fields[1].c_str(), NULL, 10);
+            dir.blks = ::strtoull(fields[2].c_str(), NULL, 10);
+            nfiles   = ::strtoull(fields[3].c_str(), NULL, 10);
+
+            if ( nfiles > 0 )
+                continue;
+        }
+        else if ( type == 'T' )
+        {
+            _finished = true;
+        }
+        else
+        {
+            break;
+        }
+
+        if ( ! dpath.empty() ) {
+            pending.erase(dpath);
+            _dirs[dpath].files.swap(dir.files);
+            _dirs[dpath].size = dir.size;
+            _dirs[dpath].blks = dir.blks;
+            dpath.clear();
+        }
+
+        valid = offset;
+    }
+
+    _completed = _dirs.size();
+    _pending   = pending.size();
+
+    return true;
+}
+
+
+/**  Writes out the buffered records, syncing them to disk if asked */
+bool
+VolCheckpoint::flush ( bool sync )
+{
+    size_t off = 0;
+
+    while ( off < _buf.size() )
+    {
+        ssize_t wt = ::write(_fd, _buf.data() + off, _buf.size() - off);
+
+        if ( wt < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            std::cout << "VolCheckpoint: Error writing '" << _filename << "' : "
+                      << strerror(errno) << ", checkpoint disabled" << std::endl;
+            _buf.clear();
+            ::close(_fd);
+            _fd = -1;
+            return false;
+        }
+        off += wt;
+    }
+    _buf.clear();
+
+    if ( sync && ::fdatasync(_fd) < 0 )
+        return false;
+
+    return true;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLCHECKPOINT_CPP_
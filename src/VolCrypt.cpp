@@ -0,0 +1,553 @@
+/**
+  * @file   VolCrypt.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLCRYPT_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(__aarch64__)
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include "VolCrypt.h"
+#include "VolGen.h"
+
+
+namespace volgen {
+
+
+static void
+PutLE ( char * buf, uint64_t val, size_t len )
+{
+    for ( size_t i = 0; i < len; ++i )
+        buf[i] = (char) ((val >> (8 * i)) & 0xff);
+}
+
+
+static uint64_t
+GetLE ( const char * buf, size_t len )
+{
+    uint64_t val = 0;
+
+    for ( size_t i = 0; i < len; ++i )
+        val |= ((uint64_t) (unsigned char) buf[i]) << (8 * i);
+
+    return val;
+}
+
+
+static void
+AppendLE ( std::string & buf, uint64_t val, size_t len )
+{
+    char b[8];
+    PutLE(b, val, len);
+    buf.append(b, len);
+}
+
+
+static bool
+ReadFull ( int fd, char * buf, size_t len, uint64_t off )
+{
+    while ( len > 0 )
+    {
+        ssize_t rd = ::pread(fd, buf, len, off);
+
+        if ( rd < 0 && errno == EINTR )
+            continue;
+        if ( rd <= 0 )
+            return false;
+
+        buf += rd;
+        off += rd;
+        len -= rd;
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+VolCrypt::VolCrypt()
+    : _key(),
+      _cipher(VolCrypt::DetectCipher()),
+      _keyed(false)
+{}
+
+
+VolCrypt::~VolCrypt()
+{
+    OPENSSL_cleanse(_key, sizeof(_key));
+}
+
+// -------------------------------------------------------------- //
+
+/**  Loads the 256 bit key from a file holding either the raw 32 bytes
+  *  or 64 hex digits.
+ **/
+bool
+VolCrypt::loadKey ( const std::string & keyfile )
+{
+    std::ifstream ifs(keyfile.c_str(), std::ios::in | std::ios::binary);
+    std::string   data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    if ( ! ifs ) {
+        std::cout << "VolCrypt: Error reading key file '" << keyfile << "'" << std::endl;
+        return false;
+    }
+
+    if ( data.size() == VOLGEN_CRYPT_KEYLEN ) {
+        std::memcpy(_key, data.data(), VOLGEN_CRYPT_KEYLEN);
+        _keyed = true;
+    } else {
+        while ( ! data.empty() && ::isspace((unsigned char) data[data.size() - 1]) )
+            data.erase(data.size() - 1);
+
+        if ( data.size() == VOLGEN_CRYPT_KEYLEN * 2
+             && data.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos )
+        {
+            for ( size_t i = 0; i < VOLGEN_CRYPT_KEYLEN; ++i )
+                _key[i] = (unsigned char) std::stoul(data.substr(i * 2, 2), NULL, 16);
+            _keyed = true;
+        }
+    }
+
+    OPENSSL_cleanse(&data[0], data.size());
+
+    if ( ! _keyed )
+        std::cout << "VolCrypt: Key file '" << keyfile << "' must hold 32 bytes or "
+                  << "64 hex digits" << std::endl;
+
+    return _keyed;
+}
+
+
+void
+VolCrypt::setCipher ( int cipher )
+{
+    if ( cipher > VOLGEN_CIPHER_NONE && cipher < VOLGEN_CIPHER_MAX )
+        _cipher = cipher;
+}
+
+
+/**  Sets up the header of a new image with a random nonce */
+bool
+VolCrypt::initHeader ( CryptHeader & hdr ) const
+{
+    hdr = CryptHeader();
+    hdr.cipher = _cipher;
+
+    return ( RAND_bytes(hdr.nonce, VOLGEN_CRYPT_NONCELEN) == 1 );
+}
+
+
+bool
+VolCrypt::seal ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                 CryptTag & tag ) const
+{
+    return this->crypt(hdr, seg, buf, len, tag.tag, true);
+}
+
+
+bool
+VolCrypt::open ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                 const CryptTag & tag ) const
+{
+    CryptTag t = tag;
+    return this->crypt(hdr, seg, buf, len, t.tag, false);
+}
+
+
+/**  Encrypts or decrypts a segment in place. The nonce is that of the
+  *  image with the segment number xor'd into its last 8 bytes, so no
+  *  nonce repeats within an image.
+ **/
+bool
+VolCrypt::crypt ( const CryptHeader & hdr, uint64_t seg, char * buf, size_t len,
+                  unsigned char * tag, bool enc ) const
+{
+    const EVP_CIPHER * cipher = ( hdr.cipher == VOLGEN_CIPHER_CHACHA )
+                                ? EVP_chacha20_poly1305() : EVP_aes_256_gcm();
+    unsigned char      nonce[VOLGEN_CRYPT_NONCELEN];
+    char               aad[VOLGEN_CRYPT_HDRSZ];
+    unsigned char *    data = (unsigned char*) buf;
+    int                outl = 0;
+    bool               ok   = false;
+
+    if ( ! _keyed || len > INT32_MAX )
+        return false;
+
+    std::memcpy(nonce, hdr.nonce, VOLGEN_CRYPT_NONCELEN);
+    for ( size_t i = 0; i < 8; ++i )
+        nonce[VOLGEN_CRYPT_NONCELEN - 1 - i] ^= (unsigned char) ((seg >> (8 * i)) & 0xff);
+
+    VolCrypt::PackHeader(hdr, aad);
+
+    EVP_CIPHER_CTX * ctx = EVP_CIPHER_CTX_new();
+
+    if ( ctx == NULL )
+        return false;
+
+    if ( EVP_CipherInit_ex(ctx, cipher, NULL, _key, nonce, enc ? 1 : 0) == 1
+         && EVP_CipherUpdate(ctx, NULL, &outl, (unsigned char*) aad, VOLGEN_CRYPT_AADSZ) == 1
+         && (len == 0 || EVP_CipherUpdate(ctx, data, &outl, data, (int) len) == 1) )
+    {
+        if ( enc ) {
+            ok = EVP_CipherFinal_ex(ctx, data + len, &outl) == 1
+                 && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, VOLGEN_CRYPT_TAGLEN, tag) == 1;
+        } else {
+            ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, VOLGEN_CRYPT_TAGLEN, tag) == 1
+                 && EVP_CipherFinal_ex(ctx, data + len, &outl) == 1;
+        }
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ok;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Extracts the named files, or every file when none are named, from
+  *  an encrypted image into 'outdir'. Only the index and the segments
+  *  holding the files are read and decrypted.
+ **/
+bool
+VolCrypt::extract ( const std::string & image, const std::vector<std::string> & names,
+                    const std::string & outdir ) const
+{
+    std::set<std::string>  wanted(names.begin(), names.end());
+    std::vector<char>      seg;
+    std::string            index;
+    CryptHeader            hdr;
+    CryptTagList           tags;
+    IndexEntryList         files;
+    uint64_t               length = 0;
+    uint64_t               nsegs  = 0;
+    uint64_t               cached = VOLGEN_CRYPT_INDEXSEG;
+    size_t                 nfiles = 0;
+    bool                   result = true;
+
+    int fd = ::open(image.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( fd < 0 ) {
+        std::cout << "VolCrypt: Error opening '" << image << "' : " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    seg.resize(VOLGEN_CRYPT_HDRSZ);
+
+    if ( ! ReadFull(fd, &seg[0], VOLGEN_CRYPT_HDRSZ, 0) || ! VolCrypt::UnpackHeader(&seg[0], hdr) ) {
+        std::cout << "VolCrypt: '" << image << "' is not an encrypted volume image" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    index.resize(hdr.indexlen);
+
+    if ( hdr.indexlen == 0
+         || ! ReadFull(fd, &index[0], hdr.indexlen, hdr.indexoff)
+         || ! this->open(hdr, VOLGEN_CRYPT_INDEXSEG, &index[0], index.size(), hdr.indextag)
+         || ! VolCrypt::UnpackIndex(index, length, tags, files) )
+    {
+        std::cout << "VolCrypt: Failed to decrypt the index of '" << image
+                  << "', wrong key or damaged image" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    seg.resize(hdr.segsz);
+
+    for ( size_t i = 0; i < files.size(); ++i )
+    {
+        const IndexEntry & file = files[i];
+
+        if ( ! names.empty() && wanted.erase(file.name) == 0 )
+            continue;
+
+        std::string path = outdir + "/" + file.name;
+        size_t      indx = path.find_last_of('/');
+
+        if ( ! VolGen::MakeDirs(path.substr(0, indx)) ) {
+            std::cout << "VolCrypt: Error creating the directory of '" << path << "'" << std::endl;
+            result = false;
+            continue;
+        }
+
+        if ( ! file.link.empty() )
+        {
+            ::unlink(path.c_str());
+
+            if ( ::symlink(file.link.c_str(), path.c_str()) < 0 ) {
+                std::cout << "VolCrypt: Error creating link '" << path << "' : "
+                          << strerror(errno) << std::endl;
+                result = false;
+                continue;
+            }
+
+            nfiles++;
+            continue;
+        }
+
+        int ofd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        if ( ofd < 0 ) {
+            std::cout << "VolCrypt: Error creating '" << path << "' : " << strerror(errno) << std::endl;
+            result = false;
+            continue;
+        }
+
+        uint64_t off = file.offset;
+        uint64_t end = file.offset + file.size;
+        bool     ok  = ( end <= length );
+
+        while ( ok && off < end )
+        {
+            uint64_t n     = off / hdr.segsz;
+            uint64_t start = n * hdr.segsz;
+            size_t   len   = std::min((uint64_t) hdr.segsz, length - start);
+            size_t   from  = off - start;
+            size_t   upto  = std::min(end - start, (uint64_t) len);
+
+            // small files share segments, so keep the last one
+            if ( n != cached ) {
+                cached = VOLGEN_CRYPT_INDEXSEG;
+                ok = ( n < tags.size() )
+                     && ReadFull(fd, &seg[0], len, VOLGEN_CRYPT_HDRSZ + start)
+                     && this->open(hdr, n, &seg[0], len, tags[n]);
+                if ( ok ) {
+                    cached = n;
+                    nsegs++;
+                }
+            }
+
+            ok = ok && ::write(ofd, &seg[from], upto - from) == (ssize_t) (upto - from);
+            off = start + upto;
+        }
+
+        if ( ::close(ofd) < 0 )
+            ok = false;
+
+        if ( ! ok ) {
+            std::cout << "VolCrypt: Failed to decrypt '" << file.name << "'" << std::endl;
+            ::unlink(path.c_str());
+            result = false;
+            continue;
+        }
+
+        nfiles++;
+    }
+
+    ::close(fd);
+
+    std::set<std::string>::iterator nIter;
+    for ( nIter = wanted.begin(); nIter != wanted.end(); ++nIter ) {
+        std::cout << "VolCrypt: '" << *nIter << "' is not in the image" << std::endl;
+        result = false;
+    }
+
+    std::cout << "VolCrypt: Extracted " << nfiles << " of " << files.size()
+              << " file(s) from " << image << ", " << nsegs << " of " << tags.size()
+              << " segment(s) decrypted" << std::endl;
+
+    return result;
+}
+
+// -------------------------------------------------------------- //
+
+void
+VolCrypt::PackHeader ( const CryptHeader & hdr, char * buf )
+{
+    std::memset(buf, 0, VOLGEN_CRYPT_HDRSZ);
+    std::memcpy(buf, VOLGEN_CRYPT_MAGIC, 8);
+    PutLE(buf + 8,  VOLGEN_CRYPT_VERSION, 4);
+    PutLE(buf + 12, hdr.cipher, 4);
+    PutLE(buf + 16, hdr.segsz, 4);
+    std::memcpy(buf + 20, hdr.nonce, VOLGEN_CRYPT_NONCELEN);
+    PutLE(buf + 32, hdr.indexoff, 8);
+    PutLE(buf + 40, hdr.indexlen, 8);
+    std::memcpy(buf + 48, hdr.indextag.tag, VOLGEN_CRYPT_TAGLEN);
+}
+
+
+bool
+VolCrypt::UnpackHeader ( const char * buf, CryptHeader & hdr )
+{
+    if ( std::memcmp(buf, VOLGEN_CRYPT_MAGIC, 8) != 0
+         || GetLE(buf + 8, 4) != VOLGEN_CRYPT_VERSION )
+        return false;
+
+    hdr.cipher   = (int) GetLE(buf + 12, 4);
+    hdr.segsz    = (uint32_t) GetLE(buf + 16, 4);
+    std::memcpy(hdr.nonce, buf + 20, VOLGEN_CRYPT_NONCELEN);
+    hdr.indexoff = GetLE(buf + 32, 8);
+    hdr.indexlen = GetLE(buf + 40, 8);
+    std::memcpy(hdr.indextag.tag, buf + 48, VOLGEN_CRYPT_TAGLEN);
+
+    return ( hdr.cipher > VOLGEN_CIPHER_NONE && hdr.cipher < VOLGEN_CIPHER_MAX
+             && hdr.segsz > 0 && hdr.segsz % VOLGEN_CRYPT_HDRSZ == 0 );
+}
+
+
+/**  The index is the archive length, the tag of each segment, and the
+  *  offset and size of each file's data within the archive, or the
+  *  target of a symlink.
+ **/
+void
+VolCrypt::PackIndex ( std::string & buf, uint64_t length, const CryptTagList & tags,
+                      const IndexEntryList & files )
+{
+    buf.clear();
+    buf.reserve(24 + tags.size() * VOLGEN_CRYPT_TAGLEN + files.size() * 64);
+
+    AppendLE(buf, length, 8);
+    AppendLE(buf, tags.size(), 8);
+
+    for ( size_t i = 0; i < tags.size(); ++i )
+        buf.append((const char*) tags[i].tag, VOLGEN_CRYPT_TAGLEN);
+
+    AppendLE(buf, files.size(), 8);
+
+    for ( size_t i = 0; i < files.size(); ++i ) {
+        AppendLE(buf, files[i].offset, 8);
+        AppendLE(buf, files[i].size, 8);
+        AppendLE(buf, files[i].name.size(), 4);
+        buf.append(files[i].name);
+        AppendLE(buf, files[i].link.size(), 4);
+        buf.append(files[i].link);
+    }
+}
+
+
+bool
+VolCrypt::UnpackIndex ( const std::string & buf, uint64_t & length, CryptTagList & tags,
+                        IndexEntryList & files )
+{
+    const char * p   = buf.data();
+    const char * end = p + buf.size();
+
+    if ( end - p < 16 )
+        return false;
+
+    length = GetLE(p, 8);
+    uint64_t ntags = GetLE(p + 8, 8);
+    p += 16;
+
+    if ( ntags > (uint64_t) (end - p) / VOLGEN_CRYPT_TAGLEN )
+        return false;
+
+    tags.resize(ntags);
+    for ( size_t i = 0; i < ntags; ++i, p += VOLGEN_CRYPT_TAGLEN )
+        std::memcpy(tags[i].tag, p, VOLGEN_CRYPT_TAGLEN);
+
+    if ( end - p < 8 )
+        return false;
+
+    uint64_t nfiles = GetLE(p, 8);
+    p += 8;
+
+    for ( uint64_t i = 0; i < nfiles; ++i )
+    {
+        if ( end - p < 20 )
+            return false;
+
+        IndexEntry entry;
+        entry.offset = GetLE(p, 8);
+        entry.size   = GetLE(p + 8, 8);
+        size_t nlen  = GetLE(p + 16, 4);
+        p += 20;
+
+        if ( (size_t) (end - p) < nlen )
+            return false;
+
+        entry.name.assign(p, nlen);
+        p += nlen;
+
+        if ( end - p < 4 )
+            return false;
+
+        size_t llen = GetLE(p, 4);
+        p += 4;
+
+        if ( (size_t) (end - p) < llen )
+            return false;
+
+        entry.link.assign(p, llen);
+        p += llen;
+
+        files.push_back(entry);
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+int
+VolCrypt::DetectCipher()
+{
+    return ( VolCrypt::HasAesAccel() ) ? VOLGEN_CIPHER_AESGCM : VOLGEN_CIPHER_CHACHA;
+}
+
+
+/**  Whether the cpu has AES instructions. OpenSSL selects its AES-NI,
+  *  VAES or ARMv8 code paths at runtime on its own.
+ **/
+bool
+VolCrypt::HasAesAccel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("aes");
+#elif defined(__aarch64__)
+    return ( ::getauxval(AT_HWCAP) & HWCAP_AES ) != 0;
+#else
+    return false;
+#endif
+}
+
+
+const char*
+VolCrypt::GetCipherName ( int cipher )
+{
+    switch ( cipher ) {
+        case VOLGEN_CIPHER_AESGCM:
+            return "aes-256-gcm";
+        case VOLGEN_CIPHER_CHACHA:
+            return "chacha20-poly1305";
+    }
+
+    return "none";
+}
+
+}  // namespace
+
+// _VOLGEN_VOLCRYPT_CPP_
@@ -0,0 +1,155 @@
+/**
+  * @file   VolEstimate.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLESTIMATE_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <zstd.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+
+#include "VolEstimate.h"
+
+
+namespace volgen {
+
+
+VolEstimate::VolEstimate ( int pct, int level )
+    : _cctx(ZSTD_createCCtx()),
+      _buf(VOLGEN_SAMPLE_BLOCK),
+      _dst(ZSTD_compressBound(VOLGEN_SAMPLE_BLOCK)),
+      _stride(VOLGEN_SAMPLE_BLOCK * 100ULL),
+      _level(level),
+      _sampled(0),
+      _compressed(0)
+{
+    if ( pct > 0 && pct <= 100 )
+        _stride = (VOLGEN_SAMPLE_BLOCK * 100ULL) / pct;
+}
+
+
+VolEstimate::~VolEstimate()
+{
+    ZSTD_freeCCtx(_cctx);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Samples a run of directories, in tree order, setting the ratio of
+  *  each. Returns false if the run was too small to be sampled, in
+  *  which case the ratios are left unchanged.
+ **/
+bool
+VolEstimate::sample ( const std::vector<DirNode*> & dirs )
+{
+    std::vector<uint64_t> raw(dirs.size(), 0), comp(dirs.size(), 0);
+
+    uint64_t pos   = _stride / 2;
+    uint64_t base  = 0;
+    uint64_t traw  = 0;
+    uint64_t tcomp = 0;
+
+    if ( _cctx == NULL )
+        return false;
+
+    for ( size_t i = 0; i < dirs.size(); ++i )
+    {
+        FileNodeSet::const_iterator fIter;
+
+        for ( fIter = dirs[i]->files.begin(); fIter != dirs[i]->files.end(); ++fIter )
+        {
+            uint64_t sz = fIter->getFileSize();
+
+            if ( fIter->symlink || sz == 0 )
+                continue;
+
+            if ( pos < base + sz ) {
+                this->sampleFile(*fIter, pos - base, raw[i], comp[i]);
+                pos += ((base + sz - pos + _stride - 1) / _stride) * _stride;
+            }
+
+            base += sz;
+        }
+
+        traw  += raw[i];
+        tcomp += comp[i];
+    }
+
+    if ( traw == 0 )
+        return false;
+
+    for ( size_t i = 0; i < dirs.size(); ++i ) {
+        if ( raw[i] > 0 )
+            dirs[i]->ratio = (float) comp[i] / raw[i];
+        else
+            dirs[i]->ratio = (float) tcomp / traw;
+    }
+
+    return true;
+}
+
+
+/**  Compresses a block of the file at 'first' and at every stride
+  *  after it, adding the sampled and compressed bytes. The file is
+  *  read with O_NOATIME where permitted.
+ **/
+bool
+VolEstimate::sampleFile ( const FileNode & file, uint64_t first,
+                          uint64_t & raw, uint64_t & comp )
+{
+    const std::string & path = file.getFileName();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+
+    if ( fd < 0 && errno == EPERM )
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 )
+        return false;
+
+    for ( uint64_t off = first; off < file.getFileSize(); off += _stride )
+    {
+        size_t  len = std::min((uint64_t) _buf.size(), file.getFileSize() - off);
+        ssize_t rd  = ::pread(fd, &_buf[0], len, off);
+
+        if ( rd <= 0 )
+            break;
+
+        size_t csz = ZSTD_compressCCtx(_cctx, &_dst[0], _dst.size(), &_buf[0], rd, _level);
+
+        if ( ZSTD_isError(csz) )
+            break;
+
+        raw         += rd;
+        comp        += csz;
+        _sampled    += rd;
+        _compressed += csz;
+    }
+
+    ::close(fd);
+
+    return true;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLESTIMATE_CPP_
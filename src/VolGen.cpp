@@ -22,13 +22,29 @@
 extern "C" {
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 }
 
 #include <sys/stat.h>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <unordered_map>
 
 #include "VolGen.h"
+#include "FileReader.h"
+#include "ThreadPool.hpp"
+#include "VolParity.h"
+#include "VolArchive.h"
+#include "OutputWriter.h"
+#include "VolWriter.h"
 
 #include "util/FileUtils.h"
 #include "util/StringUtils.h"
@@ -37,26 +53,17 @@ using namespace tcanetpp;
 
 namespace volgen {
 
+/**  A bundle to be written by generateVolumes() */
+struct BundleJob {
+    std::string               bundle;
+    std::string               index;
+    std::vector<std::string>  names;
+    std::vector<std::string>  sources;
+};
+
 // -------------------------------------------------------------- //
 // DirTree Predicates
 
-/**  Predicate for accumulating the total size of a directory */
-struct DirSizePredicate {
-    uint64_t  fsize, dsize, dcount, fcount;
-
-    explicit DirSizePredicate()
-      : fsize(0), dsize(0), dcount(0), fcount(0)
-    {}
-
-    void operator() ( const DirTree::Node * node )
-    {
-        fsize  += node->getValue().getFileSize();
-        dsize  += node->getValue().getDiskSize();
-        fcount += node->getValue().getFileCount();
-        dcount++;
-    }
-};
-
 // -------------------------------------------------------------- //
 /** Predicate for displaying the size of a directory tree */
 struct PrintTreePredicate {
@@ -84,8 +91,7 @@ struct PrintTreePredicate {
 
     void operator() ( DirTree::Node * node )
     {
-        DirSizePredicate dirSz;
-        tree->depthFirstTraversal(node, dirSz);
+        const DirNode & dnode = node->getValue();
 
         std::string name = "/";
         name.append(node->getAbsoluteName());
@@ -101,8 +107,8 @@ struct PrintTreePredicate {
         cnts << node->getChildren().size() << "/"
              << node->getValue().getFileCount();
 
-        float sz  = ((float)dirSz.dsize / 1024);
-        float dmb = ((float)dirSz.dsize / (1024 * 1024));
+        float sz  = ((float)dnode.tdsize / 1024);
+        float dmb = ((float)dnode.tdsize / (1024 * 1024));
 
         std::cout << std::setw(20) << std::setiosflags(std::ios_base::left);
         if ( sz < 100.0 )
@@ -123,14 +129,85 @@ struct PrintTreePredicate {
 };
 
 
+// -------------------------------------------------------------- //
+/** Predicate for writing the directory tree as records */
+struct WriteTreePredicate {
+    OutputWriter  * out;
+    std::string     rootpath;
+    int             format;
+    size_t        * count;
+
+    explicit WriteTreePredicate ( OutputWriter      * writer,
+                                  const std::string & rootPath,
+                                  int                 fmt,
+                                  size_t            * cnt )
+        : out(writer),
+          rootpath(rootPath),
+          format(fmt),
+          count(cnt)
+    {}
+
+    void operator() ( DirTree::Node * node )
+    {
+        const DirNode & dnode = node->getValue();
+
+        std::string name = "/";
+        name.append(node->getAbsoluteName());
+
+        if ( StringUtils::StartsWith(name, rootpath) )
+            name = name.substr(rootpath.length());
+        if ( StringUtils::StartsWith(name, "/") )
+            name = name.substr(1);
+        if ( name.empty() )
+            name = ".";
+
+        if ( format == VOLGEN_FORMAT_CSV ) {
+            out->write("dir,,").csv(name).write(",dir,").number(dnode.tdsize).put(',')
+                .number(dnode.tfsize).write(",,").number(dnode.tdirs).put(',')
+                .number(dnode.tfiles).put('\n');
+            return;
+        }
+
+        if ( format == VOLGEN_FORMAT_JSON )
+            out->write(( *count == 0 ) ? "\n    {" : ",\n    {");
+        else
+            out->write("{\"record\":\"dir\",");
+
+        out->write("\"name\":").json(name)
+            .write(",\"size\":").number(dnode.tdsize)
+            .write(",\"file_size\":").number(dnode.tfsize)
+            .write(",\"dirs\":").number(dnode.tdirs)
+            .write(",\"files\":").number(dnode.tfiles)
+            .put('}');
+
+        if ( format == VOLGEN_FORMAT_NDJSON )
+            out->put('\n');
+
+        (*count)++;
+    }
+};
+
+
 // -------------------------------------------------------------- //
 
 
 VolGen::VolGen ( const std::string & path )
-    : _curv(NULL),
-      _path(path),
+    : _path(path),
+      _ckpt(NULL),
+      _prof(NULL),
       _volsz(VOLGEN_VOLUME_MB),
       _blksz(VOLGEN_BLOCKSIZE),
+      _threads(0),
+      _bundlesz(0),
+      _strategy(VOLGEN_PACK_NEXT),
+      _linkmode(VOLGEN_LINK_SYMLINK),
+      _topn(0),
+      _maxdepth(-1),
+      _margin(VOLGEN_ESTIMATE_MARGIN),
+      _samplepct(VOLGEN_SAMPLE_PCT),
+      _estimate(false),
+      _sampled(0),
+      _unread(0),
       _debug(false)
 {
 }
@@ -138,6 +215,10 @@ VolGen::VolGen ( const std::string & path )
 VolGen::~VolGen()
 {
     this->reset();
+    if ( _ckpt )
+        delete _ckpt;
+    if ( _prof )
+        delete _prof;
 }
 
 // -------------------------------------------------------------- //
@@ -148,372 +229,2234 @@ VolGen::~VolGen()
 bool
 VolGen::read()
 {
-    this->reset();
-    return this->readDirectory(_path);
-}
+    bool result = true;
 
+    this->reset();
+    _unread = 0;
 
-/**  Reset volume set */
-void
-VolGen::reset()
-{
-    VolumeList::iterator vIter;
+    if ( _ckpt != NULL && _ckpt->isComplete(_path) ) {
+        this->loadCheckpoint(_path);
+    } else {
+        result = this->readDirectory(_path);
 
-    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
-        delete *vIter;
+        if ( _ckpt != NULL && _unread == 0 ) {
+            DirTree::Node * root = _dtree.find(_path);
+            _ckpt->complete(_path, 0, 0, ( root ) ? &root->getValue() : NULL);
+        }
+    }
 
-    _vols.clear();
-    _curv = NULL;
-}
+    // directories that could not be read are left for a resume
+    if ( _ckpt != NULL && result && _unread == 0 )
+        _ckpt->finish();
 
+    this->rollup();
 
-/**  Creates a list of Volumes from the directory tree. */
-void
-VolGen::createVolumes()
-{
-    return this->createVolumes(_path);
+    return result;
 }
 
-// -------------------------------------------------------------- //
 
-/**  Used for recursively walking the directory tree */
+/**  Reads (or re-reads) the directory subtree at the given path,
+  *  replacing any existing subtree and updating the rolled-up sizes
+  *  of its parents. Used for maintaining a live tree.
+ **/
 bool
-VolGen::readDirectory ( const std::string & path )
+VolGen::readPath ( const std::string & path )
 {
-    DIR*           dirp;
-    struct dirent* dire;
-    struct stat    fsb, lsb;
-    std::string    dname;
-
-    uint64_t       size    = 0;
-    uint64_t       blks    = 0;
-    uint64_t       bytotal = 0;
-    uint64_t       bltotal = 4096;
-    bool           isLink  = false;
-    bool           result  = true;
+    DirTree::Node * node = _dtree.find(path);
 
-    DirTree::Node * node = NULL;
+    if ( node != NULL )
+        this->removePath(path);
 
-    if ( _debug )
-        std::cout << "VolGen::readDirectory() " << path << std::endl;
+    DirTree::BranchNodeList  branches;
+    DirTree::BranchNodeList::iterator bIter;
 
-    if ( (dirp = ::opendir(path.c_str())) == NULL )
+    node = _dtree.insert(path, std::inserter(branches, branches.begin()));
+    if ( node == NULL ) {
+        std::cout << "Failed to insert path into DirTree " << path << std::endl;
         return false;
+    }
 
-    while ( (dire = ::readdir(dirp)) != NULL )
-    {
-        isLink = false;
-        dname  = dire->d_name;
+    for ( bIter = branches.begin(); bIter != branches.end(); ++bIter ) {
+        if ( *bIter != node )
+            this->adjustSizes(*bIter, (*bIter)->getValue().dnodesz, 0, 0, 1);
+    }
 
-        if ( dname.compare(".") == 0 || dname.compare("..") == 0 )
-            continue;
+    bool result = this->readDirectory(path);
 
-        dname = path + "/" + dname;
+    this->rollup(node);
 
-        if ( ::lstat(dname.c_str(), &lsb) < 0 ) {
-            std::cout << "lstat() failed for '" << dname << "'" << std::endl;
-            continue;
-        }
+    const DirNode & dnode = node->getValue();
+    this->adjustSizes(node->getParent(), dnode.tdsize, dnode.tfsize,
+                      dnode.tfiles, dnode.tdirs);
 
-        if ( S_ISLNK(lsb.st_mode) ) {
-            bltotal += (lsb.st_blocks * _blksz);
-            isLink = true;
-            if ( _debug )
-                std::cout << " l> " << dname << std::endl;
-        }
+    return result;
+}
 
-        if ( ::stat(dname.c_str(), &fsb) < 0 ) {
-            std::cout << "stat() failed for '" << dname << "'" << std::endl;
-            continue;
-        }
 
-        if ( ! isLink && S_ISDIR(fsb.st_mode) )
-        {
-            size = fsb.st_size;
-            blks = (fsb.st_blocks * _blksz);
-            node = _dtree.find(dname);
+/**  Updates (or adds) a single file entry in the tree from its
+  *  current state on disk. A path that no longer exists is removed.
+ **/
+bool
+VolGen::updateFile ( const std::string & fqfn )
+{
+    struct stat fsb, lsb;
+    bool        isLink = false;
 
-            if ( node == NULL )
-            {
-                DirTree::BranchNodeList  branches;
-                node = _dtree.insert(dname, std::inserter(branches, branches.begin()));
-                if ( node == NULL ) {
-                    std::cout << "Failed to insert path into DirTree " << std::endl;
-                    result = false;
-                    break;
-                }
-            }
+    if ( ::lstat(fqfn.c_str(), &lsb) < 0 )
+        return this->removePath(fqfn);
 
-            this->readDirectory(dname);
-            continue;
-        }
-        else
-        {
-            size = fsb.st_size;
-            blks = (fsb.st_blocks * _blksz);
-            node = _dtree.find(path);
+    if ( S_ISLNK(lsb.st_mode) )
+        isLink = true;
+    else if ( S_ISDIR(lsb.st_mode) )
+        return this->readPath(fqfn);
 
-            if ( node == NULL ) {
-                DirTree::BranchNodeList  branches;
-                node = _dtree.insert(path, std::inserter(branches, branches.begin()));
-                if ( node == NULL ) {
-                    std::cout << "Failed to insert path in DirTree " << path << std::endl;
-                    result = false;
-                    break;
-                } else if ( _debug ) {
-                    std::cout << "  added path '" << path << "' to DirTree" << std::endl;
-                }
-            }
+    if ( ::stat(fqfn.c_str(), &fsb) < 0 )
+        return this->removePath(fqfn);
 
-            FileNode  fn(dname, size, blks);
-            fn.symlink  = isLink;
-            DirNode & d = node->getValue();
+    std::string     path = VolGen::GetPathName(fqfn);
+    DirTree::Node * node = _dtree.find(path);
 
-            d.files.insert(fn);
+    if ( node == NULL ) {
+        DirTree::BranchNodeList  branches;
+        DirTree::BranchNodeList::iterator bIter;
 
-            bytotal += size;
-            bltotal += blks;
+        node = _dtree.insert(path, std::inserter(branches, branches.begin()));
+        if ( node == NULL ) {
+            std::cout << "Failed to insert path in DirTree " << path << std::endl;
+            return false;
         }
+        for ( bIter = branches.begin(); bIter != branches.end(); ++bIter )
+            this->adjustSizes(*bIter, (*bIter)->getValue().dnodesz, 0, 0, 1);
     }
-    ::closedir(dirp);
 
-    if ( _debug ) {
-        std::cout << "Total File sizes <" << path << ">: " << std::endl
-                  << std::setprecision(3) << (bytotal/1024)
-                  << " Kbytes. Blocks: "
-                  << std::setprecision(3) << (bltotal/1024)
-                  << std::endl;
+    DirNode &  dnode = node->getValue();
+    FileNode   fn(fqfn, fsb.st_size, (fsb.st_blocks * _blksz));
+    fn.symlink = isLink;
+
+    FileNodeSet::iterator fIter = dnode.files.find(fn);
+
+    if ( fIter != dnode.files.end() ) {
+        this->reset();  // the plan may refer to the erased node
+        if ( ! fIter->symlink )
+            this->adjustSizes(node, -((int64_t)fIter->getDiskSize()),
+                              -((int64_t)fIter->getFileSize()), -1, 0);
+        else
+            this->adjustSizes(node, 0, 0, -1, 0);
+        dnode.files.erase(fIter);
     }
 
-    return result;
+    dnode.files.insert(fn);
+
+    if ( ! fn.symlink )
+        this->adjustSizes(node, fn.getDiskSize(), fn.getFileSize(), 1, 0);
+    else
+        this->adjustSizes(node, 0, 0, 1, 0);
+
+    return true;
 }
 
-// -------------------------------------------------------------- //
 
-/**  Displays the given directory tree and associated sizes */
-void
-VolGen::displayTree()
+/**  Removes a file or a directory subtree from the tree */
+bool
+VolGen::removePath ( const std::string & fqfn )
 {
-    PrintTreePredicate show(&_dtree, _path);
+    DirTree::Node * node = _dtree.find(fqfn);
 
-    if ( _path.empty() )
+    if ( node != NULL )
     {
-        DirTree::NodeMap & nodemap = _dtree.getRoots();
-        DirTree::NodeMapIter nIter;
-        for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
-            _dtree.depthFirstTraversal(nIter->second, show);
+        DirTree::Node *     parent = node->getParent();
+        const DirNode &     dnode  = node->getValue();
+        int64_t             dsz    = dnode.tdsize;
+        int64_t             fsz    = dnode.tfsize;
+        int64_t             files  = dnode.tfiles;
+        int64_t             dirs   = dnode.tdirs;
+        std::list<DirNode>  values;
+
+        this->reset();  // the plan may refer to the erased nodes
+
+        if ( ! _dtree.erase(fqfn, std::back_inserter(values)) )
+            return false;
+
+        this->adjustSizes(parent, -dsz, -fsz, -files, -dirs);
+
+        return true;
     }
+
+    node = _dtree.find(VolGen::GetPathName(fqfn));
+
+    if ( node == NULL )
+        return false;
+
+    DirNode & dnode = node->getValue();
+    FileNodeSet::iterator fIter = dnode.files.find(FileNode(fqfn, 0));
+
+    if ( fIter == dnode.files.end() )
+        return false;
+
+    this->reset();
+
+    if ( ! fIter->symlink )
+        this->adjustSizes(node, -((int64_t)fIter->getDiskSize()),
+                          -((int64_t)fIter->getFileSize()), -1, 0);
     else
-    {
-        DirTree::Node * node = _dtree.find(_path);
-        if ( node == NULL )
-            return;
-        _dtree.depthFirstTraversal(node, show);
-    }
-    std::cout << std::endl;
+        this->adjustSizes(node, 0, 0, -1, 0);
 
-    return;
+    dnode.files.erase(fIter);
+
+    return true;
 }
 
-// -------------------------------------------------------------- //
 
-/**  Method for recursively walking the directory and file structure
-  *  for building the Volume list.
- **/
+/**  Computes the rolled-up subtree totals for every node in the tree */
 void
-VolGen::createVolumes ( const std::string & path )
+VolGen::rollup()
 {
-    DirTree::Node * node = _dtree.find(path);
+    DirTree::NodeMap & nodemap = _dtree.getRoots();
+    DirTree::NodeMapIter nIter;
 
-    if ( node == NULL ) {
-        std::cout << "volgen::createVolumes() Error locating path: "
-            << path << std::endl;
-        return;
-    }
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+        this->rollup(nIter->second);
+}
 
-    Volume * vol = NULL;
 
-    if ( _curv == NULL ) {
-        _curv = new Volume(VolGen::GetVolumeName(_vols.size()));
-        _vols.push_back(_curv);
-    }
+void
+VolGen::rollup ( DirTree::Node * node )
+{
+    DirNode & dnode = node->getValue();
+
+    dnode.tdsize = dnode.getDiskSize();
+    dnode.tfsize = dnode.getFileSize();
+    dnode.tfiles = dnode.getFileCount();
+    dnode.tdirs  = 1;
 
     DirTree::NodeMap & nodemap = node->getChildren();
     DirTree::NodeMapIter nIter;
 
     for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
     {
-        DirSizePredicate dirsize;
+        this->rollup(nIter->second);
 
-        _dtree.depthFirstTraversal(nIter->second, dirsize);
+        const DirNode & child = nIter->second->getValue();
+        dnode.tdsize += child.tdsize;
+        dnode.tfsize += child.tfsize;
+        dnode.tfiles += child.tfiles;
+        dnode.tdirs  += child.tdirs;
+    }
+}
 
-        float dmb = (dirsize.dsize / (1024 * 1024));
-        float vrt = (dmb / _volsz) * 100.0;
 
-        if ( dirsize.fsize == 0 )
-            continue;
+/**  Estimates the compressed size of the tree, after which volumes
+  *  are planned by the estimate plus the safety margin. Directories
+  *  are sampled in runs of tree order, on the thread pool, with each
+  *  run large enough to receive several samples. A run too small to
+  *  be sampled takes the ratio of the whole tree.
+ **/
+bool
+VolGen::estimate()
+{
+    DirTree::Node * root = _dtree.find(_path);
 
-        if ( vrt > 95.0 ) {
-            std::string dirstr = "/" + nIter->second->getAbsoluteName();
-            this->createVolumes(dirstr);
-            continue;
+    if ( root == NULL ) {
+        std::cout << "VolGen::estimate() Error locating path: " << _path << std::endl;
+        return false;
+    }
+
+    struct SampleRun {
+        std::vector<DirNode*>  dirs;
+        uint64_t               sampled;
+        uint64_t               compressed;
+        bool                   ok;
+
+        SampleRun() : sampled(0), compressed(0), ok(false) {}
+    };
+
+    std::vector<SampleRun>       runs(1);
+    std::vector<DirTree::Node*>  stack(1, root);
+    uint64_t                     runsz  = VolEstimate(_samplepct).getStride() * 16;
+    uint64_t                     bytes  = 0;
+
+    while ( ! stack.empty() )
+    {
+        DirTree::Node * node = stack.back();
+        stack.pop_back();
+
+        DirNode & dnode = node->getValue();
+
+        if ( bytes >= runsz ) {
+            runs.push_back(SampleRun());
+            bytes = 0;
         }
+        runs.back().dirs.push_back(&dnode);
+        bytes += dnode.getFileSize();
 
-        vol = _curv;
+        DirTree::NodeMap & nodemap = node->getChildren();
+        DirTree::NodeMap::reverse_iterator nIter;
 
-        VolumeItem  item;
-        item.fullname = "/" + nIter->second->getAbsoluteName();
-        item.name     = VolGen::GetRelativePath(item.fullname, _path);
-        item.size     = dmb;
-        item.vratio   = vrt;
+        for ( nIter = nodemap.rbegin(); nIter != nodemap.rend(); ++nIter )
+            stack.push_back(nIter->second);
+    }
 
-        if ( _debug )
-            std::cout << " ->  VolumeItem: (dir)  " << item.name 
-                << " sz: " << item.size 
-                << " vratio: " << item.vratio << std::endl;
+    {
+        ThreadPool pool(std::min(this->getThreads(), runs.size()));
+        int        pct = _samplepct;
 
-        if ( (vol->vtotal + vrt) > 95.0 ) {
-            vol   = new Volume(VolGen::GetVolumeName(_vols.size()));
-            _curv = vol;
-            _vols.push_back(vol);
+        for ( size_t i = 0; i < runs.size(); ++i )
+        {
+            SampleRun * run = &runs[i];
+
+            pool.push([run, pct] {
+                VolEstimate est(pct);
+                run->ok         = est.sample(run->dirs);
+                run->sampled    = est.getSampled();
+                run->compressed = est.getCompressed();
+            });
         }
 
-        vol->size   += item.size;
-        vol->vtotal += item.vratio;
-        vol->items.push_back(item);
+        pool.wait();
     }
 
-    FileNodeSet & assets = node->getValue().files;
-    FileNodeSet::iterator  fIter;
+    uint64_t sampled = 0, compressed = 0;
 
-    for ( fIter = assets.begin(); fIter != assets.end(); ++fIter )
-    {
-        const FileNode & file = *fIter;
-        VolumeItem       item;
+    for ( size_t i = 0; i < runs.size(); ++i ) {
+        sampled    += runs[i].sampled;
+        compressed += runs[i].compressed;
+    }
 
-        float fmb = (file.getDiskSize() / (1024 * 1024));
-        float vrt = (fmb / _volsz) * 100.0;
+    float ratio = ( sampled > 0 ) ? (float) compressed / sampled : 1.0;
 
-        if ( vrt > 95.0 ) {
-            std::cout << "VolGen::createVolumes() WARNING: File is larger than volume size, skipping file: "
-                      << file.getFileName() << std::endl;
+    for ( size_t i = 0; i < runs.size(); ++i ) {
+        if ( runs[i].ok )
             continue;
-        }
+        for ( size_t j = 0; j < runs[i].dirs.size(); ++j )
+            runs[i].dirs[j]->ratio = ratio;
+    }
 
-        vol = _curv;
+    this->rollupEstimate(root);
+    _estimate = true;
+    _sampled  = sampled;
 
-        item.fullname = file.getFileName();
-        item.name     = VolGen::GetRelativePath(item.fullname, _path);
-        item.size     = fmb;
-        item.vratio   = vrt;
+    return true;
+}
 
-        if ( _debug )
-            std::cout << " ->  VolumeItem (file): " << item.name 
-                << " sz: " << item.size 
-                << " vratio: " << item.vratio << std::endl;
 
-        if ( (vol->vtotal + vrt) > 95.0 ) {
-            vol   = new Volume(VolGen::GetVolumeName(_vols.size()));
-            _curv = vol;
-            _vols.push_back(vol);
-        }
+/**  Displays the result of estimate() */
+void
+VolGen::displayEstimate()
+{
+    DirTree::Node * root = _dtree.find(_path);
 
-        vol->size   += item.size;
-        vol->vtotal += item.vratio;
-        vol->items.push_back(item);
-    }
+    if ( root == NULL || ! _estimate )
+        return;
 
-    return;
+    const DirNode & dnode = root->getValue();
+
+    std::cout << "VolGen: Estimated compressed size " << (dnode.tcsize / (1024 * 1024))
+              << " Mb of " << (dnode.tfsize / (1024 * 1024)) << " Mb with a "
+              << _margin << "% margin, sampled " << (_sampled / (1024 * 1024))
+              << " Mb" << std::endl;
 }
 
-// -------------------------------------------------------------- //
 
-/**  Displays the created Volume list */
 void
-VolGen::displayVolumes ( bool show )
+VolGen::rollupEstimate ( DirTree::Node * node )
 {
-    VolumeList::iterator vIter;
+    DirNode & dnode = node->getValue();
+    FileNodeSet::const_iterator fIter;
 
-    std::cout << "Number of volumes = " << _vols.size() << std::endl;
+    dnode.tcsize = dnode.dnodesz;
 
-    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
-    {
-        Volume * vol = (Volume*) *vIter;
-        std::cout << vol->name   << " : "  << vol->size << " Mb : "
-                  << vol->vtotal << "% : " << vol->items.size()
-                  << " item(s)"  << std::endl;
-        if ( show ) {
-            ItemList::iterator iIter;
-            for ( iIter = vol->items.begin(); iIter != vol->items.end(); ++iIter )
-                std::cout << "   " << iIter->name << " : " << iIter->size << " Mb : "
-                          << std::setprecision(3) << iIter->vratio << " %" << std::endl;
-        }
+    for ( fIter = dnode.files.begin(); fIter != dnode.files.end(); ++fIter ) {
+        if ( ! fIter->symlink )
+            dnode.tcsize += this->getEstimate(fIter->getFileSize(), dnode.ratio);
     }
-    std::cout << std::endl;
 
-    return;
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter ) {
+        this->rollupEstimate(nIter->second);
+        dnode.tcsize += nIter->second->getValue().tcsize;
+    }
 }
 
-// -------------------------------------------------------------- //
 
-/**  Generates the volume linkage in the given path */
+/**  Applies a size delta to the given node and all of its parents */
 void
-VolGen::generateVolumes ( const std::string & volgenpath )
+VolGen::adjustSizes ( DirTree::Node * node, int64_t dsz, int64_t fsz,
+                      int64_t files, int64_t dirs )
 {
-    VolumeList::iterator vIter;
-    std::string volpath;
-
-    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+    for ( ; node != NULL; node = node->getParent() )
     {
-        Volume * vol = *vIter;
+        DirNode & dnode = node->getValue();
+        dnode.tdsize += dsz;
+        dnode.tfsize += fsz;
+        dnode.tfiles += files;
+        dnode.tdirs  += dirs;
+    }
+}
+
+
+/**  Reset volume set */
+void
+VolGen::reset()
+{
+    _vols.clear();
+    _items.clear();
+    _skipped.clear();
+}
+
+
+/**  Creates a list of Volumes from the directory tree. */
+void
+VolGen::createVolumes()
+{
+    VolumePlan plan(this->getVolumeLimit(), _strategy);
+
+    this->reset();
+
+    if ( ! this->createPlan(plan, this->getThreads()) )
+        return;
+
+    for ( size_t i = 0; i < plan.skipped.size(); ++i )
+        std::cout << "VolGen::createVolumes() WARNING: File is larger than volume size, skipping file: "
+                  << plan.skipped[i]->getFileName() << std::endl;
+
+    _vols.swap(plan.vols);
+    _items.swap(plan.items);
+    _skipped.swap(plan.skipped);
+
+    if ( _debug ) {
+        for ( size_t i = 0; i < _items.size(); ++i )
+            std::cout << " ->  VolumeItem "
+                << (( _items[i].bundle ) ? "(bundle): " : ( _items[i].file ) ? "(file): " : "(dir):  ")
+                << this->getItemName(_items[i]) << " sz: " << _items[i].size << std::endl;
+    }
+
+    return;
+}
+
+
+/**  Plans the volumes as createVolumes(), without any output, and
+  *  returns the plan as a result independent of the tree. Each volume
+  *  is passed to 'fn' as it is completed. The plan is also kept for
+  *  the generate calls.
+ **/
+PlanResult
+VolGen::plan ( const VolumeVisitor & fn )
+{
+    PlanResult result;
+    VolumePlan vplan(this->getVolumeLimit(), _strategy);
+
+    this->reset();
+
+    result._limit = vplan.limit;
+
+    if ( ! this->createPlan(vplan, this->getThreads()) )
+        return result;
+
+    for ( size_t i = 0; i < vplan.skipped.size(); ++i )
+        result._skipped.push_back(vplan.skipped[i]->getFileName());
+
+    _vols.swap(vplan.vols);
+    _items.swap(vplan.items);
+    result._vols.reserve(_vols.size());
+
+    for ( size_t v = 0; v < _vols.size(); ++v )
+    {
+        const Volume & vol = _vols[v];
+        PlanVolume     pvol;
+
+        pvol.name = vol.name;
+        pvol.size = vol.size;
+        pvol.entries.resize(vol.count);
+
+        for ( size_t i = 0; i < vol.count; ++i )
+        {
+            const VolumeItem & item  = _items[vol.first + i];
+            PlanEntry        & entry = pvol.entries[i];
+
+            entry.name = this->getItemName(item);
+            entry.path = this->getItemPath(item);
+            entry.size = item.size;
+            entry.type = ( item.bundle ) ? VOLGEN_ITEM_BUNDLE
+                       : ( item.file != NULL ) ? VOLGEN_ITEM_FILE : VOLGEN_ITEM_DIR;
+        }
+
+        if ( fn )
+            fn(pvol);
+
+        result._vols.push_back(std::move(pvol));
+    }
+
+    return result;
+}
+
+
+/**  Plans the tree into volumes of the plan's size limit. Subtrees too
+  *  large for a single volume are planned independently, deepest
+  *  first, with the subtrees of each level planned in parallel. Each
+  *  plan is then merged into its parent in tree order, so the result
+  *  does not depend on the number of threads.
+ **/
+bool
+VolGen::createPlan ( VolumePlan & plan, size_t nthreads )
+{
+    DirTree::Node * root = _dtree.find(_path);
+
+    if ( root == NULL ) {
+        std::cout << "volgen::createVolumes() Error locating path: "
+            << _path << std::endl;
+        return false;
+    }
+
+    std::vector< std::vector<DirTree::Node*> >  levels;
+    std::map<DirTree::Node*, VolumePlan>        plans;
+
+    levels.push_back(std::vector<DirTree::Node*>(1, root));
+
+    for ( size_t d = 0; d < levels.size(); ++d )
+    {
+        std::vector<DirTree::Node*> next;
+
+        for ( size_t i = 0; i < levels[d].size(); ++i )
+        {
+            DirTree::NodeMap & nodemap = levels[d][i]->getChildren();
+            DirTree::NodeMapIter nIter;
+
+            for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter ) {
+                if ( this->isSplit(nIter->second, plan.limit) ) {
+                    next.push_back(nIter->second);
+                    plans[nIter->second] = VolumePlan(plan.limit, plan.strategy);
+                }
+            }
+        }
+
+        if ( ! next.empty() )
+            levels.push_back(next);
+    }
+
+    if ( levels.size() > 1 )
+    {
+        ThreadPool pool(std::min(nthreads, plans.size()));
+
+        for ( size_t d = levels.size() - 1; d > 0; --d )
+        {
+            for ( size_t i = 0; i < levels[d].size(); ++i ) {
+                DirTree::Node * node = levels[d][i];
+                VolumePlan    * sub  = &plans[node];
+                pool.push([this, node, sub, &plans] {
+                    this->createVolumes(node, *sub, plans);
+                });
+            }
+            pool.wait();
+        }
+    }
+
+    this->createVolumes(root, plan, plans);
+
+    if ( plan.strategy == VOLGEN_PACK_FFD )
+        this->packDecreasing(plan);
+
+    if ( plan.vols.empty() )
+        plan.vols.push_back(Volume());
+
+    for ( size_t i = 0; i < plan.vols.size(); ++i )
+        plan.vols[i].name = VolGen::GetVolumeName(i);
+
+    return true;
+}
+
+
+/**  Plans the tree once for each combination of the given volume
+  *  sizes and strategies, in parallel, and prints a comparison. The
+  *  tail waste is the unused space of the last volume, and dir spans
+  *  the extra volumes spanned by directories (see countSpans()).
+ **/
+void
+VolGen::compareVolumes ( std::ostream & strm, const std::vector<size_t> & sizes,
+                         const std::vector<int> & strategies )
+{
+    struct PlanSummary {
+        size_t    volsz;
+        int       strategy;
+        size_t    nvols;
+        size_t    skipped;
+        double    fill;
+        uint64_t  tail;
+        uint64_t  waste;
+        size_t    spans;
+    };
+
+    std::vector<PlanSummary> results;
+
+    for ( size_t i = 0; i < sizes.size(); ++i ) {
+        for ( size_t j = 0; j < strategies.size(); ++j ) {
+            PlanSummary sum = { sizes[i], strategies[j], 0, 0, 0.0, 0, 0, 0 };
+            results.push_back(sum);
+        }
+    }
+
+    {
+        ThreadPool pool(std::min(this->getThreads(), results.size()));
+
+        for ( size_t i = 0; i < results.size(); ++i )
+        {
+            PlanSummary * sum = &results[i];
+
+            pool.push([this, sum] {
+                VolumePlan plan(VolGen::GetVolumeLimit(sum->volsz), sum->strategy);
+                uint64_t   volbytes = (uint64_t) sum->volsz * 1024 * 1024;
+
+                if ( ! this->createPlan(plan, 1) )
+                    return;
+
+                for ( size_t v = 0; v < plan.vols.size(); ++v ) {
+                    sum->fill  += (double) plan.vols[v].size / volbytes;
+                    sum->waste += volbytes - plan.vols[v].size;
+                }
+
+                sum->nvols   = plan.vols.size();
+                sum->skipped = plan.skipped.size();
+                sum->fill    = ( sum->fill / sum->nvols ) * 100.0;
+                sum->tail    = volbytes - plan.vols.back().size;
+                sum->spans   = this->countSpans(plan, _dtree.find(_path));
+            });
+        }
+
+        pool.wait();
+    }
+
+    std::ios_base::fmtflags flags = strm.flags();
+
+    strm << std::endl
+         << std::setw(12) << std::setiosflags(std::ios_base::left) << "Size (Mb)"
+         << std::setw(10) << "Strategy"
+         << std::setw(10) << "Volumes"
+         << std::setw(12) << "Fill (%)"
+         << std::setw(18) << "Tail waste (Mb)"
+         << std::setw(18) << "Total waste (Mb)"
+         << std::setw(12) << "Dir spans"
+         << "Skipped" << std::endl;
+    strm << std::setw(12) << "---------"
+         << std::setw(10) << "--------"
+         << std::setw(10) << "-------"
+         << std::setw(12) << "--------"
+         << std::setw(18) << "---------------"
+         << std::setw(18) << "----------------"
+         << std::setw(12) << "---------"
+         << "-------" << std::endl;
+
+    for ( size_t i = 0; i < results.size(); ++i )
+    {
+        const PlanSummary & sum = results[i];
+
+        strm << std::setw(12) << sum.volsz
+             << std::setw(10) << VolGen::GetStrategyName(sum.strategy)
+             << std::setw(10) << sum.nvols
+             << std::setw(12) << std::fixed << std::setprecision(2) << sum.fill
+             << std::setw(18) << (sum.tail / (1024 * 1024))
+             << std::setw(18) << (sum.waste / (1024 * 1024))
+             << std::setw(12) << sum.spans
+             << sum.skipped << std::endl;
+    }
+
+    strm << std::endl;
+    strm.flags(flags);
+
+    return;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Calls 'fn', adding its latency to the profile when profiling */
+template <typename Fn>
+static inline auto
+Timed ( VolProfile * prof, int op, Fn fn ) -> decltype(fn())
+{
+    if ( prof == NULL )
+        return fn();
+
+    uint64_t start = VolProfile::Now();
+    auto     r     = fn();
+
+    prof->record(op, VolProfile::Now() - start);
+
+    return r;
+}
+
+
+/**  Used for recursively walking the directory tree */
+bool
+VolGen::readDirectory ( const std::string & path )
+{
+    DIR*           dirp;
+    struct dirent* dire;
+    struct stat    fsb, lsb;
+    std::string    dname;
+
+    uint64_t       size    = 0;
+    uint64_t       blks    = 0;
+    uint64_t       bytotal = 0;
+    uint64_t       bltotal = 4096;
+    uint64_t       entries = 0;
+    bool           isLink  = false;
+    bool           result  = true;
+
+    DirTree::Node * node = NULL;
+
+    if ( _debug )
+        std::cout << "VolGen::readDirectory() " << path << std::endl;
+
+    if ( _prof != NULL )
+        _prof->enter(path);
+
+    dirp = Timed(_prof, VOLGEN_PROF_OPENDIR, [&] { return ::opendir(path.c_str()); });
+
+    if ( dirp == NULL ) {
+        std::cout << "opendir() failed for '" << path << "' : " << strerror(errno) << std::endl;
+        _unread++;
+        if ( _prof != NULL )
+            _prof->leave(0);
+        return false;
+    }
+
+    if ( _ckpt != NULL )
+        _ckpt->begin(path);
+
+    while ( (dire = Timed(_prof, VOLGEN_PROF_READDIR, [&] { return ::readdir(dirp); })) != NULL )
+    {
+        isLink = false;
+        dname  = dire->d_name;
+
+        if ( dname.compare(".") == 0 || dname.compare("..") == 0 )
+            continue;
+
+        entries++;
+
+        dname = path + "/" + dname;
+
+        if ( this->isExcluded(dname) )
+            continue;
+
+        if ( Timed(_prof, VOLGEN_PROF_LSTAT, [&] { return ::lstat(dname.c_str(), &lsb); }) < 0 ) {
+            std::cout << "lstat() failed for '" << dname << "'" << std::endl;
+            continue;
+        }
+
+        if ( S_ISLNK(lsb.st_mode) ) {
+            bltotal += (lsb.st_blocks * _blksz);
+            isLink = true;
+            if ( _debug )
+                std::cout << " l> " << dname << std::endl;
+        }
+
+        if ( Timed(_prof, VOLGEN_PROF_STAT, [&] { return ::stat(dname.c_str(), &fsb); }) < 0 ) {
+            std::cout << "stat() failed for '" << dname << "'" << std::endl;
+            continue;
+        }
+
+        if ( ! isLink && S_ISDIR(fsb.st_mode) )
+        {
+            size = fsb.st_size;
+            blks = (fsb.st_blocks * _blksz);
+            node = _dtree.find(dname);
+
+            if ( node == NULL )
+            {
+                DirTree::BranchNodeList  branches;
+                node = _dtree.insert(dname, std::inserter(branches, branches.begin()));
+                if ( node == NULL ) {
+                    std::cout << "Failed to insert path into DirTree " << std::endl;
+                    result = false;
+                    break;
+                }
+            }
+
+            if ( _visitor ) {
+                TreeEntry entry = { dname, size, blks, true, false };
+                _visitor(entry);
+            }
+
+            if ( _ckpt != NULL && _ckpt->isComplete(dname) ) {
+                this->loadCheckpoint(dname);
+                continue;
+            }
+
+            size_t unread = _unread;
+
+            this->readDirectory(dname);
+
+            // a subtree not fully read is left for a resume to read again
+            if ( _ckpt != NULL && _unread == unread )
+                _ckpt->complete(dname, size, blks, &node->getValue());
+            continue;
+        }
+        else
+        {
+            size = fsb.st_size;
+            blks = (fsb.st_blocks * _blksz);
+            node = _dtree.find(path);
+
+            if ( node == NULL ) {
+                DirTree::BranchNodeList  branches;
+                node = _dtree.insert(path, std::inserter(branches, branches.begin()));
+                if ( node == NULL ) {
+                    std::cout << "Failed to insert path in DirTree " << path << std::endl;
+                    result = false;
+                    break;
+                } else if ( _debug ) {
+                    std::cout << "  added path '" << path << "' to DirTree" << std::endl;
+                }
+            }
+
+            FileNode  fn(dname, size, blks);
+            fn.symlink  = isLink;
+            DirNode & d = node->getValue();
+
+            d.files.insert(fn);
+
+            if ( _visitor ) {
+                TreeEntry entry = { dname, size, blks, false, isLink };
+                _visitor(entry);
+            }
+
+            bytotal += size;
+            bltotal += blks;
+        }
+    }
+    ::closedir(dirp);
+
+    if ( _prof != NULL )
+        _prof->leave(entries);
+
+    if ( _debug ) {
+        std::cout << "Total File sizes <" << path << ">: " << std::endl
+                  << std::setprecision(3) << (bytotal/1024)
+                  << " Kbytes. Blocks: "
+                  << std::setprecision(3) << (bltotal/1024)
+                  << std::endl;
+    }
+
+    return result;
+}
+
+
+/**  Adds the subtree at 'path' from the checkpoint rather than reading
+  *  it, as read by an earlier scan. The directory node itself has been
+  *  added by the caller, other than for the root. The records loaded
+  *  are released from the checkpoint.
+ **/
+void
+VolGen::loadCheckpoint ( const std::string & path )
+{
+    CheckpointMap & dirs   = _ckpt->getDirs();
+    std::string     prefix = path + "/";
+
+    CheckpointMap::iterator first = dirs.lower_bound(prefix);
+    CheckpointMap::iterator dIter = dirs.find(path);
+    CheckpointMap::iterator last;
+
+    for ( last = first; last != dirs.end(); ++last ) {
+        if ( last->first.compare(0, prefix.size(), prefix) != 0 )
+            break;
+    }
+
+    if ( dIter != dirs.end() ) {
+        if ( ! dIter->second.files.empty() )
+            this->loadCheckpoint(dIter->first, dIter->second, false);
+        dirs.erase(dIter);
+    }
+
+    for ( dIter = first; dIter != last; ++dIter )
+        this->loadCheckpoint(dIter->first, dIter->second, true);
+
+    dirs.erase(first, last);
+}
+
+
+/**  Adds a directory of the checkpoint and its files to the tree */
+void
+VolGen::loadCheckpoint ( const std::string & path, CheckpointDir & dir, bool visit )
+{
+    DirTree::Node * node = _dtree.find(path);
+
+    if ( node == NULL )
+    {
+        DirTree::BranchNodeList  branches;
+        node = _dtree.insert(path, std::inserter(branches, branches.begin()));
+        if ( node == NULL ) {
+            std::cout << "Failed to insert path into DirTree " << path << std::endl;
+            return;
+        }
+    }
+
+    if ( visit && _visitor ) {
+        TreeEntry entry = { path, dir.size, dir.blks, true, false };
+        _visitor(entry);
+    }
+
+    if ( _visitor ) {
+        FileNodeSet::const_iterator fIter;
+        for ( fIter = dir.files.begin(); fIter != dir.files.end(); ++fIter ) {
+            TreeEntry entry = { fIter->getFileName(), fIter->getFileSize(),
+                                fIter->getDiskSize(), false, fIter->symlink };
+            _visitor(entry);
+        }
+    }
+
+    node->getValue().files.swap(dir.files);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Displays the given directory tree and associated sizes */
+void
+VolGen::displayTree()
+{
+    PrintTreePredicate show(&_dtree, _path);
+
+    this->reportTree([&show] ( DirTree::Node * node ) { show(node); });
+
+    std::cout << std::endl;
+
+    return;
+}
+
+
+/**  Calls 'fn' for each directory of the tree report. With no limits
+  *  set this is every directory, depth first. A max depth prunes the
+  *  walk itself; with a top N set, the N largest directories within
+  *  the depth are kept in a bounded min-heap during the one pass and
+  *  reported largest first.
+ **/
+void
+VolGen::reportTree ( const std::function<void(DirTree::Node*)> & fn )
+{
+    std::vector<DirTree::Node*> roots;
+
+    if ( _path.empty() )
+    {
+        DirTree::NodeMap & nodemap = _dtree.getRoots();
+        DirTree::NodeMapIter nIter;
+        for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+            roots.push_back(nIter->second);
+    }
+    else
+    {
+        DirTree::Node * node = _dtree.find(_path);
+        if ( node == NULL )
+            return;
+        roots.push_back(node);
+    }
+
+    if ( _topn == 0 && _maxdepth < 0 )
+    {
+        for ( size_t i = 0; i < roots.size(); ++i )
+            _dtree.depthFirstTraversal(roots[i], fn);
+        return;
+    }
+
+    if ( _topn == 0 ) {
+        for ( size_t i = 0; i < roots.size(); ++i )
+            this->reportTree(roots[i], 0, fn);
+        return;
+    }
+
+    auto larger = [] ( DirTree::Node * a, DirTree::Node * b ) {
+        return a->getValue().tdsize > b->getValue().tdsize;
+    };
+
+    std::vector<DirTree::Node*> heap;
+    heap.reserve(_topn + 1);
+
+    auto collect = [&heap, &larger, this] ( DirTree::Node * node ) {
+        if ( heap.size() < _topn ) {
+            heap.push_back(node);
+            std::push_heap(heap.begin(), heap.end(), larger);
+        } else if ( node->getValue().tdsize > heap.front()->getValue().tdsize ) {
+            std::pop_heap(heap.begin(), heap.end(), larger);
+            heap.back() = node;
+            std::push_heap(heap.begin(), heap.end(), larger);
+        }
+    };
+
+    for ( size_t i = 0; i < roots.size(); ++i )
+        this->reportTree(roots[i], 0, collect);
+
+    std::sort_heap(heap.begin(), heap.end(), larger);
+
+    for ( size_t i = 0; i < heap.size(); ++i )
+        fn(heap[i]);
+}
+
+
+void
+VolGen::reportTree ( DirTree::Node * node, int depth,
+                     const std::function<void(DirTree::Node*)> & fn )
+{
+    if ( _maxdepth < 0 || depth < _maxdepth )
+    {
+        DirTree::NodeMap & nodemap = node->getChildren();
+        DirTree::NodeMapIter nIter;
+
+        for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+            this->reportTree(nIter->second, depth + 1, fn);
+    }
+
+    fn(node);
+}
+
+/**  Writes the tree summary and the volume plan in a machine readable
+  *  format, streamed record by record through the writer. JSON is a
+  *  single document; NDJSON and CSV emit one record per line, with a
+  *  'record' field of dir, volume or item.
+ **/
+bool
+VolGen::writeOutput ( OutputWriter & out, int format )
+{
+    DirTree::Node * root  = _dtree.find(_path);
+    size_t          count = 0;
+    double          volbytes = (double) _volsz * 1024 * 1024;
+
+    WriteTreePredicate  tree(&out, _path, format, &count);
+
+    if ( format == VOLGEN_FORMAT_CSV )
+        out.write("record,volume,name,type,size,file_size,ratio,dirs,files\n");
+    else if ( format == VOLGEN_FORMAT_JSON )
+        out.write("{\n  \"root\": ").json(_path)
+           .write(",\n  \"volume_size\": ").number((uint64_t) volbytes)
+           .write(",\n  \"strategy\": ").json(VolGen::GetStrategyName(_strategy))
+           .write(",\n  \"tree\": [");
+
+    if ( root != NULL )
+        this->reportTree([&tree] ( DirTree::Node * node ) { tree(node); });
+
+    if ( format == VOLGEN_FORMAT_JSON )
+        out.write("\n  ],\n  \"volumes\": [");
+
+    for ( size_t v = 0; v < _vols.size(); ++v )
+    {
+        const Volume & vol   = _vols[v];
+        double         ratio = ( volbytes > 0 ) ? (vol.size / volbytes) * 100.0 : 0.0;
+
+        if ( format == VOLGEN_FORMAT_CSV ) {
+            out.write("volume,").csv(vol.name).write(",,,").number(vol.size).write(",,")
+               .number(ratio, 3).write(",,").number((uint64_t) vol.count).put('\n');
+        } else {
+            if ( format == VOLGEN_FORMAT_JSON )
+                out.write(( v == 0 ) ? "\n    {" : ",\n    {");
+            else
+                out.write("{\"record\":\"volume\",");
+            out.write("\"name\":").json(vol.name)
+               .write(",\"size\":").number(vol.size)
+               .write(",\"ratio\":").number(ratio, 3)
+               .write(",\"count\":").number((uint64_t) vol.count);
+            if ( format == VOLGEN_FORMAT_JSON )
+                out.write(",\"items\":[");
+            else
+                out.write("}\n");
+        }
+
+        for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
+        {
+            const VolumeItem & item = _items[i];
+            const char * type = ( item.bundle ) ? "bundle" : ( item.file ) ? "file" : "dir";
+            double       irat = ( volbytes > 0 ) ? (item.size / volbytes) * 100.0 : 0.0;
+
+            if ( format == VOLGEN_FORMAT_CSV ) {
+                out.write("item,").csv(vol.name).put(',').csv(this->getItemName(item))
+                   .put(',').write(type).put(',').number(item.size).write(",,")
+                   .number(irat, 3).write(",,\n");
+                continue;
+            }
+
+            if ( format == VOLGEN_FORMAT_JSON )
+                out.write(( i == vol.first ) ? "\n      {" : ",\n      {");
+            else
+                out.write("{\"record\":\"item\",\"volume\":").json(vol.name).put(',');
+
+            out.write("\"name\":").json(this->getItemName(item))
+               .write(",\"type\":\"").write(type)
+               .write("\",\"size\":").number(item.size)
+               .write(",\"ratio\":").number(irat, 3)
+               .put('}');
+
+            if ( format == VOLGEN_FORMAT_NDJSON )
+                out.put('\n');
+        }
+
+        if ( format == VOLGEN_FORMAT_JSON )
+            out.write(( vol.count > 0 ) ? "\n    ]}" : "]}");
+    }
+
+    if ( format == VOLGEN_FORMAT_JSON )
+        out.write("\n  ],\n  \"skipped\": [");
+
+    /* files larger than a volume, left out of the plan */
+    for ( size_t i = 0; i < _skipped.size(); ++i )
+    {
+        const FileNode & file = *_skipped[i];
+        std::string      name = VolGen::GetRelativePath(file.getFileName(), _path);
+
+        if ( format == VOLGEN_FORMAT_CSV ) {
+            out.write("skipped,,").csv(name).write(",file,,").number(file.getFileSize())
+               .write(",,,\n");
+            continue;
+        }
+
+        if ( format == VOLGEN_FORMAT_JSON )
+            out.write(( i == 0 ) ? "\n    {" : ",\n    {");
+        else
+            out.write("{\"record\":\"skipped\",");
+
+        out.write("\"name\":").json(name)
+           .write(",\"file_size\":").number(file.getFileSize())
+           .put('}');
+
+        if ( format == VOLGEN_FORMAT_NDJSON )
+            out.put('\n');
+    }
+
+    if ( format == VOLGEN_FORMAT_JSON )
+        out.write(( _skipped.empty() ) ? "]\n}\n" : "\n  ]\n}\n");
+
+    return out.flush();
+}
+
+// -------------------------------------------------------------- //
+
+/**  Plans the items of a single directory. Subdirectories too large
+  *  for one volume have been planned already and are merged in.
+ **/
+void
+VolGen::createVolumes ( DirTree::Node * node, VolumePlan & plan,
+                        std::map<DirTree::Node*, VolumePlan> & plans ) const
+{
+    if ( plan.strategy == VOLGEN_PACK_LOCAL ) {
+        this->packLocal(node, plan, plans);
+        return;
+    }
+
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+    {
+        const DirNode & dirsize = nIter->second->getValue();
+
+        if ( dirsize.tfsize == 0 )
+            continue;
+
+        if ( this->isSplit(nIter->second, plan.limit) ) {
+            this->mergePlan(plan, plans.find(nIter->second)->second);
+            continue;
+        }
+
+        this->addVolumeItem(plan, VolumeItem(nIter->second, NULL, this->getPlanSize(dirsize)));
+    }
+
+    FileNodeSet & assets = node->getValue().files;
+    FileNodeSet::iterator  fIter;
+
+    uint64_t bsize  = 0;
+    bool     bundle = this->hasBundle(node->getValue(), bsize);
+
+    if ( bundle ) {
+        this->addVolumeItem(plan, VolumeItem(node, NULL, bsize, true));
+    }
+
+    for ( fIter = assets.begin(); fIter != assets.end(); ++fIter )
+    {
+        const FileNode & file  = *fIter;
+        uint64_t         fsize = this->getPlanSize(node->getValue(), file);
+
+        if ( bundle && this->isBundled(file) )
+            continue;
+
+        if ( fsize > plan.limit ) {
+            plan.skipped.push_back(&file);
+            continue;
+        }
+
+        this->addVolumeItem(plan, VolumeItem(node, &file, fsize));
+    }
+
+    return;
+}
+
+
+/**  Adds an item to the last volume of the plan, starting a new volume
+  *  when the item does not fit. Items are only ever appended to the
+  *  last volume, so each volume is a contiguous range of the items.
+ **/
+void
+VolGen::addVolumeItem ( VolumePlan & plan, const VolumeItem & item ) const
+{
+    if ( plan.vols.empty() || plan.vols.back().size + item.size > plan.limit )
+        plan.vols.push_back(Volume("", plan.items.size()));
+
+    Volume & vol = plan.vols.back();
+
+    vol.size += item.size;
+    vol.count++;
+
+    plan.items.push_back(item);
+}
+
+
+/**  Merges the plan of a subtree into 'plan'. A subtree filling one
+  *  volume is packed item by item. Otherwise its full volumes are
+  *  appended, and its partially filled tail is folded into the last
+  *  volume of 'plan' when it fits, else it remains the last volume.
+  *  The subtree plan is released.
+ **/
+void
+VolGen::mergePlan ( VolumePlan & plan, VolumePlan & sub ) const
+{
+    if ( sub.vols.size() == 1 ) {
+        for ( size_t i = 0; i < sub.items.size(); ++i )
+            this->addVolumeItem(plan, sub.items[i]);
+    }
+    else if ( sub.vols.size() > 1 )
+    {
+        const Volume & tail = sub.vols.back();
+        size_t nvols = sub.vols.size();
+
+        if ( ! plan.vols.empty() && plan.vols.back().size + tail.size <= plan.limit )
+        {
+            Volume & vol = plan.vols.back();
+
+            plan.items.insert(plan.items.end(), sub.items.begin() + tail.first, sub.items.end());
+            vol.size  += tail.size;
+            vol.count += tail.count;
+            nvols--;
+        }
+
+        for ( size_t v = 0; v < nvols; ++v ) {
+            Volume vol = sub.vols[v];
+            vol.first  = plan.items.size();
+            plan.items.insert(plan.items.end(), sub.items.begin() + sub.vols[v].first,
+                              sub.items.begin() + sub.vols[v].first + sub.vols[v].count);
+            plan.vols.push_back(vol);
+        }
+    }
+
+    plan.skipped.insert(plan.skipped.end(), sub.skipped.begin(), sub.skipped.end());
+
+    VolumePlan().swap(sub);
+}
+
+
+/**  Assigns the given sizes to volumes first-fit in decreasing order
+  *  of size, setting 'assign' to the volume of each and returning the
+  *  number of volumes. The search for the first volume with room is a
+  *  max tree over the free space of each volume. Sizes above the
+  *  limit are clamped to it.
+ **/
+static size_t
+FirstFitDecreasing ( const std::vector<uint64_t> & sizes, uint64_t limit,
+                     std::vector<size_t> & assign )
+{
+    std::vector<size_t>   order(sizes.size());
+    std::vector<uint64_t> tree;
+    uint64_t              total = 0;
+    size_t                nvols = 0, leaves = 1;
+
+    assign.resize(sizes.size());
+
+    for ( size_t i = 0; i < sizes.size(); ++i ) {
+        order[i] = i;
+        total   += std::min(sizes[i], limit);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&sizes] ( size_t a, size_t b ) {
+        return sizes[a] > sizes[b];
+    });
+
+    /* first-fit leaves at most one volume half empty */
+    size_t maxvols = ( limit > 0 ) ? ((2 * total) / limit) + 2 : 1;
+
+    while ( leaves < maxvols )
+        leaves <<= 1;
+
+    tree.assign(2 * leaves, limit);
+
+    for ( size_t i = 0; i < order.size(); ++i )
+    {
+        uint64_t sz = std::min(sizes[order[i]], limit);
+        size_t   n  = 1;
+
+        while ( n < leaves )
+            n = ( tree[2 * n] >= sz ) ? (2 * n) : (2 * n) + 1;
+
+        size_t v = n - leaves;
+
+        assign[order[i]] = v;
+        nvols = std::max(nvols, v + 1);
+
+        for ( tree[n] -= sz, n >>= 1; n > 0; n >>= 1 )
+            tree[n] = std::max(tree[2 * n], tree[(2 * n) + 1]);
+    }
+
+    return nvols;
+}
+
+
+/**  Repacks the items of the plan first-fit in order of decreasing
+  *  size. Volumes are kept in order of first use, and items within a
+  *  volume in decreasing size.
+ **/
+void
+VolGen::packDecreasing ( VolumePlan & plan ) const
+{
+    std::vector<uint64_t> sizes(plan.items.size());
+    std::vector<size_t>   order(plan.items.size());
+    std::vector<size_t>   assign;
+
+    for ( size_t i = 0; i < plan.items.size(); ++i ) {
+        sizes[i] = plan.items[i].size;
+        order[i] = i;
+    }
+
+    size_t nvols = FirstFitDecreasing(sizes, plan.limit, assign);
+
+    std::stable_sort(order.begin(), order.end(), [&sizes] ( size_t a, size_t b ) {
+        return sizes[a] > sizes[b];
+    });
+
+    VolumePlan packed(plan.limit, plan.strategy);
+
+    packed.vols.resize(nvols);
+    packed.items.resize(plan.items.size());
+    packed.skipped.swap(plan.skipped);
+
+    for ( size_t i = 0; i < plan.items.size(); ++i ) {
+        packed.vols[assign[i]].count++;
+        packed.vols[assign[i]].size += plan.items[i].size;
+    }
+
+    for ( size_t v = 1; v < nvols; ++v )
+        packed.vols[v].first = packed.vols[v - 1].first + packed.vols[v - 1].count;
+
+    std::vector<size_t> next(nvols);
+
+    for ( size_t v = 0; v < nvols; ++v )
+        next[v] = packed.vols[v].first;
+
+    for ( size_t i = 0; i < order.size(); ++i )
+        packed.items[next[assign[order[i]]]++] = plan.items[order[i]];
+
+    plan.swap(packed);
+}
+
+
+/**  Plans a directory for locality. Its subdirectories that fit a
+  *  volume, its files and its bundle are packed first-fit decreasing
+  *  into volumes of its own, along with the least filled volume of
+  *  each split subdirectory, which is kept whole. The other volumes of
+  *  split subdirectories are complete and are appended as they are.
+  *  Siblings thus share volumes, and a directory spans close to the
+  *  fewest volumes its size allows, in O(n log n) of the items.
+ **/
+void
+VolGen::packLocal ( DirTree::Node * node, VolumePlan & plan,
+                    std::map<DirTree::Node*, VolumePlan> & plans ) const
+{
+    ItemList              staged;
+    std::vector<size_t>   first;
+    std::vector<uint64_t> sizes;
+
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+    {
+        const DirNode & dirsize = nIter->second->getValue();
+
+        if ( dirsize.tfsize == 0 )
+            continue;
+
+        if ( ! this->isSplit(nIter->second, plan.limit) ) {
+            first.push_back(staged.size());
+            sizes.push_back(this->getPlanSize(dirsize));
+            staged.push_back(VolumeItem(nIter->second, NULL, sizes.back()));
+            continue;
+        }
+
+        VolumePlan & sub  = plans.find(nIter->second)->second;
+        size_t       tail = 0;
+
+        for ( size_t v = 1; v < sub.vols.size(); ++v ) {
+            if ( sub.vols[v].size < sub.vols[tail].size )
+                tail = v;
+        }
+
+        for ( size_t v = 0; v < sub.vols.size(); ++v )
+        {
+            const Volume & svol  = sub.vols[v];
+            ItemList::iterator b = sub.items.begin() + svol.first;
+
+            if ( v == tail ) {
+                first.push_back(staged.size());
+                sizes.push_back(svol.size);
+                staged.insert(staged.end(), b, b + svol.count);
+                continue;
+            }
+
+            Volume vol = svol;
+            vol.first  = plan.items.size();
+            plan.items.insert(plan.items.end(), b, b + svol.count);
+            plan.vols.push_back(vol);
+        }
+
+        plan.skipped.insert(plan.skipped.end(), sub.skipped.begin(), sub.skipped.end());
+        VolumePlan().swap(sub);
+    }
+
+    FileNodeSet & assets = node->getValue().files;
+    FileNodeSet::iterator  fIter;
+
+    uint64_t bsize  = 0;
+    bool     bundle = this->hasBundle(node->getValue(), bsize);
+
+    if ( bundle ) {
+        first.push_back(staged.size());
+        sizes.push_back(bsize);
+        staged.push_back(VolumeItem(node, NULL, bsize, true));
+    }
+
+    for ( fIter = assets.begin(); fIter != assets.end(); ++fIter )
+    {
+        const FileNode & file  = *fIter;
+        uint64_t         fsize = this->getPlanSize(node->getValue(), file);
+
+        if ( bundle && this->isBundled(file) )
+            continue;
+
+        if ( fsize > plan.limit ) {
+            plan.skipped.push_back(&file);
+            continue;
+        }
+
+        first.push_back(staged.size());
+        sizes.push_back(fsize);
+        staged.push_back(VolumeItem(node, &file, fsize));
+    }
+
+    if ( sizes.empty() )
+        return;
+
+    std::vector<size_t> assign;
+    size_t              nvols = FirstFitDecreasing(sizes, plan.limit, assign);
+    size_t              base  = plan.vols.size();
+
+    first.push_back(staged.size());
+
+    for ( size_t v = 0; v < nvols; ++v )
+        plan.vols.push_back(Volume("", 0));
+
+    for ( size_t p = 0; p < sizes.size(); ++p ) {
+        Volume & vol = plan.vols[base + assign[p]];
+        vol.count += first[p + 1] - first[p];
+        vol.size  += sizes[p];
+    }
+
+    std::vector<size_t> next(nvols);
+
+    for ( size_t v = 0; v < nvols; ++v ) {
+        Volume & vol = plan.vols[base + v];
+        vol.first = ( v == 0 ) ? plan.items.size()
+                  : plan.vols[base + v - 1].first + plan.vols[base + v - 1].count;
+        next[v]   = vol.first;
+    }
+
+    plan.items.resize(plan.items.size() + staged.size());
+
+    /* pieces keep tree order within each volume */
+    for ( size_t p = 0; p < sizes.size(); ++p ) {
+        for ( size_t i = first[p]; i < first[p + 1]; ++i )
+            plan.items[next[assign[p]]++] = staged[i];
+    }
+}
+
+
+/**  Returns the number of volumes spanned by the directories below the
+  *  root beyond the first of each; a restore of every directory loads
+  *  this many extra volumes. Items are visited volume by volume, so
+  *  each directory need only remember the last volume it was seen in.
+ **/
+size_t
+VolGen::countSpans ( const VolumePlan & plan, DirTree::Node * root ) const
+{
+    std::unordered_map<DirTree::Node*, std::pair<size_t, size_t> > seen;
+    size_t spans = 0;
+
+    for ( size_t v = 0; v < plan.vols.size(); ++v )
+    {
+        const Volume & vol = plan.vols[v];
+
+        for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
+        {
+            DirTree::Node * node = plan.items[i].node;
+
+            for ( ; node != NULL && node != root; node = node->getParent() )
+            {
+                std::pair<size_t, size_t> & s = seen.try_emplace(node, v, 0).first->second;
+
+                if ( s.second > 0 && s.first == v )
+                    break;
+
+                s.first = v;
+                if ( ++s.second > 1 )
+                    spans++;
+            }
+        }
+    }
+
+    return spans;
+}
+
+
+/**  Returns true if the directory is too large for a single volume */
+bool
+VolGen::isSplit ( DirTree::Node * node, uint64_t limit ) const
+{
+    const DirNode & dnode = node->getValue();
+
+    return ( dnode.tfsize > 0 && this->getPlanSize(dnode) > limit );
+}
+
+
+/**  Returns the size a directory subtree is planned by, which is the
+  *  compressed estimate once estimate() has run.
+ **/
+uint64_t
+VolGen::getPlanSize ( const DirNode & dnode ) const
+{
+    return ( _estimate ) ? dnode.tcsize : dnode.tdsize;
+}
+
+
+uint64_t
+VolGen::getPlanSize ( const DirNode & dnode, const FileNode & file ) const
+{
+    if ( _estimate )
+        return this->getEstimate(file.getFileSize(), dnode.ratio);
+
+    return file.getDiskSize();
+}
+
+
+/**  Returns the estimated compressed size, including the margin */
+uint64_t
+VolGen::getEstimate ( uint64_t size, float ratio ) const
+{
+    return (uint64_t) std::ceil(((double) size * ratio * (100 + _margin)) / 100.0);
+}
+
+
+/**  Returns the absolute path of an item. For bundles this is the
+  *  path of the bundled directory.
+ **/
+std::string
+VolGen::getItemPath ( const VolumeItem & item ) const
+{
+    if ( item.file != NULL )
+        return item.file->getFileName();
+
+    return "/" + item.node->getAbsoluteName();
+}
+
+
+/**  Returns the name of an item within its volume */
+std::string
+VolGen::getItemName ( const VolumeItem & item ) const
+{
+    if ( item.bundle )
+        return this->getRelativeDir(item.node) + VOLGEN_BUNDLE_NAME;
+
+    return VolGen::GetRelativePath(this->getItemPath(item), _path);
+}
+
+
+uint64_t
+VolGen::getVolumeLimit() const
+{
+    return VolGen::GetVolumeLimit(_volsz);
+}
+
+
+/**  Returns the size as a percentage of the volume size */
+float
+VolGen::getVolumeRatio ( uint64_t size ) const
+{
+    if ( _volsz == 0 )
+        return 0.0;
+
+    return ( (float) size / ((float) _volsz * 1024 * 1024) ) * 100.0;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Returns true if the file falls under the bundle threshold */
+bool
+VolGen::isBundled ( const FileNode & file ) const
+{
+    return ( _bundlesz > 0 && ! file.symlink && file.getFileSize() < _bundlesz );
+}
+
+
+/**  Returns the number of files of the directory that would be
+  *  bundled, setting 'bytes' to the size of the resulting bundle.
+ **/
+size_t
+VolGen::countBundled ( const DirNode & dnode, uint64_t & bytes ) const
+{
+    FileNodeSet::const_iterator fIter;
+    size_t count = 0;
+
+    bytes = 0;
+
+    if ( _bundlesz == 0 )
+        return 0;
+
+    for ( fIter = dnode.files.begin(); fIter != dnode.files.end(); ++fIter )
+    {
+        if ( ! this->isBundled(*fIter) )
+            continue;
+        bytes += VolArchive::GetEntrySize(VolGen::GetFileName(fIter->getFileName()),
+                                          fIter->getFileSize());
+        count++;
+    }
+
+    bytes += VOLGEN_TAR_EOFSZ;
+
+    return count;
+}
+
+
+/**  Returns true if the small files of the directory are written to a
+  *  bundle, setting 'bytes' to the planned size of the bundle. A bundle
+  *  too large for a volume is not made, its files being planned one by
+  *  one instead.
+ **/
+bool
+VolGen::hasBundle ( const DirNode & dnode, uint64_t & bytes ) const
+{
+    if ( this->countBundled(dnode, bytes) < VOLGEN_BUNDLE_MIN )
+        return false;
+
+    if ( _estimate )
+        bytes = this->getEstimate(bytes, dnode.ratio);
+
+    return ( bytes <= this->getVolumeLimit() );
+}
+
+
+/**  Returns the path of a directory node relative to the root path,
+  *  with a trailing '/', or an empty string for the root itself.
+ **/
+std::string
+VolGen::getRelativeDir ( DirTree::Node * node ) const
+{
+    std::string name = "/" + node->getAbsoluteName();
+
+    if ( name.length() <= _path.length() + 1 )
+        return "";
+
+    return VolGen::GetRelativePath(name, _path) + "/";
+}
+
+// -------------------------------------------------------------- //
+
+/**  Displays the created Volume list */
+void
+VolGen::displayVolumes ( bool show )
+{
+    this->printVolumes(std::cout, show);
+    std::cout << std::endl;
+
+    return;
+}
+
+
+/**  Writes the detailed volume list to the given plan file. The
+  *  plan is written to a temporary file and renamed into place so
+  *  readers never observe a partial plan.
+ **/
+bool
+VolGen::writePlan ( const std::string & planfile )
+{
+    std::string   tmpfile = planfile + ".tmp";
+    std::ofstream plan(tmpfile.c_str(), std::ios::out | std::ios::trunc);
+
+    if ( ! plan ) {
+        std::cout << "VolGen::writePlan() Error opening '" << tmpfile << "'" << std::endl;
+        return false;
+    }
+
+    this->printVolumes(plan, true);
+    plan.close();
+
+    if ( ::rename(tmpfile.c_str(), planfile.c_str()) < 0 ) {
+        std::cout << "VolGen::writePlan() Error in rename '" << planfile << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+VolGen::printVolumes ( std::ostream & strm, bool show )
+{
+    VolumeList::iterator vIter;
+
+    strm << "Number of volumes = " << _vols.size() << std::endl;
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+    {
+        const Volume & vol = *vIter;
+        strm << vol.name   << " : "  << (vol.size / (1024 * 1024)) << " Mb : "
+             << this->getVolumeRatio(vol.size) << "% : " << vol.count
+             << " item(s)"  << std::endl;
+        if ( show ) {
+            for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
+                strm << "   " << this->getItemName(_items[i]) << " : "
+                     << (_items[i].size / (1024 * 1024)) << " Mb : "
+                     << std::setprecision(3) << this->getVolumeRatio(_items[i].size)
+                     << " %" << std::endl;
+        }
+    }
+
+    return;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Generates the volume linkage in the given path. With bundling
+  *  enabled, small files are written to per-directory bundles within
+  *  the volume, the bundles being written in parallel.
+ **/
+bool
+VolGen::generateVolumes ( const std::string & volgenpath )
+{
+    VolumeList::iterator   vIter;
+    std::vector<BundleJob> bundles;
+    std::string volpath;
+    size_t      errors = 0;
+
+    std::fill(_staged, _staged + VOLGEN_LINK_MAX, 0);
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+    {
+        const Volume & vol = *vIter;
         volpath      = volgenpath;
-        volpath.append("/").append(vol->name);
+        volpath.append("/").append(vol.name);
         volpath.append("/");
 
-        struct stat sb;
-        if ( ::stat(volpath.c_str(), &sb) != 0 )
+        struct stat sb;
+        if ( ::stat(volpath.c_str(), &sb) != 0 )
+        {
+            if ( errno == EACCES ) {
+                std::cout << "Error in volgen path!" << std::endl;
+                return false;
+            }
+            if ( ::mkdir(volpath.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 ) {
+                std::cout << "Error in mkdir '" << volpath << "' : "
+                    << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+
+        for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
+        {
+            const VolumeItem & item = _items[i];
+            std::string name  = this->getItemName(item);
+            std::string slink = volpath;
+            std::string lpath; // = slink; 
+
+            slink.append(name);
+            lpath = VolGen::GetPathName(name);
+
+            if ( ! lpath.empty() ) {
+                std::string subdir = volpath;
+                subdir.append(lpath);
+                if ( ! VolGen::MakeDirs(subdir) ) {
+                    std::cout << "Error in mkdir '" << subdir << "' : "
+                        << strerror(errno) << std::endl;
+                    errors++;
+                    continue;
+                }
+            }
+
+            if ( item.bundle ) {
+                this->addBundle(bundles, item.node, volpath + this->getRelativeDir(item.node));
+                continue;
+            }
+
+            if ( item.file == NULL && (_bundlesz > 0 || _linkmode != VOLGEN_LINK_SYMLINK) ) {
+                this->expandDirectory(bundles, item.node, volpath);
+                continue;
+            }
+
+            if ( item.file != NULL ) {
+                this->stageFile(*item.file, slink);
+                continue;
+            }
+
+            int r = ::symlink(this->getItemPath(item).c_str(), slink.c_str());
+
+            if ( r != 0 ) {
+                std::cout << "Error in symlink: " << slink
+                          << " : " << strerror(errno) << std::endl;
+                errors++;
+            }
+        }
+    }
+
+    if ( _linkmode != VOLGEN_LINK_SYMLINK )
+        std::cout << "Staged " << _staged[VOLGEN_LINK_REFLINK] << " reflink(s), "
+                  << _staged[VOLGEN_LINK_HARDLINK] << " hard link(s), "
+                  << _staged[VOLGEN_LINK_SYMLINK] << " symlink(s)" << std::endl;
+
+    if ( ! bundles.empty() )
+    {
+        std::atomic<size_t> berrors(0);
+        size_t              nthreads = this->getThreads();
+        ThreadPool          pool(nthreads, nthreads * 4);
+
+        for ( size_t i = 0; i < bundles.size(); ++i )
+        {
+            const BundleJob & job = bundles[i];
+
+            pool.push([&job, &berrors] {
+                if ( ! VolArchive::WriteBundle(job.bundle, job.index, job.names, job.sources) )
+                    berrors++;
+            });
+        }
+
+        pool.wait();
+
+        std::cout << "Wrote " << bundles.size() << " bundle(s)";
+        if ( berrors > 0 )
+            std::cout << ", " << berrors << " error(s)";
+        std::cout << std::endl;
+
+        errors += berrors;
+    }
+
+    std::cout << "Volumes generated in " << volgenpath << std::endl;
+
+    return ( errors == 0 );
+}
+
+
+/**  Places a file in a volume by the link mode, trying a reflink, then
+  *  a hard link, then a symlink. A symlink of the tree is hard linked
+  *  itself rather than followed.
+ **/
+void
+VolGen::stageFile ( const FileNode & file, const std::string & target )
+{
+    const std::string & source = file.getFileName();
+
+    if ( _linkmode == VOLGEN_LINK_REFLINK && ! file.symlink )
+    {
+        struct stat sb;
+        int sfd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        int dfd = -1;
+
+        if ( sfd >= 0 && ::fstat(sfd, &sb) == 0 )
+            dfd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, sb.st_mode & 07777);
+
+        if ( dfd >= 0 && ::ioctl(dfd, FICLONE, sfd) == 0 ) {
+            struct timespec times[2] = { sb.st_atim, sb.st_mtim };
+            ::futimens(dfd, times);
+            ::close(dfd);
+            ::close(sfd);
+            _staged[VOLGEN_LINK_REFLINK]++;
+            return;
+        }
+
+        if ( dfd >= 0 ) {
+            ::close(dfd);
+            ::unlink(target.c_str());
+        }
+        if ( sfd >= 0 )
+            ::close(sfd);
+    }
+
+    if ( _linkmode != VOLGEN_LINK_SYMLINK
+        && ::linkat(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str(), 0) == 0 )
+    {
+        _staged[VOLGEN_LINK_HARDLINK]++;
+        return;
+    }
+
+    if ( ::symlink(source.c_str(), target.c_str()) != 0 ) {
+        std::cout << "Error in symlink: " << target
+                  << " : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    _staged[VOLGEN_LINK_SYMLINK]++;
+}
+
+
+/**  Queues a bundle of the small files of a directory, written to
+  *  'dirpath' within the volume alongside its index.
+ **/
+void
+VolGen::addBundle ( std::vector<BundleJob> & jobs, DirTree::Node * node,
+                    const std::string & dirpath )
+{
+    FileNodeSet & files = node->getValue().files;
+    FileNodeSet::iterator fIter;
+    BundleJob job;
+
+    job.bundle = dirpath + VOLGEN_BUNDLE_NAME;
+    job.index  = dirpath + VOLGEN_BUNDLE_INDEX;
+
+    for ( fIter = files.begin(); fIter != files.end(); ++fIter )
+    {
+        if ( ! this->isBundled(*fIter) )
+            continue;
+        job.names.push_back(VolGen::GetFileName(fIter->getFileName()));
+        job.sources.push_back(fIter->getFileName());
+    }
+
+    jobs.push_back(job);
+}
+
+
+/**  Recreates a directory item within the volume rather than linking
+  *  it, so its small files can be bundled or its files staged. The
+  *  remaining files are linked.
+ **/
+void
+VolGen::expandDirectory ( std::vector<BundleJob> & jobs, DirTree::Node * node,
+                          const std::string & volpath )
+{
+    std::string dirpath = volpath + this->getRelativeDir(node);
+
+    if ( ! FileUtils::IsDirectory(dirpath)
+        && ::mkdir(dirpath.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 )
+    {
+        std::cout << "Error in mkdir '" << dirpath << "' : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    uint64_t bsize  = 0;
+    bool     bundle = this->hasBundle(node->getValue(), bsize);
+
+    FileNodeSet & files = node->getValue().files;
+    FileNodeSet::iterator fIter;
+
+    for ( fIter = files.begin(); fIter != files.end(); ++fIter )
+    {
+        if ( bundle && this->isBundled(*fIter) )
+            continue;
+
+        this->stageFile(*fIter, dirpath + VolGen::GetFileName(fIter->getFileName()));
+    }
+
+    if ( bundle )
+        this->addBundle(jobs, node, dirpath);
+
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+        this->expandDirectory(jobs, nIter->second, volpath);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Generates a manifest for each volume in the given path. Files
+  *  are checksummed in batches across the thread pool and each
+  *  manifest is written as <volume>.manifest alongside the volumes.
+ **/
+bool
+VolGen::generateManifests ( const std::string & volgenpath )
+{
+    std::vector<VolManifest> manifests;
+    std::atomic<size_t>      errors(0);
+
+    this->createManifests(manifests, volgenpath);
+
+    {
+        size_t     nthreads = this->getThreads();
+        ThreadPool pool(nthreads, nthreads * 4);
+
+        for ( size_t m = 0; m < manifests.size(); ++m )
+        {
+            ManifestEntryList & entries = manifests[m].getEntries();
+
+            for ( size_t i = 0; i < entries.size(); i += VOLGEN_MANIFEST_BATCH )
+            {
+                size_t end = std::min(i + VOLGEN_MANIFEST_BATCH, entries.size());
+
+                pool.push([&entries, &errors, i, end] {
+                    FileReader reader;
+                    for ( size_t n = i; n < end; ++n ) {
+                        if ( ! VolManifest::HashFile(reader, entries[n].source, entries[n]) )
+                            errors++;
+                    }
+                });
+            }
+        }
+
+        pool.wait();
+    }
+
+    for ( size_t m = 0; m < manifests.size(); ++m ) {
+        std::string mfile = VolManifest::GetManifestName(volgenpath, manifests[m].getName());
+        if ( ! manifests[m].write(mfile) )
+            errors++;
+    }
+
+    if ( errors > 0 )
+        std::cout << "VolGen::generateManifests() " << errors
+                  << " error(s) generating manifests" << std::endl;
+    else
+        std::cout << "Manifests generated in " << volgenpath << std::endl;
+
+    return ( errors == 0 );
+}
+
+
+/**  Writes each volume as a tar image to the given targets, several
+  *  at once, encrypted when 'crypt' is given. Object storage targets
+  *  are uploaded to over 'conns' connections each. Must follow
+  *  generateVolumes() as bundles are written as members of the image.
+ **/
+bool
+VolGen::generateImages ( const std::string & volgenpath,
+                         const std::vector<std::string> & targets,
+                         const VolCrypt * crypt, size_t conns )
+{
+    std::vector<VolManifest> manifests;
+    VolWriter                writer(targets);
+
+    this->createManifests(manifests, volgenpath);
+    writer.setConnections(conns);
+
+    if ( crypt != NULL ) {
+        writer.setCrypt(crypt);
+        std::cout << "Encrypting volume images with " << VolCrypt::GetCipherName(crypt->getCipher())
+                  << (( VolCrypt::HasAesAccel() ) ? " (AES instructions)" : "") << std::endl;
+    }
+
+    for ( size_t m = 0; m < manifests.size(); ++m )
+        writer.add(manifests[m]);
+
+    if ( ! writer.run() ) {
+        std::cout << "VolGen::generateImages() Error writing volume images" << std::endl;
+        return false;
+    }
+
+    std::cout << "Volume images written, " << (writer.getBytes() / (1024 * 1024))
+              << " Mb to " << targets.size() << " target(s)" << std::endl;
+
+    return true;
+}
+
+
+/**  Generates the restore index of the plan, mapping every file to
+  *  its volume, and to its offset within a bundle when bundled. Must
+  *  follow generateVolumes() as bundle offsets are read back from the
+  *  bundle indexes.
+ **/
+bool
+VolGen::generateIndex ( const std::string & volgenpath )
+{
+    std::vector<std::string> volnames;
+    IndexEntryList           entries;
+    VolumeList::iterator     vIter;
+    uint32_t                 v = 0;
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter, ++v )
+    {
+        const Volume & vol = *vIter;
+        std::string volroot = volgenpath + "/" + vol.name + "/";
+
+        volnames.push_back(vol.name);
+
+        for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
         {
-            if ( errno == EACCES ) {
-                std::cout << "Error in volgen path!" << std::endl;
-                return;
-            }
-            if ( ::mkdir(volpath.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 ) {
-                std::cout << "Error in mkdir '" << volpath << "' : "
-                    << strerror(errno) << std::endl;
-                return;
-            }
+            const VolumeItem & item = _items[i];
+
+            if ( item.bundle )
+                this->addIndexBundle(entries, this->getRelativeDir(item.node), v, volroot);
+            else if ( item.file == NULL )
+                this->addIndexFiles(entries, item.node, v, volroot);
+            else
+                entries.push_back(IndexEntry(this->getItemName(item), v,
+                                             item.file->getFileSize()));
         }
+    }
 
-        ItemList::iterator iIter;
-        for ( iIter = vol->items.begin(); iIter != vol->items.end(); ++iIter )
-        {
-            VolumeItem & item = *iIter;
-            std::string slink = volpath;
-            std::string lpath; // = slink; 
+    std::string indexfile = volgenpath + "/" + VOLGEN_INDEXFILE;
 
-            slink.append(item.name);
-            lpath = VolGen::GetPathName(item.name);
+    if ( ! VolIndex::Write(indexfile, _path, volnames, entries) )
+        return false;
 
-            if ( ! lpath.empty() ) {
-                std::string subdir = volpath;
-                subdir.append(lpath);
-                if ( ! FileUtils::IsDirectory(subdir) ) {
-                    if ( ::mkdir(subdir.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 )
-                        std::cout << "Error in mkdir '" << subdir << "'" << std::endl;
-                }
-            }
+    std::cout << "Restore index of " << entries.size() << " file(s) written to "
+              << indexfile << std::endl;
+
+    return true;
+}
 
-            int r = ::symlink(item.fullname.c_str(), slink.c_str());
 
-            if ( r != 0 )
-                std::cout << "Error in symlink: " << slink
-                          << " : " << strerror(errno) << std::endl;
-        }
+void
+VolGen::addIndexFiles ( IndexEntryList & entries, DirTree::Node * node,
+                        uint32_t vol, const std::string & volroot )
+{
+    FileNodeSet & files = node->getValue().files;
+    FileNodeSet::iterator fIter;
+
+    uint64_t bsize  = 0;
+    bool     bundle = this->hasBundle(node->getValue(), bsize);
+
+    if ( bundle )
+        this->addIndexBundle(entries, this->getRelativeDir(node), vol, volroot);
+
+    for ( fIter = files.begin(); fIter != files.end(); ++fIter ) {
+        if ( bundle && this->isBundled(*fIter) )
+            continue;
+        entries.push_back(IndexEntry(VolGen::GetRelativePath(fIter->getFileName(), _path),
+                                     vol, fIter->getFileSize()));
     }
 
-    std::cout << "Volumes generated in " << volgenpath << std::endl;
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
 
-    return;
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+        this->addIndexFiles(entries, nIter->second, vol, volroot);
+}
+
+
+/**  Adds the members of the bundle in 'reldir' of the volume */
+bool
+VolGen::addIndexBundle ( IndexEntryList & entries, const std::string & reldir,
+                         uint32_t vol, const std::string & volroot )
+{
+    std::string dir = reldir;
+    BundleIndex index;
+
+    if ( ! dir.empty() && ! StringUtils::EndsWith(dir, "/") )
+        dir.append("/");
+
+    if ( ! VolArchive::ReadIndex(volroot + dir + VOLGEN_BUNDLE_INDEX, index) ) {
+        std::cout << "VolGen::generateIndex() Error reading bundle index in '"
+            << volroot + dir << "'" << std::endl;
+        return false;
+    }
+
+    for ( size_t i = 0; i < index.size(); ++i )
+        entries.push_back(IndexEntry(dir + index[i].name, vol, index[i].size, index[i].offset));
+
+    return true;
+}
+
+
+/**  Generates 'nparity' Reed-Solomon parity volumes for each group of
+  *  'ndata' volumes. Requires the volume manifests to be generated.
+ **/
+bool
+VolGen::generateParity ( const std::string & volgenpath, int ndata, int nparity )
+{
+    std::vector<std::string> volnames;
+    VolumeList::iterator     vIter;
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+        volnames.push_back(vIter->name);
+
+    VolParity parity(volgenpath, ndata, nparity);
+
+    if ( ! parity.encode(volnames, volgenpath, this->getThreads()) ) {
+        std::cout << "VolGen::generateParity() Error generating parity volumes" << std::endl;
+        return false;
+    }
+
+    std::cout << "Parity volumes generated in " << volgenpath << std::endl;
+
+    return true;
+}
+
+
+/**  Creates the unhashed manifest of each volume of the plan */
+void
+VolGen::createManifests ( std::vector<VolManifest> & manifests,
+                          const std::string & volgenpath )
+{
+    VolumeList::iterator vIter;
+
+    manifests.reserve(_vols.size());
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+    {
+        const Volume & vol = *vIter;
+        manifests.push_back(VolManifest(vol.name));
+
+        std::string volroot = volgenpath + "/" + vol.name + "/";
+
+        for ( size_t i = vol.first; i < vol.first + vol.count; ++i )
+            this->addManifestItem(manifests.back(), _items[i], volroot);
+    }
+}
+
+
+/**  Adds the files of a volume item to the manifest, expanding
+  *  directory items to every file of the subtree. Bundles and their
+  *  index are listed as written to the volume in 'volroot'.
+ **/
+void
+VolGen::addManifestItem ( VolManifest & manifest, const VolumeItem & item,
+                          const std::string & volroot )
+{
+    if ( item.bundle ) {
+        std::string reldir = this->getRelativeDir(item.node);
+        manifest.add(reldir + VOLGEN_BUNDLE_NAME, volroot + reldir + VOLGEN_BUNDLE_NAME);
+        manifest.add(reldir + VOLGEN_BUNDLE_INDEX, volroot + reldir + VOLGEN_BUNDLE_INDEX);
+    } else if ( item.file != NULL ) {
+        manifest.add(this->getItemName(item), item.file->getFileName());
+    } else {
+        this->addManifestFiles(manifest, item.node, volroot);
+    }
+}
+
+
+void
+VolGen::addManifestFiles ( VolManifest & manifest, DirTree::Node * node,
+                           const std::string & volroot )
+{
+    FileNodeSet & files = node->getValue().files;
+    FileNodeSet::iterator fIter;
+
+    uint64_t bsize  = 0;
+    bool     bundle = this->hasBundle(node->getValue(), bsize);
+
+    if ( bundle ) {
+        std::string reldir = this->getRelativeDir(node);
+        manifest.add(reldir + VOLGEN_BUNDLE_NAME, volroot + reldir + VOLGEN_BUNDLE_NAME);
+        manifest.add(reldir + VOLGEN_BUNDLE_INDEX, volroot + reldir + VOLGEN_BUNDLE_INDEX);
+    }
+
+    for ( fIter = files.begin(); fIter != files.end(); ++fIter ) {
+        if ( bundle && this->isBundled(*fIter) )
+            continue;
+        manifest.add(VolGen::GetRelativePath(fIter->getFileName(), _path),
+                     fIter->getFileName());
+    }
+
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter )
+        this->addManifestFiles(manifest, nIter->second, volroot);
 }
 
 // -------------------------------------------------------------- //
@@ -527,10 +2470,7 @@ VolGen::getDirSize ( const std::string & path )
     if ( node == NULL )
         return 0;
 
-    DirSizePredicate  dirsize;
-    _dtree.depthFirstTraversal(node, dirsize);
-
-    return dirsize.dsize;
+    return node->getValue().tdsize;
 }
 
 
@@ -568,14 +2508,275 @@ VolGen::getBlockSize() const
 }
 
 
+/**  Limits the tree report to the 'topn' largest directories, 0 for
+  *  all, within 'maxdepth' levels of the root, -1 for any depth.
+ **/
+void
+VolGen::setReportLimits ( size_t topn, int maxdepth )
+{
+    _topn     = topn;
+    _maxdepth = maxdepth;
+}
+
+
+/**  Sets the packing strategy used by createVolumes() */
+void
+VolGen::setStrategy ( int strategy )
+{
+    _strategy = strategy;
+}
+
+
+int
+VolGen::getStrategy() const
+{
+    return _strategy;
+}
+
+
+void
+VolGen::setLinkMode ( int mode )
+{
+    if ( mode >= 0 && mode < VOLGEN_LINK_MAX )
+        _linkmode = mode;
+}
+
+
+int
+VolGen::getLinkMode() const
+{
+    return _linkmode;
+}
+
+
+/**  Sets the size in Kb under which files are bundled, 0 disables bundling */
+void
+VolGen::setBundleSize ( size_t kb )
+{
+    _bundlesz = (uint64_t) kb * 1024;
+}
+
+
+size_t
+VolGen::getBundleSize() const
+{
+    return ( _bundlesz / 1024 );
+}
+
+
+/**  Enables planning by compressed size with the given margin, as a
+  *  percentage, sampling 'pct' percent of the data. The estimate is
+  *  made by estimate().
+ **/
+void
+VolGen::setEstimate ( int margin, int pct )
+{
+    _margin    = ( margin < 0 ) ? 0 : margin;
+    _samplepct = ( pct < 1 || pct > 100 ) ? VOLGEN_SAMPLE_PCT : pct;
+}
+
+
+bool
+VolGen::isEstimated() const
+{
+    return _estimate;
+}
+
+
+/**  Sets a visitor called by read() for every directory and file as it
+  *  is added to the tree.
+ **/
+void
+VolGen::setTreeVisitor ( const TreeVisitor & fn )
+{
+    _visitor = fn;
+}
+
+
+/**  Checkpoints the progress of read() to the given file, resuming
+  *  from the checkpoint left by an interrupted read when 'resume' is
+  *  set. Directories completed by the earlier read are then taken from
+  *  the checkpoint rather than read again.
+ **/
+bool
+VolGen::setCheckpoint ( const std::string & ckptfile, bool resume )
+{
+    if ( _ckpt )
+        delete _ckpt;
+
+    _ckpt = new VolCheckpoint(ckptfile, _path, _blksz);
+
+    if ( ! _ckpt->open(resume) ) {
+        delete _ckpt;
+        _ckpt = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+VolGen::displayCheckpoint()
+{
+    if ( _ckpt == NULL || _ckpt->getCompleted() == 0 )
+        return;
+
+    std::cout << "Resuming from checkpoint '" << _ckpt->getFileName() << "': "
+              << _ckpt->getCompleted() << " directories completed, "
+              << _ckpt->getPending() << " pending";
+
+    if ( _ckpt->isFinished() )
+        std::cout << ", scan completed";
+
+    std::cout << std::endl;
+}
+
+
+/**  Profiles the latency of read(), reporting the 'topn' directories
+  *  taking the most time.
+ **/
+void
+VolGen::setProfile ( size_t topn )
+{
+    if ( _prof )
+        delete _prof;
+
+    _prof = new VolProfile(topn);
+}
+
+
+void
+VolGen::displayProfile()
+{
+    if ( _prof != NULL )
+        _prof->display(std::cout);
+}
+
+
+/**  Sets the number of worker threads, 0 selects the number of cores */
+void
+VolGen::setThreads ( size_t threads )
+{
+    _threads = threads;
+}
+
+
+size_t
+VolGen::getThreads() const
+{
+    return ( _threads == 0 ) ? ThreadPool::DefaultThreads() : _threads;
+}
+
+
 void
 VolGen::setDebug ( bool d )
 {
     _debug = d;
 }
 
+
+/**  Sets a path to skip while reading the tree, typically the
+  *  volgen meta directory when it resides within the target.
+ **/
+void
+VolGen::setExcludePath ( const std::string & path )
+{
+    _exclude = path;
+}
+
+
+bool
+VolGen::isExcluded ( const std::string & path ) const
+{
+    if ( _exclude.empty() )
+        return false;
+    if ( ! StringUtils::StartsWith(path, _exclude) )
+        return false;
+
+    return ( path.length() == _exclude.length() || path[_exclude.length()] == '/' );
+}
+
+
+const std::string&
+VolGen::getPath() const
+{
+    return _path;
+}
+
+
+DirTree&
+VolGen::getTree()
+{
+    return _dtree;
+}
+
 // -------------------------------------------------------------- //
 
+/**  Returns the bytes usable per volume of 'volsz' Mb, leaving 5%
+  *  for filesystem overhead on the media.
+ **/
+uint64_t
+VolGen::GetVolumeLimit ( size_t volsz )
+{
+    return ( (uint64_t) volsz * 1024 * 1024 * 95 ) / 100;
+}
+
+
+const char*
+VolGen::GetStrategyName ( int strategy )
+{
+    switch ( strategy ) {
+        case VOLGEN_PACK_NEXT:
+            return "next";
+        case VOLGEN_PACK_FFD:
+            return "ffd";
+        case VOLGEN_PACK_LOCAL:
+            return "local";
+    }
+    return "unknown";
+}
+
+
+/**  Returns the strategy of the given name, or -1 if not known */
+int
+VolGen::GetStrategy ( const std::string & name )
+{
+    for ( int i = 0; i < VOLGEN_PACK_MAX; ++i ) {
+        if ( name.compare(VolGen::GetStrategyName(i)) == 0 )
+            return i;
+    }
+    return -1;
+}
+
+
+const char*
+VolGen::GetLinkModeName ( int mode )
+{
+    switch ( mode ) {
+        case VOLGEN_LINK_SYMLINK:
+            return "symlink";
+        case VOLGEN_LINK_HARDLINK:
+            return "hardlink";
+        case VOLGEN_LINK_REFLINK:
+            return "reflink";
+    }
+    return "unknown";
+}
+
+
+/**  Returns the link mode of the given name, or -1 if not known */
+int
+VolGen::GetLinkMode ( const std::string & name )
+{
+    for ( int i = 0; i < VOLGEN_LINK_MAX; ++i ) {
+        if ( name.compare(VolGen::GetLinkModeName(i)) == 0 )
+            return i;
+    }
+    return -1;
+}
+
+
 /** Creates a string of the next volume name in the list */
 std::string
 VolGen::GetVolumeName ( size_t volsz )
@@ -643,6 +2844,22 @@ VolGen::GetRelativePath ( const std::string & fqfn,
     return name;
 }
 
+
+/**  Creates a directory and any missing parents */
+bool
+VolGen::MakeDirs ( const std::string & path )
+{
+    if ( path.empty() || FileUtils::IsDirectory(path) )
+        return true;
+
+    int indx = StringUtils::LastIndexOf(path, "/");
+    if ( indx > 0 && ! VolGen::MakeDirs(path.substr(0, indx)) )
+        return false;
+
+    return ( ::mkdir(path.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) == 0
+             || errno == EEXIST );
+}
+
 }  // namespace
 
 // _VOLGEN_VOLGEN_CPP_
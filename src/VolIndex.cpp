@@ -0,0 +1,433 @@
+/**
+  * @file   VolIndex.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLINDEX_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "VolIndex.h"
+
+#include "util/StringUtils.h"
+using namespace tcanetpp;
+
+
+namespace volgen {
+
+
+/*  File layout: header, string table (root and volume names, each
+ *  NUL terminated), block table of data offsets, entry data.  */
+struct IndexHeader {
+    char      magic[8];
+    uint64_t  count;
+    uint64_t  nblocks;
+    uint64_t  nvols;
+    uint64_t  strtab;
+    uint64_t  strlen;
+    uint64_t  blocks;
+    uint64_t  data;
+    uint64_t  length;
+};
+
+
+static void
+PutVarint ( std::string & buf, uint64_t val )
+{
+    while ( val >= 0x80 ) {
+        buf.push_back((char) ((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    buf.push_back((char) val);
+}
+
+
+static bool
+GetVarint ( const uint8_t *& ptr, const uint8_t * end, uint64_t & val )
+{
+    int shift = 0;
+
+    val = 0;
+
+    while ( ptr < end && shift < 64 ) {
+        uint8_t b = *ptr++;
+        val |= (uint64_t) (b & 0x7f) << shift;
+        if ( (b & 0x80) == 0 )
+            return true;
+        shift += 7;
+    }
+
+    return false;
+}
+
+
+static std::string
+GetPrefix ( const std::string & pattern )
+{
+    size_t indx = pattern.find_first_of("*?[\\");
+
+    if ( indx == std::string::npos )
+        return pattern;
+
+    return pattern.substr(0, indx);
+}
+
+// -------------------------------------------------------------- //
+
+VolIndex::VolIndex()
+    : _map(NULL),
+      _maplen(0),
+      _data(NULL),
+      _blocks(NULL),
+      _count(0),
+      _nblocks(0)
+{}
+
+VolIndex::~VolIndex()
+{
+    this->close();
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolIndex::open ( const std::string & filename )
+{
+    struct stat sb;
+    int fd;
+
+    this->close();
+
+    if ( (fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC)) < 0 ) {
+        std::cout << "VolIndex::open() Error opening '" << filename << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if ( ::fstat(fd, &sb) < 0 || (size_t) sb.st_size < sizeof(IndexHeader) ) {
+        std::cout << "VolIndex::open() Invalid index '" << filename << "'" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void * map = ::mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if ( map == MAP_FAILED ) {
+        std::cout << "VolIndex::open() Error in mmap '" << filename << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    ::madvise(map, sb.st_size, MADV_RANDOM);
+
+    _map    = (const uint8_t*) map;
+    _maplen = sb.st_size;
+
+    const IndexHeader * hdr = (const IndexHeader*) _map;
+
+    if ( std::memcmp(hdr->magic, VOLGEN_INDEX_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->length != _maplen
+        || hdr->strtab + hdr->strlen > _maplen
+        || hdr->blocks + (hdr->nblocks * sizeof(uint64_t)) > _maplen
+        || hdr->data > _maplen
+        || hdr->blocks % sizeof(uint64_t) != 0 )
+    {
+        std::cout << "VolIndex::open() Invalid index '" << filename << "'" << std::endl;
+        this->close();
+        return false;
+    }
+
+    _count   = hdr->count;
+    _nblocks = hdr->nblocks;
+    _blocks  = (const uint64_t*) (_map + hdr->blocks);
+    _data    = _map + hdr->data;
+
+    const char * str = (const char*) (_map + hdr->strtab);
+    const char * end = str + hdr->strlen;
+
+    while ( str < end ) {
+        size_t len = ::strnlen(str, end - str);
+        if ( str == (const char*) (_map + hdr->strtab) )
+            _root.assign(str, len);
+        else
+            _vols.push_back(std::string(str, len));
+        str += len + 1;
+    }
+
+    if ( _vols.size() != hdr->nvols ) {
+        std::cout << "VolIndex::open() Invalid index '" << filename << "'" << std::endl;
+        this->close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+VolIndex::close()
+{
+    if ( _map != NULL )
+        ::munmap((void*) _map, _maplen);
+
+    _map     = NULL;
+    _maplen  = 0;
+    _data    = NULL;
+    _blocks  = NULL;
+    _count   = 0;
+    _nblocks = 0;
+    _root.clear();
+    _vols.clear();
+}
+
+// -------------------------------------------------------------- //
+
+/**  Looks up a single file by its path relative to the root */
+bool
+VolIndex::find ( const std::string & name, IndexEntry & entry ) const
+{
+    const uint8_t * ptr = NULL;
+    size_t          i   = this->seek(name, ptr);
+
+    entry = IndexEntry();
+
+    for ( ; i < _count; ++i )
+    {
+        if ( ! this->decode(ptr, entry) )
+            return false;
+
+        int r = entry.name.compare(name);
+        if ( r == 0 )
+            return true;
+        if ( r > 0 )
+            break;
+    }
+
+    return false;
+}
+
+
+/**  Collects the files matching a path or glob pattern. A pattern
+  *  naming a directory matches every file beneath it. Only the range
+  *  of entries sharing the literal prefix of the pattern is scanned.
+ **/
+size_t
+VolIndex::match ( const std::string & pattern, IndexEntryList & matches ) const
+{
+    std::string     prefix = GetPrefix(pattern);
+    const uint8_t * ptr    = NULL;
+    size_t          i      = this->seek(prefix, ptr);
+    size_t          found  = 0;
+    IndexEntry      entry;
+
+    for ( ; i < _count; ++i )
+    {
+        if ( ! this->decode(ptr, entry) )
+            break;
+        if ( entry.name < prefix )
+            continue;
+        if ( ! StringUtils::StartsWith(entry.name, prefix) )
+            break;
+        if ( ::fnmatch(pattern.c_str(), entry.name.c_str(), FNM_LEADING_DIR) == 0 ) {
+            matches.push_back(entry);
+            found++;
+        }
+    }
+
+    return found;
+}
+
+// -------------------------------------------------------------- //
+
+const std::string&
+VolIndex::getVolumeName ( uint32_t vol ) const
+{
+    static const std::string empty;
+
+    if ( vol >= _vols.size() )
+        return empty;
+
+    return _vols[vol];
+}
+
+
+size_t
+VolIndex::size() const
+{
+    return _count;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Positions 'ptr' at the start of the last block whose first key
+  *  is not greater than 'key', returning the index of that entry.
+ **/
+size_t
+VolIndex::seek ( const std::string & key, const uint8_t *& ptr ) const
+{
+    size_t lo = 0, hi = _nblocks;
+
+    while ( hi - lo > 1 )
+    {
+        size_t mid = lo + ((hi - lo) / 2);
+
+        if ( this->firstKey(mid) <= key )
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    ptr = ( _nblocks > 0 ) ? _data + _blocks[lo] : _data;
+
+    return ( lo * VOLGEN_INDEX_BLOCK );
+}
+
+
+std::string
+VolIndex::firstKey ( size_t block ) const
+{
+    const uint8_t * ptr = _data + _blocks[block];
+    IndexEntry      entry;
+
+    this->decode(ptr, entry);
+
+    return entry.name;
+}
+
+
+/**  Decodes the entry at 'ptr', which is prefix compressed against
+  *  the name held in 'entry' from the previous call.
+ **/
+bool
+VolIndex::decode ( const uint8_t *& ptr, IndexEntry & entry ) const
+{
+    const uint8_t * end = _map + _maplen;
+    uint64_t shared = 0, sfxlen = 0, vol = 0;
+
+    if ( ! GetVarint(ptr, end, shared) || ! GetVarint(ptr, end, sfxlen) )
+        return false;
+    if ( shared > entry.name.length() || sfxlen > (uint64_t) (end - ptr) )
+        return false;
+
+    entry.name.resize(shared);
+    entry.name.append((const char*) ptr, sfxlen);
+    ptr += sfxlen;
+
+    if ( ! GetVarint(ptr, end, vol)
+        || ! GetVarint(ptr, end, entry.size)
+        || ! GetVarint(ptr, end, entry.offset) )
+        return false;
+
+    entry.volume = vol;
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Sorts the entries and writes the index file */
+bool
+VolIndex::Write ( const std::string & filename, const std::string & root,
+                  const std::vector<std::string> & volumes,
+                  IndexEntryList & entries )
+{
+    IndexHeader           hdr;
+    std::string           strtab, data;
+    std::vector<uint64_t> blocks;
+
+    std::sort(entries.begin(), entries.end());
+
+    strtab.append(root).push_back('\0');
+    for ( size_t i = 0; i < volumes.size(); ++i )
+        strtab.append(volumes[i]).push_back('\0');
+
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        const IndexEntry & e = entries[i];
+        size_t shared = 0;
+
+        if ( i % VOLGEN_INDEX_BLOCK == 0 ) {
+            blocks.push_back(data.length());
+        } else {
+            const std::string & prev = entries[i - 1].name;
+            size_t len = std::min(prev.length(), e.name.length());
+            while ( shared < len && prev[shared] == e.name[shared] )
+                ++shared;
+        }
+
+        PutVarint(data, shared);
+        PutVarint(data, e.name.length() - shared);
+        data.append(e.name, shared, std::string::npos);
+        PutVarint(data, e.volume);
+        PutVarint(data, e.size);
+        PutVarint(data, e.offset);
+    }
+
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, VOLGEN_INDEX_MAGIC, sizeof(hdr.magic));
+
+    hdr.count   = entries.size();
+    hdr.nblocks = blocks.size();
+    hdr.nvols   = volumes.size();
+    hdr.strtab  = sizeof(hdr);
+    hdr.strlen  = strtab.length();
+    hdr.blocks  = hdr.strtab + hdr.strlen;
+    hdr.blocks += ( sizeof(uint64_t) - (hdr.blocks % sizeof(uint64_t)) ) % sizeof(uint64_t);
+    hdr.data    = hdr.blocks + (blocks.size() * sizeof(uint64_t));
+    hdr.length  = hdr.data + data.length();
+
+    std::string   tmpfile = filename + ".tmp";
+    std::ofstream ofs(tmpfile.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+
+    if ( ! ofs ) {
+        std::cout << "VolIndex::Write() Error creating '" << tmpfile << "'" << std::endl;
+        return false;
+    }
+
+    std::string pad(hdr.blocks - hdr.strtab - hdr.strlen, '\0');
+
+    ofs.write((const char*) &hdr, sizeof(hdr));
+    ofs.write(strtab.data(), strtab.length());
+    ofs.write(pad.data(), pad.length());
+    ofs.write((const char*) blocks.data(), blocks.size() * sizeof(uint64_t));
+    ofs.write(data.data(), data.length());
+    ofs.close();
+
+    if ( ! ofs || ::rename(tmpfile.c_str(), filename.c_str()) < 0 ) {
+        std::cout << "VolIndex::Write() Error writing '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLINDEX_CPP_
@@ -0,0 +1,319 @@
+/**
+  * @file   VolManifest.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLMANIFEST_CPP_
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+extern "C" {
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+}
+
+#include <openssl/evp.h>
+
+#include "VolManifest.h"
+#include "FileReader.h"
+
+#include "util/StringUtils.h"
+using namespace tcanetpp;
+
+
+namespace volgen {
+
+
+VolManifest::VolManifest ( const std::string & volname )
+    : _name(volname)
+{}
+
+// -------------------------------------------------------------- //
+
+void
+VolManifest::add ( const std::string & name, const std::string & source )
+{
+    _entries.push_back(ManifestEntry(name, source));
+}
+
+
+uint64_t
+VolManifest::getSize() const
+{
+    uint64_t sz = 0;
+    ManifestEntryList::const_iterator eIter;
+
+    for ( eIter = _entries.begin(); eIter != _entries.end(); ++eIter )
+        sz += eIter->size;
+
+    return sz;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Writes the manifest as one tab separated line per entry:
+  *  digest, size, mtime and the escaped relative path, followed by
+  *  the escaped target of a symlink.
+ **/
+bool
+VolManifest::write ( const std::string & filename ) const
+{
+    std::string   tmpfile = filename + ".tmp";
+    std::ofstream mfs(tmpfile.c_str(), std::ios::out | std::ios::trunc);
+
+    if ( ! mfs ) {
+        std::cout << "VolManifest::write() Error opening '" << tmpfile << "'" << std::endl;
+        return false;
+    }
+
+    mfs << VOLGEN_MANIFEST_MAGIC << " " << _name << "\n";
+
+    ManifestEntryList::const_iterator eIter;
+    for ( eIter = _entries.begin(); eIter != _entries.end(); ++eIter )
+    {
+        const ManifestEntry & e = *eIter;
+        mfs << (e.digest.empty() ? "-" : e.digest) << '\t'
+            << e.size  << '\t'
+            << e.mtime << '\t'
+            << VolManifest::Escape(e.name);
+        if ( e.isLink() )
+            mfs << '\t' << VolManifest::Escape(e.link);
+        mfs << '\n';
+    }
+
+    mfs.close();
+
+    if ( ! mfs || ::rename(tmpfile.c_str(), filename.c_str()) < 0 ) {
+        std::cout << "VolManifest::write() Error writing '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+VolManifest::read ( const std::string & filename )
+{
+    std::ifstream mfs(filename.c_str());
+    std::string   line;
+
+    if ( ! mfs ) {
+        std::cout << "VolManifest::read() Error opening '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    _entries.clear();
+
+    if ( ! std::getline(mfs, line) || ! StringUtils::StartsWith(line, VOLGEN_MANIFEST_MAGIC) ) {
+        std::cout << "VolManifest::read() Invalid manifest '" << filename << "'" << std::endl;
+        return false;
+    }
+
+    _name = line.substr(std::strlen(VOLGEN_MANIFEST_MAGIC));
+    StringUtils::Trim(_name);
+
+    while ( std::getline(mfs, line) )
+    {
+        std::vector<std::string> fields;
+        StringUtils::split(line, '\t', std::back_inserter(fields));
+
+        if ( fields.size() != 4 && fields.size() != 5 ) {
+            std::cout << "VolManifest::read() Invalid entry: " << line << std::endl;
+            return false;
+        }
+
+        ManifestEntry entry;
+        entry.digest = fields[0];
+        entry.size   = ::strtoull(fields[1].c_str(), NULL, 10);
+        entry.mtime  = ::strtoll(fields[2].c_str(), NULL, 10);
+        entry.name   = VolManifest::Unescape(fields[3]);
+
+        if ( fields.size() == 5 )
+            entry.link = VolManifest::Unescape(fields[4]);
+
+        if ( entry.digest.compare("-") == 0 )
+            entry.digest.clear();
+
+        _entries.push_back(entry);
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Computes the SHA-256 digest of the given file, setting the size,
+  *  mtime and digest of the entry. A symlink is not followed, only
+  *  its target is recorded.
+ **/
+bool
+VolManifest::HashFile ( FileReader & reader, const std::string & path,
+                        ManifestEntry & entry )
+{
+    unsigned char       md[EVP_MAX_MD_SIZE];
+    unsigned int        mdlen = 0;
+    const char *        data  = NULL;
+    ssize_t             rd;
+    struct stat         sb;
+
+    if ( ::lstat(path.c_str(), &sb) == 0 && S_ISLNK(sb.st_mode) )
+    {
+        char    link[PATH_MAX];
+        ssize_t len = ::readlink(path.c_str(), link, sizeof(link));
+
+        if ( len <= 0 ) {
+            std::cout << "VolManifest::HashFile() Error reading link '" << path << "' : "
+                << strerror(errno) << std::endl;
+            return false;
+        }
+
+        entry.size  = 0;
+        entry.mtime = sb.st_mtime;
+        entry.link  = std::string(link, len);
+        entry.digest.clear();
+
+        return true;
+    }
+
+    if ( ! reader.open(path) ) {
+        std::cout << "VolManifest::HashFile() Error opening '" << path << "' : "
+            << strerror(reader.getError()) << std::endl;
+        return false;
+    }
+
+    EVP_MD_CTX * ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+
+    while ( (rd = reader.read(&data)) > 0 )
+        EVP_DigestUpdate(ctx, data, rd);
+
+    EVP_DigestFinal_ex(ctx, md, &mdlen);
+    EVP_MD_CTX_free(ctx);
+
+    entry.size  = reader.getOffset();
+    entry.mtime = reader.getStat().st_mtime;
+    reader.close();
+
+    if ( rd < 0 ) {
+        std::cout << "VolManifest::HashFile() Error reading '" << path << "' : "
+            << strerror(reader.getError()) << std::endl;
+        entry.digest.clear();
+        return false;
+    }
+
+    entry.digest = VolManifest::ToHex(md, mdlen);
+
+    return true;
+}
+
+
+std::string
+VolManifest::GetManifestName ( const std::string & volpath,
+                               const std::string & volname )
+{
+    std::string name = volpath;
+
+    if ( ! StringUtils::EndsWith(name, "/") )
+        name.append("/");
+    name.append(volname).append(VOLGEN_MANIFEST_EXT);
+
+    return name;
+}
+
+
+std::string
+VolManifest::ToHex ( const unsigned char * md, size_t len )
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string       str(len * 2, '0');
+
+    for ( size_t i = 0; i < len; ++i ) {
+        str[i*2]   = hex[md[i] >> 4];
+        str[i*2+1] = hex[md[i] & 0x0f];
+    }
+
+    return str;
+}
+
+// -------------------------------------------------------------- //
+
+std::string
+VolManifest::Escape ( const std::string & str )
+{
+    std::string esc;
+    esc.reserve(str.length());
+
+    for ( size_t i = 0; i < str.length(); ++i )
+    {
+        switch ( str[i] ) {
+            case '\\':
+                esc.append("\\\\");
+                break;
+            case '\t':
+                esc.append("\\t");
+                break;
+            case '\n':
+                esc.append("\\n");
+                break;
+            default:
+                esc.push_back(str[i]);
+                break;
+        }
+    }
+
+    return esc;
+}
+
+
+std::string
+VolManifest::Unescape ( const std::string & str )
+{
+    std::string name;
+    name.reserve(str.length());
+
+    for ( size_t i = 0; i < str.length(); ++i )
+    {
+        if ( str[i] != '\\' || i + 1 == str.length() ) {
+            name.push_back(str[i]);
+            continue;
+        }
+
+        switch ( str[++i] ) {
+            case 't':
+                name.push_back('\t');
+                break;
+            case 'n':
+                name.push_back('\n');
+                break;
+            default:
+                name.push_back(str[i]);
+                break;
+        }
+    }
+
+    return name;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLMANIFEST_CPP_
@@ -0,0 +1,731 @@
+/**
+  * @file   VolParity.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLPARITY_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include <openssl/evp.h>
+
+#include "VolParity.h"
+#include "VolGen.h"
+#include "ReedSolomon.h"
+#include "ThreadPool.hpp"
+
+#include "util/FileUtils.h"
+#include "util/StringUtils.h"
+using namespace tcanetpp;
+
+
+namespace volgen {
+
+
+static bool
+WriteAll ( int fd, const uint8_t * buf, size_t len, off_t offset )
+{
+    while ( len > 0 )
+    {
+        ssize_t w = ::pwrite(fd, buf, len, offset);
+        if ( w < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+        buf    += w;
+        len    -= w;
+        offset += w;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+bool
+ParityHeader::write ( int fd ) const
+{
+    std::ostringstream hdr;
+    char               buf[VOLGEN_PARITY_HDRSZ];
+
+    hdr << VOLGEN_PARITY_MAGIC << "\n"
+        << "group="   << group   << "\n"
+        << "data="    << ndata   << "\n"
+        << "parity="  << nparity << "\n"
+        << "index="   << index   << "\n"
+        << "length="  << length  << "\n";
+    for ( size_t i = 0; i < volumes.size(); ++i )
+        hdr << "volume=" << volumes[i] << "\n";
+
+    std::string str = hdr.str();
+
+    if ( str.length() >= sizeof(buf) )
+        return false;
+
+    std::memset(buf, 0, sizeof(buf));
+    std::memcpy(buf, str.data(), str.length());
+
+    return WriteAll(fd, (const uint8_t*) buf, sizeof(buf), 0);
+}
+
+
+bool
+ParityHeader::read ( int fd )
+{
+    char buf[VOLGEN_PARITY_HDRSZ + 1];
+
+    if ( ::pread(fd, buf, VOLGEN_PARITY_HDRSZ, 0) != VOLGEN_PARITY_HDRSZ )
+        return false;
+
+    buf[VOLGEN_PARITY_HDRSZ] = '\0';
+
+    std::vector<std::string> lines;
+    StringUtils::split(std::string(buf), '\n', std::back_inserter(lines));
+
+    if ( lines.empty() || lines[0].compare(VOLGEN_PARITY_MAGIC) != 0 )
+        return false;
+
+    volumes.clear();
+
+    for ( size_t i = 1; i < lines.size(); ++i )
+    {
+        int indx = StringUtils::IndexOf(lines[i], "=");
+        if ( indx <= 0 )
+            continue;
+
+        std::string key = lines[i].substr(0, indx);
+        std::string val = lines[i].substr(indx + 1);
+
+        if ( key.compare("group") == 0 )
+            group = ::atoi(val.c_str());
+        else if ( key.compare("data") == 0 )
+            ndata = ::atoi(val.c_str());
+        else if ( key.compare("parity") == 0 )
+            nparity = ::atoi(val.c_str());
+        else if ( key.compare("index") == 0 )
+            index = ::atoi(val.c_str());
+        else if ( key.compare("length") == 0 )
+            length = ::strtoull(val.c_str(), NULL, 10);
+        else if ( key.compare("volume") == 0 )
+            volumes.push_back(val);
+    }
+
+    return ( ndata > 0 && (int) volumes.size() == ndata );
+}
+
+// -------------------------------------------------------------- //
+
+/**  Splits a decoded volume stream back into the files of its
+  *  manifest, checking each file against its recorded checksum.
+ **/
+class ManifestSink {
+
+  public:
+
+    ManifestSink ( const VolManifest & manifest, const std::string & outdir )
+        : _entries(manifest.getEntries()),
+          _outdir(outdir),
+          _indx(0),
+          _fd(-1),
+          _left(0),
+          _pos(0),
+          _bad(0),
+          _ctx(NULL)
+    {}
+
+    ~ManifestSink()
+    {
+        if ( _fd >= 0 )
+            ::close(_fd);
+        if ( _ctx != NULL )
+            EVP_MD_CTX_free(_ctx);
+    }
+
+    bool write ( const uint8_t * buf, size_t len )
+    {
+        while ( len > 0 || (_fd < 0 && _indx < _entries.size() && _entries[_indx].size == 0) )
+        {
+            if ( _fd < 0 && _indx < _entries.size() && _entries[_indx].isLink() ) {
+                if ( ! this->link() )
+                    return false;
+                continue;
+            }
+
+            if ( _fd < 0 && ! this->open() )
+                return false;
+
+            size_t wr = std::min((uint64_t) len, _left);
+
+            EVP_DigestUpdate(_ctx, buf, wr);
+
+            if ( ! WriteAll(_fd, buf, wr, _pos) ) {
+                std::cout << "VolParity: Write error for '" << _path << "' : "
+                    << strerror(errno) << std::endl;
+                return false;
+            }
+
+            buf   += wr;
+            len   -= wr;
+            _pos  += wr;
+            _left -= wr;
+
+            if ( _left == 0 )
+                this->close();
+        }
+
+        return true;
+    }
+
+    bool finish()
+    {
+        if ( ! this->write(NULL, 0) )
+            return false;
+
+        std::cout << "VolParity: " << _indx << " file(s) reconstructed in "
+                  << _outdir << ", " << _bad << " checksum mismatch(es)" << std::endl;
+
+        return ( _bad == 0 && _indx == _entries.size() );
+    }
+
+  private:
+
+    bool open()
+    {
+        if ( _indx >= _entries.size() )
+            return false;
+
+        _path = _outdir + "/" + _entries[_indx].name;
+        VolGen::MakeDirs(VolGen::GetPathName(_path));
+
+        _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if ( _fd < 0 ) {
+            std::cout << "VolParity: Error creating '" << _path << "' : "
+                << strerror(errno) << std::endl;
+            return false;
+        }
+
+        _left = _entries[_indx].size;
+        _pos  = 0;
+        _ctx  = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(_ctx, EVP_sha256(), NULL);
+
+        return true;
+    }
+
+    /* a symlink has no data in the stream, it is recreated as recorded */
+    bool link()
+    {
+        const ManifestEntry & entry = _entries[_indx];
+
+        _path = _outdir + "/" + entry.name;
+        VolGen::MakeDirs(VolGen::GetPathName(_path));
+        ::unlink(_path.c_str());
+
+        if ( ::symlink(entry.link.c_str(), _path.c_str()) < 0 ) {
+            std::cout << "VolParity: Error creating link '" << _path << "' : "
+                << strerror(errno) << std::endl;
+            return false;
+        }
+
+        _indx++;
+        return true;
+    }
+
+    void close()
+    {
+        const ManifestEntry & entry = _entries[_indx];
+        unsigned char         md[EVP_MAX_MD_SIZE];
+        unsigned int          mdlen = 0;
+
+        ::close(_fd);
+        _fd = -1;
+
+        EVP_DigestFinal_ex(_ctx, md, &mdlen);
+        EVP_MD_CTX_free(_ctx);
+        _ctx = NULL;
+
+        if ( ! entry.digest.empty() && entry.digest.compare(VolManifest::ToHex(md, mdlen)) != 0 ) {
+            std::cout << "  MISMATCH  " << entry.name << std::endl;
+            _bad++;
+        }
+
+        if ( entry.mtime > 0 ) {
+            struct timespec ts[2];
+            ts[0].tv_sec  = ts[1].tv_sec  = entry.mtime;
+            ts[0].tv_nsec = ts[1].tv_nsec = 0;
+            ::utimensat(AT_FDCWD, _path.c_str(), ts, 0);
+        }
+
+        _indx++;
+    }
+
+  private:
+
+    const ManifestEntryList &  _entries;
+    std::string                _outdir;
+    std::string                _path;
+    size_t                     _indx;
+    int                        _fd;
+    uint64_t                   _left;
+    off_t                      _pos;
+    size_t                     _bad;
+    EVP_MD_CTX *               _ctx;
+
+};
+
+// -------------------------------------------------------------- //
+
+VolStream::VolStream ( const VolManifest & manifest, const std::string & root )
+    : _seg(0),
+      _fd(-1),
+      _segoff(0),
+      _length(0),
+      _errors(0)
+{
+    const ManifestEntryList & entries = manifest.getEntries();
+
+    _segs.reserve(entries.size());
+
+    for ( size_t i = 0; i < entries.size(); ++i ) {
+        Segment seg = { root + "/" + entries[i].name, 0, entries[i].size };
+        _segs.push_back(seg);
+        _length += entries[i].size;
+    }
+}
+
+
+VolStream::VolStream ( const std::string & path, uint64_t offset, uint64_t length )
+    : _seg(0),
+      _fd(-1),
+      _segoff(0),
+      _length(length),
+      _errors(0)
+{
+    Segment seg = { path, offset, length };
+    _segs.push_back(seg);
+}
+
+
+VolStream::~VolStream()
+{
+    if ( _fd >= 0 )
+        ::close(_fd);
+}
+
+
+bool
+VolStream::openSegment()
+{
+    const Segment & seg = _segs[_seg];
+
+    _fd = ::open(seg.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( _fd < 0 ) {
+        std::cout << "VolStream: Error opening '" << seg.path << "' : "
+            << strerror(errno) << std::endl;
+        _errors++;
+        return false;
+    }
+
+    ::posix_fadvise(_fd, seg.offset, seg.size, POSIX_FADV_SEQUENTIAL);
+
+    return true;
+}
+
+
+/**  Reads the next 'len' bytes of the stream, zero filling past the
+  *  end of the stream or any segment that cannot be read in full.
+ **/
+void
+VolStream::read ( uint8_t * buf, size_t len )
+{
+    while ( len > 0 )
+    {
+        if ( _seg >= _segs.size() ) {
+            std::memset(buf, 0, len);
+            return;
+        }
+
+        const Segment & seg  = _segs[_seg];
+        uint64_t        left = seg.size - _segoff;
+        size_t          want = ( left < len ) ? left : len;
+        size_t          rd   = 0;
+
+        if ( _fd < 0 && _segoff == 0 && want > 0 )
+            this->openSegment();
+
+        while ( _fd >= 0 && rd < want )
+        {
+            ssize_t r = ::pread(_fd, buf + rd, want - rd, seg.offset + _segoff + rd);
+            if ( r < 0 && errno == EINTR )
+                continue;
+            if ( r <= 0 ) {
+                std::cout << "VolStream: Short read for '" << seg.path << "'" << std::endl;
+                _errors++;
+                ::close(_fd);
+                _fd = -1;
+                break;
+            }
+            rd += r;
+        }
+
+        if ( rd < want )
+            std::memset(buf + rd, 0, want - rd);
+
+        buf     += want;
+        len     -= want;
+        _segoff += want;
+
+        if ( _segoff == seg.size ) {
+            if ( _fd >= 0 ) {
+                ::posix_fadvise(_fd, seg.offset, seg.size, POSIX_FADV_DONTNEED);
+                ::close(_fd);
+            }
+            _fd     = -1;
+            _segoff = 0;
+            _seg++;
+        }
+    }
+}
+
+// -------------------------------------------------------------- //
+
+VolParity::VolParity ( const std::string & voldir, int ndata, int nparity )
+    : _voldir(voldir),
+      _ndata(ndata),
+      _nparity(nparity)
+{}
+
+
+/**  Generates the parity files for the given data volumes, whose
+  *  manifests must already exist in the meta dir. File contents are
+  *  read through the generated volumes, as 'root/<volume>', so that
+  *  bundles are covered as written.
+ **/
+bool
+VolParity::encode ( const std::vector<std::string> & volnames,
+                    const std::string & root, size_t nthreads )
+{
+    if ( _ndata < 1 || _nparity < 1 || _ndata + _nparity > VOLGEN_RS_MAXSHARDS ) {
+        std::cout << "VolParity: Invalid parity configuration " << _ndata
+                  << ":" << _nparity << std::endl;
+        return false;
+    }
+
+    ThreadPool pool(nthreads);
+    bool       result = true;
+    int        group  = 0;
+
+    std::cout << "VolParity: Using " << ReedSolomon::GetKernelName()
+              << " kernel" << std::endl;
+
+    for ( size_t first = 0; first < volnames.size(); first += _ndata )
+    {
+        int    ndata  = std::min((size_t) _ndata, volnames.size() - first);
+        size_t stripe = VOLGEN_PARITY_CHUNK;
+
+        ReedSolomon              rs(ndata, _nparity);
+        std::vector<VolManifest> manifests(ndata);
+        std::vector<std::unique_ptr<VolStream> >  streams;
+        std::vector<int>         fds;
+        ParityHeader             hdr;
+
+        group++;
+        hdr.group   = group;
+        hdr.ndata   = ndata;
+        hdr.nparity = _nparity;
+
+        for ( int i = 0; i < ndata; ++i ) {
+            const std::string & name = volnames[first + i];
+            if ( ! manifests[i].read(VolManifest::GetManifestName(_voldir, name)) )
+                return false;
+            streams.emplace_back(new VolStream(manifests[i], root + "/" + name));
+            hdr.volumes.push_back(name);
+            hdr.length = std::max(hdr.length, streams.back()->getLength());
+        }
+
+        for ( int j = 0; j < _nparity && result; ++j )
+        {
+            std::string pname = VolParity::GetParityName(_voldir, group, j + 1);
+            int         fd    = ::open(pname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+            hdr.index = j + 1;
+
+            if ( fd < 0 || ! hdr.write(fd) ) {
+                std::cout << "VolParity: Error writing '" << pname << "' : "
+                    << strerror(errno) << std::endl;
+                result = false;
+            }
+            fds.push_back(fd);
+        }
+
+        /* double buffered data shards: the next stripe is read while
+         * the current one is encoded */
+        std::vector<uint8_t> dbuf[2], pbuf(_nparity * stripe);
+        dbuf[0].resize(ndata * stripe);
+        dbuf[1].resize(ndata * stripe);
+
+        uint64_t nstripes = (hdr.length + stripe - 1) / stripe;
+        int      cur      = 0;
+
+        for ( int i = 0; i < ndata && nstripes > 0; ++i )
+            pool.push([&, i]{ streams[i]->read(&dbuf[0][i * stripe], stripe); });
+        pool.wait();
+
+        for ( uint64_t s = 0; s < nstripes && result; ++s )
+        {
+            int nxt = cur ^ 1;
+
+            if ( s + 1 < nstripes ) {
+                for ( int i = 0; i < ndata; ++i )
+                    pool.push([&, i, nxt]{ streams[i]->read(&dbuf[nxt][i * stripe], stripe); });
+            }
+
+            for ( size_t off = 0; off < stripe; off += VOLGEN_PARITY_SLICE )
+            {
+                pool.push([&, off, cur] {
+                    const uint8_t * data[VOLGEN_RS_MAXSHARDS];
+                    uint8_t *       parity[VOLGEN_RS_MAXSHARDS];
+
+                    for ( int i = 0; i < ndata; ++i )
+                        data[i] = &dbuf[cur][(i * stripe) + off];
+                    for ( int j = 0; j < _nparity; ++j )
+                        parity[j] = &pbuf[(j * stripe) + off];
+
+                    rs.encode(data, parity, VOLGEN_PARITY_SLICE);
+                });
+            }
+            pool.wait();
+
+            size_t len = std::min((uint64_t) stripe, hdr.length - (s * stripe));
+            off_t  pos = VOLGEN_PARITY_HDRSZ + (s * stripe);
+
+            for ( int j = 0; j < _nparity; ++j ) {
+                if ( ! WriteAll(fds[j], &pbuf[j * stripe], len, pos) ) {
+                    std::cout << "VolParity: Write error: " << strerror(errno) << std::endl;
+                    result = false;
+                    break;
+                }
+            }
+
+            cur = nxt;
+        }
+
+        for ( int i = 0; i < ndata; ++i ) {
+            if ( streams[i]->getErrors() > 0 )
+                result = false;
+        }
+        for ( size_t j = 0; j < fds.size(); ++j ) {
+            if ( fds[j] >= 0 )
+                ::close(fds[j]);
+        }
+
+        if ( ! result )
+            break;
+
+        std::cout << "VolParity: Group " << group << " : " << ndata << " data + "
+                  << _nparity << " parity volume(s), "
+                  << (hdr.length / (1024 * 1024)) << " Mb per volume" << std::endl;
+    }
+
+    return result;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Reconstructs the files of a lost data volume into 'outdir'. The
+  *  surviving data volumes are expected to be mounted (or copied) as
+  *  '<media>/Volume_NN'; parity files are taken from the meta dir or
+  *  from the media path.
+ **/
+bool
+VolParity::reconstruct ( const std::string & volname, const std::string & media,
+                         const std::string & outdir, size_t nthreads )
+{
+    ParityHeader hdr;
+    bool         found = false;
+
+    if ( ! VolGen::MakeDirs(outdir) ) {
+        std::cout << "VolParity: Error creating '" << outdir << "' : "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    for ( int g = 1; ! found; ++g )
+    {
+        std::string pname;
+        for ( int j = 1; j <= VOLGEN_RS_MAXSHARDS && pname.empty(); ++j )
+            pname = this->findParity(g, j, media);
+
+        if ( pname.empty() )
+            break;
+
+        int fd = ::open(pname.c_str(), O_RDONLY | O_CLOEXEC);
+        if ( fd < 0 || ! hdr.read(fd) ) {
+            std::cout << "VolParity: Invalid parity file '" << pname << "'" << std::endl;
+            if ( fd >= 0 )
+                ::close(fd);
+            return false;
+        }
+        ::close(fd);
+
+        for ( size_t i = 0; i < hdr.volumes.size(); ++i ) {
+            if ( hdr.volumes[i].compare(volname) == 0 )
+                found = true;
+        }
+    }
+
+    if ( ! found ) {
+        std::cout << "VolParity: No parity group found for " << volname << std::endl;
+        return false;
+    }
+
+    ReedSolomon              rs(hdr.ndata, hdr.nparity);
+    std::vector<VolManifest> manifests(hdr.ndata);
+    std::vector<int>         shards;
+    std::vector<std::unique_ptr<VolStream> >  streams;
+    int                      target = -1;
+
+    for ( int i = 0; i < hdr.ndata; ++i )
+    {
+        const std::string & name = hdr.volumes[i];
+
+        if ( ! manifests[i].read(VolManifest::GetManifestName(_voldir, name)) )
+            return false;
+
+        if ( name.compare(volname) == 0 ) {
+            target = i;
+            continue;
+        }
+
+        std::string vroot = media + "/" + name;
+        if ( (int) shards.size() < hdr.ndata && FileUtils::IsDirectory(vroot) ) {
+            shards.push_back(i);
+            streams.emplace_back(new VolStream(manifests[i], vroot));
+        }
+    }
+
+    for ( int j = 1; j <= hdr.nparity && (int) shards.size() < hdr.ndata; ++j )
+    {
+        std::string pname = this->findParity(hdr.group, j, media);
+        if ( pname.empty() )
+            continue;
+        shards.push_back(hdr.ndata + j - 1);
+        streams.emplace_back(new VolStream(pname, VOLGEN_PARITY_HDRSZ, hdr.length));
+    }
+
+    std::vector<uint8_t> coeffs;
+    bool                 result = rs.decodeRow(shards, target, coeffs);
+
+    if ( ! result ) {
+        std::cout << "VolParity: Insufficient volumes to reconstruct " << volname
+                  << ", " << shards.size() << " of " << hdr.ndata << " available"
+                  << std::endl;
+    } else {
+        std::cout << "VolParity: Reconstructing " << volname << " from "
+                  << shards.size() << " volume(s) using "
+                  << ReedSolomon::GetKernelName() << " kernel" << std::endl;
+
+        ThreadPool           pool(nthreads);
+        ManifestSink         sink(manifests[target], outdir);
+        size_t               stripe = VOLGEN_PARITY_CHUNK;
+        size_t               nsh    = shards.size();
+        uint64_t             length = manifests[target].getSize();
+        std::vector<uint8_t> sbuf(nsh * stripe), obuf(stripe);
+
+        for ( uint64_t pos = 0; pos < length && result; pos += stripe )
+        {
+            for ( size_t k = 0; k < nsh; ++k )
+                pool.push([&, k]{ streams[k]->read(&sbuf[k * stripe], stripe); });
+            pool.wait();
+
+            for ( size_t off = 0; off < stripe; off += VOLGEN_PARITY_SLICE )
+            {
+                pool.push([&, off] {
+                    const uint8_t * src[VOLGEN_RS_MAXSHARDS];
+                    for ( size_t k = 0; k < nsh; ++k )
+                        src[k] = &sbuf[(k * stripe) + off];
+                    ReedSolomon::Combine(&coeffs[0], src, nsh, &obuf[off], VOLGEN_PARITY_SLICE);
+                });
+            }
+            pool.wait();
+
+            size_t len = std::min((uint64_t) stripe, length - pos);
+            result = sink.write(&obuf[0], len);
+        }
+
+        for ( size_t k = 0; k < nsh; ++k ) {
+            if ( streams[k]->getErrors() > 0 )
+                std::cout << "VolParity: Warning, " << streams[k]->getErrors()
+                          << " read error(s) on source volume" << std::endl;
+        }
+
+        if ( result )
+            result = sink.finish();
+    }
+
+    return result;
+}
+
+// -------------------------------------------------------------- //
+
+std::string
+VolParity::findParity ( int group, int index, const std::string & media ) const
+{
+    std::string pname = VolParity::GetParityName(_voldir, group, index);
+
+    if ( FileUtils::IsReadable(pname) )
+        return pname;
+
+    if ( ! media.empty() ) {
+        pname = VolParity::GetParityName(media, group, index);
+        if ( FileUtils::IsReadable(pname) )
+            return pname;
+    }
+
+    return std::string();
+}
+
+
+std::string
+VolParity::GetParityName ( const std::string & path, int group, int index )
+{
+    std::ostringstream name;
+
+    name << path;
+    if ( ! StringUtils::EndsWith(path, "/") )
+        name << "/";
+    name << VOLGEN_PARITY_PREFIX << std::setfill('0') << std::setw(2) << group
+         << "_" << index << VOLGEN_PARITY_EXT;
+
+    return name.str();
+}
+
+}  // namespace
+
+// _VOLGEN_VOLPARITY_CPP_
@@ -0,0 +1,254 @@
+/**
+  * @file   VolProfile.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLPROFILE_CPP_
+
+#include <algorithm>
+#include <iomanip>
+
+#include "VolProfile.h"
+
+
+namespace volgen {
+
+
+static const char*
+ProfileOpNames[] = { "opendir", "readdir", "lstat", "stat" };
+
+
+LatencyHistogram::LatencyHistogram()
+    : _counts(VOLGEN_HIST_BUCKETS, 0),
+      _count(0),
+      _total(0),
+      _max(0)
+{}
+
+
+void
+LatencyHistogram::add ( uint64_t ns )
+{
+    _counts[LatencyHistogram::GetBucket(ns)]++;
+    _count++;
+    _total += ns;
+
+    if ( ns > _max )
+        _max = ns;
+}
+
+
+/**  Returns the upper limit of the bucket holding the given percentile */
+uint64_t
+LatencyHistogram::getPercentile ( double pct ) const
+{
+    uint64_t target = (uint64_t) (pct * _count / 100.0 + 0.5);
+    uint64_t seen   = 0;
+
+    if ( _count == 0 )
+        return 0;
+    if ( target == 0 )
+        target = 1;
+
+    for ( size_t i = 0; i < _counts.size(); ++i ) {
+        seen += _counts[i];
+        if ( seen >= target )
+            return std::min(LatencyHistogram::GetBucketLimit(i), _max);
+    }
+
+    return _max;
+}
+
+
+/**  Values below 2^SUBBITS have a bucket each, beyond that each power
+  *  of two has 2^SUBBITS buckets.
+ **/
+size_t
+LatencyHistogram::GetBucket ( uint64_t ns )
+{
+    const uint64_t sub = 1ULL << VOLGEN_HIST_SUBBITS;
+
+    if ( ns < sub )
+        return ns;
+
+    int exp = 63 - __builtin_clzll(ns);
+
+    return( (exp - VOLGEN_HIST_SUBBITS + 1) * sub
+            + ((ns >> (exp - VOLGEN_HIST_SUBBITS)) & (sub - 1)) );
+}
+
+
+uint64_t
+LatencyHistogram::GetBucketLimit ( size_t indx )
+{
+    const uint64_t sub = 1ULL << VOLGEN_HIST_SUBBITS;
+
+    if ( indx < sub )
+        return indx;
+
+    int      shift = (indx / sub) - 1;
+    uint64_t first = (sub + (indx % sub)) << shift;
+
+    return( first + ((1ULL << shift) - 1) );
+}
+
+// -------------------------------------------------------------- //
+
+VolProfile::VolProfile ( size_t topn )
+    : _topn(topn),
+      _dirs(0),
+      _wall(0)
+{}
+
+
+void
+VolProfile::enter ( const std::string & path )
+{
+    Frame frame;
+
+    frame.path  = path;
+    frame.start = VolProfile::Now();
+    frame.child = 0;
+
+    _stack.push_back(frame);
+}
+
+
+/**  Closes the directory entered last, charging it the time spent in
+  *  it outside of its subdirectories. The most costly directories are
+  *  kept as a heap, the least costly of them at the front.
+ **/
+void
+VolProfile::leave ( uint64_t entries )
+{
+    if ( _stack.empty() )
+        return;
+
+    Frame & frame = _stack.back();
+    DirCost cost;
+
+    cost.total   = VolProfile::Now() - frame.start;
+    cost.self    = ( cost.total > frame.child ) ? cost.total - frame.child : 0;
+    cost.entries = entries;
+
+    _dirs++;
+
+    if ( _topn > 0 && (_top.size() < _topn || cost.self > _top.front().self) )
+    {
+        cost.path.swap(frame.path);
+
+        if ( _top.size() == _topn ) {
+            std::pop_heap(_top.begin(), _top.end());
+            _top.pop_back();
+        }
+
+        _top.push_back(cost);
+        std::push_heap(_top.begin(), _top.end());
+    }
+
+    _stack.pop_back();
+
+    if ( _stack.empty() )
+        _wall += cost.total;
+    else
+        _stack.back().child += cost.total;
+}
+
+
+void
+VolProfile::display ( std::ostream & strm ) const
+{
+    std::ios_base::fmtflags flags = strm.flags();
+    std::vector<DirCost>    top(_top);
+    uint64_t                calls = 0;
+
+    std::sort(top.begin(), top.end());
+
+    for ( int op = 0; op < VOLGEN_PROF_MAX; ++op )
+        calls += _hist[op].getTotal();
+
+    strm << std::endl << "VolGen: Scanned " << _dirs << " directories in "
+         << std::fixed << std::setprecision(3) << (_wall / 1e9) << " s, "
+         << std::setprecision(1) << (( _wall > 0 ) ? (calls * 100.0 / _wall) : 0.0)
+         << "% of it in the calls below" << std::endl << std::endl;
+
+    strm << std::setw(10) << std::setiosflags(std::ios_base::left) << "Call"
+         << std::setw(12) << "Count"
+         << std::setw(12) << "Total (ms)"
+         << std::setw(10) << "p50 (us)"
+         << std::setw(10) << "p90 (us)"
+         << std::setw(10) << "p99 (us)"
+         << std::setw(12) << "p99.9 (us)"
+         << "Max (us)" << std::endl;
+    strm << std::setw(10) << "----"
+         << std::setw(12) << "-----"
+         << std::setw(12) << "----------"
+         << std::setw(10) << "--------"
+         << std::setw(10) << "--------"
+         << std::setw(10) << "--------"
+         << std::setw(12) << "----------"
+         << "--------" << std::endl;
+
+    for ( int op = 0; op < VOLGEN_PROF_MAX; ++op )
+    {
+        const LatencyHistogram & hist = _hist[op];
+
+        strm << std::setw(10) << VolProfile::GetOpName(op)
+             << std::setw(12) << hist.getCount()
+             << std::setw(12) << std::setprecision(1) << (hist.getTotal() / 1e6)
+             << std::setw(10) << (hist.getPercentile(50.0) / 1e3)
+             << std::setw(10) << (hist.getPercentile(90.0) / 1e3)
+             << std::setw(10) << (hist.getPercentile(99.0) / 1e3)
+             << std::setw(12) << (hist.getPercentile(99.9) / 1e3)
+             << (hist.getMax() / 1e3) << std::endl;
+    }
+
+    strm << std::endl
+         << std::setw(12) << "Self (ms)"
+         << std::setw(14) << "Subtree (ms)"
+         << std::setw(10) << "Entries"
+         << "Directory" << std::endl;
+    strm << std::setw(12) << "---------"
+         << std::setw(14) << "------------"
+         << std::setw(10) << "-------"
+         << "---------" << std::endl;
+
+    for ( size_t i = 0; i < top.size(); ++i )
+    {
+        strm << std::setw(12) << (top[i].self / 1e6)
+             << std::setw(14) << (top[i].total / 1e6)
+             << std::setw(10) << top[i].entries
+             << top[i].path << std::endl;
+    }
+
+    strm << std::endl;
+    strm.flags(flags);
+}
+
+
+const char*
+VolProfile::GetOpName ( int op )
+{
+    if ( op < 0 || op >= VOLGEN_PROF_MAX )
+        return "unknown";
+
+    return ProfileOpNames[op];
+}
+
+}  // namespace
+
+// _VOLGEN_VOLPROFILE_CPP_
@@ -0,0 +1,626 @@
+/**
+  * @file   VolRestore.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLRESTORE_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#include "VolRestore.h"
+#include "VolArchive.h"
+#include "VolWriter.h"
+#include "FileReader.h"
+#include "ThreadPool.hpp"
+
+
+namespace volgen {
+
+
+/**  Bounds the number of files being written at once to a device */
+struct WriteSlots {
+    std::mutex               lock;
+    std::condition_variable  cond;
+    size_t                   active;
+    size_t                   limit;
+
+    explicit WriteSlots ( size_t n ) : active(0), limit(( n == 0 ) ? 1 : n) {}
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+        cond.wait(lock, [this]{ return active < limit; });
+        active++;
+    }
+
+    void release()
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->lock);
+            active--;
+        }
+        cond.notify_one();
+    }
+};
+
+
+/**  A file to restore, read from 'offset' of the source file */
+struct RestoreJob {
+    const IndexEntry *  entry;
+    std::string         source;
+    uint64_t            offset;
+    uint64_t            size;
+    mode_t              mode;
+    time_t              mtime;
+    bool                symlink;
+    std::string         link;
+
+    RestoreJob ( const IndexEntry * e = NULL )
+        : entry(e), offset(0), size(0), mode(0644), mtime(0), symlink(false) {}
+
+    bool operator< ( const RestoreJob & j ) const
+    {
+        if ( source != j.source )
+            return( source < j.source );
+        return( offset < j.offset );
+    }
+};
+
+
+/**  Takes the mode and time of a bundle member from the ustar header
+  *  immediately preceding its data.
+ **/
+static void
+ReadMemberStat ( int fd, uint64_t offset, RestoreJob & job )
+{
+    char hdr[VOLGEN_TAR_BLOCK];
+
+    if ( offset >= VOLGEN_TAR_BLOCK && VolArchive::ReadBlock(fd, offset - VOLGEN_TAR_BLOCK, hdr)
+         && std::memcmp(&hdr[257], "ustar", 5) == 0 )
+    {
+        job.mode  = VolArchive::GetOctal(&hdr[100], 8);
+        job.mtime = VolArchive::GetOctal(&hdr[136], 12);
+    }
+}
+
+
+/**  Returns true when the volume member at 'path' is a symlink of the
+  *  tree itself, setting 'link' to its target. Volumes staged by
+  *  symlink link each item to its 'source' in the tree, and such a
+  *  link is followed once to the member it stands for.
+ **/
+static bool
+ReadTreeLink ( const std::string & path, const std::string & source, std::string & link )
+{
+    char        buf[PATH_MAX];
+    std::string cur = path;
+
+    for ( int hop = 0; hop < 2; ++hop )
+    {
+        ssize_t len = ::readlink(cur.c_str(), buf, sizeof(buf));
+
+        if ( len < 0 )
+            return false;
+
+        link.assign(buf, len);
+
+        if ( link != source )
+            return true;
+
+        cur = source;
+    }
+
+    return false;
+}
+
+
+/**  Copies 'len' bytes from 'off' of one file to the end of the other
+  *  with copy_file_range(), which the filesystem may serve by reflink
+  *  or server side copy. Where it cannot be used the data is read in
+  *  large chunks into the aligned 'buf'.
+ **/
+static bool
+CopyRange ( int in, uint64_t off, uint64_t len, int out, char * buf, bool & cfr )
+{
+    loff_t   ioff = off;
+    uint64_t done = 0;
+
+    while ( done < len )
+    {
+        size_t  n = std::min(len - done, (uint64_t) VOLGEN_COPY_CHUNK);
+        ssize_t r;
+
+        if ( cfr )
+        {
+            r = ::copy_file_range(in, &ioff, out, NULL, n, 0);
+
+            if ( r < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+                           || errno == EOPNOTSUPP || errno == EBADF) )
+            {
+                cfr = false;
+                continue;
+            }
+        }
+        else
+        {
+            r = ::pread(in, buf, std::min(n, (size_t) VOLGEN_READ_BUFSZ), ioff);
+
+            for ( ssize_t w = 0, wr; r > 0 && w < r; w += wr ) {
+                if ( (wr = ::write(out, buf + w, r - w)) < 0 ) {
+                    if ( errno == EINTR ) {
+                        wr = 0;
+                        continue;
+                    }
+                    return false;
+                }
+            }
+            if ( r > 0 )
+                ioff += r;
+        }
+
+        if ( r < 0 && errno == EINTR )
+            continue;
+        if ( r <= 0 )
+            return false;
+
+        done += r;
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+VolRestore::VolRestore ( const VolIndex & index, const std::string & outdir )
+    : _index(index),
+      _outdir(outdir)
+{
+    while ( _outdir.length() > 1 && _outdir[_outdir.length() - 1] == '/' )
+        _outdir.erase(_outdir.length() - 1);
+}
+
+
+VolRestore::~VolRestore()
+{
+    std::map<dev_t, WriteSlots*>::iterator sIter;
+
+    for ( sIter = _devslots.begin(); sIter != _devslots.end(); ++sIter )
+        delete sIter->second;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Adds a place to look for volumes: a directory holding volumes or
+  *  images as <media>/Volume_NN or <media>/Volume_NN.tar, a single
+  *  volume or image named so, or 'Volume_NN=<path>' for a volume
+  *  mounted elsewhere.
+ **/
+void
+VolRestore::addMedia ( const std::string & media )
+{
+    if ( ! media.empty() )
+        _media.push_back(media);
+}
+
+
+/**  Selects the files matching a path or glob, relative to the index
+  *  root, or every file when empty.
+ **/
+size_t
+VolRestore::select ( const std::string & path )
+{
+    IndexEntryList matches;
+    size_t         found = _index.match(( path.empty() ) ? "*" : path, matches);
+
+    for ( size_t i = 0; i < matches.size(); ++i )
+        _vols[matches[i].volume].push_back(matches[i]);
+
+    return found;
+}
+
+
+/**  Restores the selected files, 'nthreads' volumes at a time (or all
+  *  at once when zero) and at most 'writers' files at a time to each
+  *  target device.
+ **/
+bool
+VolRestore::run ( size_t nthreads, size_t writers )
+{
+    std::map<uint32_t, RestoreSource> srcs;
+    VolumeEntries::iterator           vIter;
+
+    if ( _vols.empty() ) {
+        std::cout << "VolRestore: No files selected" << std::endl;
+        return false;
+    }
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter )
+    {
+        const std::string & volname = _index.getVolumeName(vIter->first);
+        RestoreSource       src;
+
+        if ( ! this->findSource(volname, src) ) {
+            std::cout << "VolRestore: " << volname << " not found in the media, "
+                << vIter->second.size() << " file(s) not restored" << std::endl;
+            _result.missing += vIter->second.size();
+            continue;
+        }
+
+        srcs[vIter->first] = src;
+    }
+
+    if ( ! this->createSkeleton(writers) )
+        return false;
+
+    if ( nthreads == 0 )
+        nthreads = std::max((size_t) 1, srcs.size());
+
+    {
+        ThreadPool pool(nthreads);
+        std::map<uint32_t, RestoreSource>::iterator sIter;
+
+        for ( sIter = srcs.begin(); sIter != srcs.end(); ++sIter )
+        {
+            uint32_t         vol     = sIter->first;
+            RestoreSource *  src     = &sIter->second;
+            IndexEntryList * entries = &_vols[vol];
+
+            pool.push([this, vol, src, entries] { this->restoreVolume(vol, *src, *entries); });
+        }
+
+        pool.wait();
+    }
+
+    return ( _result.errors == 0 && _result.missing == 0 );
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolRestore::findSource ( const std::string & volname, RestoreSource & src ) const
+{
+    std::string image = volname + VOLGEN_IMAGE_EXT;
+    struct stat sb;
+
+    for ( size_t i = 0; i < _media.size(); ++i )
+    {
+        std::string media = _media[i];
+        std::string base;
+        size_t      eq = media.find('=');
+
+        if ( eq != std::string::npos ) {
+            if ( media.substr(0, eq) != volname )
+                continue;
+            media = media.substr(eq + 1);
+            base  = volname;
+        } else {
+            std::string trim = media;
+            while ( trim.length() > 1 && trim[trim.length() - 1] == '/' )
+                trim.erase(trim.length() - 1);
+            base = trim.substr(trim.find_last_of('/') + 1);
+        }
+
+        if ( ::stat(media.c_str(), &sb) < 0 )
+            continue;
+
+        if ( S_ISREG(sb.st_mode) && (base == image || base == volname) ) {
+            src.path  = media;
+            src.image = true;
+            return true;
+        }
+
+        if ( ! S_ISDIR(sb.st_mode) )
+            continue;
+
+        if ( base == volname ) {
+            src.path  = media;
+            src.image = false;
+            return true;
+        }
+
+        if ( ::stat((media + "/" + volname).c_str(), &sb) == 0 && S_ISDIR(sb.st_mode) ) {
+            src.path  = media + "/" + volname;
+            src.image = false;
+            return true;
+        }
+
+        if ( ::stat((media + "/" + image).c_str(), &sb) == 0 && S_ISREG(sb.st_mode) ) {
+            src.path  = media + "/" + image;
+            src.image = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**  Creates every directory of the selected files, parents first, so
+  *  the volume tasks only ever create files. Each directory is mapped
+  *  to the write slots of the device it is on.
+ **/
+bool
+VolRestore::createSkeleton ( size_t writers )
+{
+    std::set<std::string>           dirs;
+    std::set<std::string>::iterator dIter;
+    VolumeEntries::iterator         vIter;
+    struct stat                     sb;
+    size_t                          created = 0;
+
+    for ( vIter = _vols.begin(); vIter != _vols.end(); ++vIter ) {
+        for ( size_t i = 0; i < vIter->second.size(); ++i ) {
+            const std::string & name = vIter->second[i].name;
+            for ( size_t p = name.find('/'); p != std::string::npos; p = name.find('/', p + 1) )
+                dirs.insert(name.substr(0, p));
+        }
+    }
+
+    dirs.insert("");
+
+    /* a parent sorts before its children, being a prefix of them */
+    for ( dIter = dirs.begin(); dIter != dirs.end(); ++dIter )
+    {
+        std::string path = _outdir;
+
+        if ( ! dIter->empty() )
+            path.append("/").append(*dIter);
+
+        if ( ::mkdir(path.c_str(), 0755) == 0 )
+            created++;
+        else if ( errno != EEXIST ) {
+            std::cout << "VolRestore: Error creating '" << path << "' : "
+                << strerror(errno) << std::endl;
+            return false;
+        }
+
+        if ( ::stat(path.c_str(), &sb) < 0 || ! S_ISDIR(sb.st_mode) ) {
+            std::cout << "VolRestore: '" << path << "' is not a directory" << std::endl;
+            return false;
+        }
+
+        WriteSlots *& slots = _devslots[sb.st_dev];
+
+        if ( slots == NULL )
+            slots = new WriteSlots(writers);
+
+        _dirslots[*dIter] = slots;
+    }
+
+    std::cout << "VolRestore: Created " << created << " of " << dirs.size()
+        << " directories in " << _outdir << " on " << _devslots.size()
+        << " device(s)" << std::endl;
+
+    return true;
+}
+
+
+WriteSlots*
+VolRestore::getSlots ( const std::string & name )
+{
+    size_t indx = name.find_last_of('/');
+
+    return _dirslots[( indx == std::string::npos ) ? std::string() : name.substr(0, indx)];
+}
+
+
+/**  Restores the files of a volume, reading the source front to back.
+  *  From a directory the plain files are taken in name order and the
+  *  bundled files by offset from each bundle; from an image every file
+  *  is taken in the order of the image.
+ **/
+void
+VolRestore::restoreVolume ( uint32_t vol, const RestoreSource & src,
+                            IndexEntryList & entries )
+{
+    std::vector<RestoreJob> jobs;
+    TarMemberMap            members;
+    char *                  buf    = NULL;
+    int                     fd     = -1;
+    int                     imgfd  = -1;
+    bool                    cfr    = true;
+    uint64_t                files  = 0;
+    uint64_t                bytes  = 0;
+    uint64_t                errors = 0;
+
+    if ( src.image )
+    {
+        imgfd = ::open(src.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if ( imgfd < 0 || ! VolArchive::ScanImage(imgfd, members) ) {
+            std::cout << "VolRestore: Error reading image '" << src.path << "'" << std::endl;
+            _result.errors += entries.size();
+            if ( imgfd >= 0 )
+                ::close(imgfd);
+            return;
+        }
+        ::posix_fadvise(imgfd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        const IndexEntry & e = entries[i];
+        RestoreJob         job(&e);
+        std::string        dir;
+        size_t             indx = e.name.find_last_of('/');
+
+        if ( indx != std::string::npos )
+            dir = e.name.substr(0, indx + 1);
+
+        std::string member = ( e.offset > 0 ) ? dir + VOLGEN_BUNDLE_NAME : e.name;
+
+        if ( ! src.image ) {
+            job.source = src.path + "/" + member;
+            job.offset = e.offset;
+            job.size   = e.size;
+            if ( e.offset == 0 )
+                job.symlink = ReadTreeLink(job.source, _index.getRoot() + "/" + e.name, job.link);
+            jobs.push_back(job);
+            continue;
+        }
+
+        TarMemberMap::const_iterator mIter = members.find(member);
+
+        if ( mIter == members.end() ) {
+            std::cout << "VolRestore: '" << member << "' not found in " << src.path << std::endl;
+            errors++;
+            continue;
+        }
+
+        const TarMember & m = mIter->second;
+
+        job.source  = src.path;
+        job.offset  = m.offset + e.offset;
+        job.size    = ( e.offset > 0 ) ? e.size : m.size;
+        job.mode    = m.mode;
+        job.mtime   = m.mtime;
+        job.symlink = ( m.type == '2' );
+        job.link    = m.link;
+
+        if ( e.offset > 0 )
+            ReadMemberStat(imgfd, job.offset, job);
+
+        jobs.push_back(job);
+    }
+
+    std::sort(jobs.begin(), jobs.end());
+
+    std::string current;
+
+    for ( size_t i = 0; i < jobs.size(); ++i )
+    {
+        RestoreJob & job  = jobs[i];
+        std::string  dest = _outdir + "/" + job.entry->name;
+        WriteSlots * slot = this->getSlots(job.entry->name);
+        int          in   = imgfd;
+
+        if ( job.symlink )
+        {
+            ::unlink(dest.c_str());
+            if ( ::symlink(job.link.c_str(), dest.c_str()) < 0 ) {
+                std::cout << "VolRestore: Error in symlink '" << dest << "' : "
+                    << strerror(errno) << std::endl;
+                errors++;
+            } else {
+                files++;
+            }
+            continue;
+        }
+
+        if ( ! src.image )
+        {
+            /* bundled files share their source, kept open between them */
+            if ( fd < 0 || job.source != current )
+            {
+                struct stat sb;
+
+                if ( fd >= 0 )
+                    ::close(fd);
+
+                current = job.source;
+                fd      = ::open(current.c_str(), O_RDONLY | O_CLOEXEC);
+
+                if ( fd < 0 || ::fstat(fd, &sb) < 0 ) {
+                    std::cout << "VolRestore: Error opening '" << current << "' : "
+                        << strerror(errno) << std::endl;
+                    errors++;
+                    if ( fd >= 0 )
+                        ::close(fd);
+                    fd = -1;
+                    continue;
+                }
+
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                if ( job.entry->offset == 0 ) {
+                    job.size  = sb.st_size;
+                    job.mode  = sb.st_mode;
+                    job.mtime = sb.st_mtime;
+                }
+            }
+
+            if ( job.entry->offset > 0 )
+                ReadMemberStat(fd, job.offset, job);
+
+            in = fd;
+        }
+
+        if ( buf == NULL && ::posix_memalign((void**) &buf, VOLGEN_IOALIGN, VOLGEN_READ_BUFSZ) != 0 )
+            buf = NULL;
+
+        slot->acquire();
+
+        int  out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        bool ok  = ( out >= 0 && buf != NULL && CopyRange(in, job.offset, job.size, out, buf, cfr) );
+
+        if ( out >= 0 ) {
+            struct timespec times[2] = { { job.mtime, 0 }, { job.mtime, 0 } };
+            ::fchmod(out, job.mode & 07777);
+            ::futimens(out, times);
+            if ( ::close(out) < 0 )
+                ok = false;
+        }
+
+        slot->release();
+
+        if ( ! ok ) {
+            std::cout << "VolRestore: Error restoring '" << dest << "' : "
+                << strerror(errno) << std::endl;
+            errors++;
+            continue;
+        }
+
+        files++;
+        bytes += job.size;
+    }
+
+    if ( fd >= 0 )
+        ::close(fd);
+    if ( imgfd >= 0 )
+        ::close(imgfd);
+    ::free(buf);
+
+    _result.files  += files;
+    _result.bytes  += bytes;
+    _result.errors += errors;
+
+    std::ostringstream msg;
+    msg << "Restored " << _index.getVolumeName(vol) << " from " << src.path << " : "
+        << files << " file(s), " << (bytes / (1024 * 1024)) << " Mb"
+        << (( errors > 0 ) ? ", " + std::to_string(errors) + " error(s)" : "")
+        << (( cfr ) ? "" : " (copied by read)") << std::endl;
+    std::cout << msg.str();
+}
+
+}  // namespace
+
+// _VOLGEN_VOLRESTORE_CPP_
@@ -0,0 +1,783 @@
+/**
+  * @file   VolUpload.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLUPLOAD_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <strings.h>
+#include <time.h>
+#include <curl/curl.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "VolUpload.h"
+#include "VolManifest.h"
+
+
+namespace volgen {
+
+
+static std::once_flag  CurlInit;
+
+
+/**  Percent encodes a string as SigV4 requires, leaving '/' as is
+  *  when encoding a path.
+ **/
+static std::string
+UriEncode ( const std::string & str, bool path )
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string       r;
+
+    for ( size_t i = 0; i < str.size(); ++i )
+    {
+        unsigned char c = str[i];
+
+        if ( (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+             || c == '-' || c == '_' || c == '.' || c == '~' || (path && c == '/') ) {
+            r.push_back(c);
+        } else {
+            r.push_back('%');
+            r.push_back(hex[c >> 4]);
+            r.push_back(hex[c & 0x0f]);
+        }
+    }
+
+    return r;
+}
+
+
+static std::string
+Sha256Hex ( const char * buf, size_t len )
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int  mdlen = 0;
+
+    ::EVP_Digest(buf, len, md, &mdlen, ::EVP_sha256(), NULL);
+
+    return VolManifest::ToHex(md, mdlen);
+}
+
+
+static std::string
+HmacSha256 ( const std::string & key, const std::string & data )
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int  mdlen = 0;
+
+    ::HMAC(::EVP_sha256(), key.data(), key.size(),
+           (const unsigned char*) data.data(), data.size(), md, &mdlen);
+
+    return std::string((const char*) md, mdlen);
+}
+
+
+/**  Returns the text of each <tag> element found in 'xml', unescaped.
+  *  The responses read are flat enough that nesting need not be
+  *  handled beyond taking the first closing tag.
+ **/
+static void
+GetElements ( const std::string & xml, const std::string & tag,
+              std::vector<std::string> & values )
+{
+    std::string open  = "<" + tag + ">";
+    std::string close = "</" + tag + ">";
+    size_t      pos   = 0;
+
+    values.clear();
+
+    while ( (pos = xml.find(open, pos)) != std::string::npos )
+    {
+        size_t start = pos + open.size();
+        size_t end   = xml.find(close, start);
+
+        if ( end == std::string::npos )
+            break;
+
+        std::string val = xml.substr(start, end - start);
+        std::string r;
+
+        for ( size_t i = 0; i < val.size(); ++i ) {
+            if ( val[i] == '&' ) {
+                size_t semi = val.find(';', i);
+                std::string ent = val.substr(i, semi - i + 1);
+                if ( ent == "&quot;" )      r.push_back('"');
+                else if ( ent == "&amp;" )  r.push_back('&');
+                else if ( ent == "&lt;" )   r.push_back('<');
+                else if ( ent == "&gt;" )   r.push_back('>');
+                else if ( ent == "&apos;" ) r.push_back('\'');
+                else                        r.append(ent);
+                i = ( semi == std::string::npos ) ? val.size() : semi;
+            } else {
+                r.push_back(val[i]);
+            }
+        }
+
+        values.push_back(r);
+        pos = end + close.size();
+    }
+}
+
+
+static std::string
+GetElement ( const std::string & xml, const std::string & tag )
+{
+    std::vector<std::string> values;
+
+    GetElements(xml, tag, values);
+
+    return ( values.empty() ) ? std::string() : values.front();
+}
+
+
+static std::string
+GetEnv ( const char * name, const char * alt = NULL )
+{
+    const char * val = ::getenv(name);
+
+    if ( (val == NULL || *val == '\0') && alt != NULL )
+        val = ::getenv(alt);
+
+    return ( val != NULL ) ? std::string(val) : std::string();
+}
+
+// -------------------------------------------------------------- //
+
+struct VolUpload::Request {
+    std::string                         method;
+    std::string                         key;
+    std::map<std::string, std::string>  query;
+    std::vector<std::string>            headers;
+    const char *                        body;
+    size_t                              len;
+    size_t                              sent;
+
+    Request ( const std::string & meth, const std::string & okey )
+        : method(meth), key(okey), body(NULL), len(0), sent(0) {}
+};
+
+
+struct VolUpload::Response {
+    long         code;
+    std::string  body;
+    std::string  etag;
+    std::string  error;
+};
+
+
+static size_t
+ReadBody ( char * ptr, size_t size, size_t nmemb, void * data )
+{
+    VolUpload::Request * req = (VolUpload::Request*) data;
+    size_t               n   = std::min(size * nmemb, req->len - req->sent);
+
+    std::memcpy(ptr, req->body + req->sent, n);
+    req->sent += n;
+
+    return n;
+}
+
+
+static size_t
+WriteBody ( char * ptr, size_t size, size_t nmemb, void * data )
+{
+    ((std::string*) data)->append(ptr, size * nmemb);
+    return size * nmemb;
+}
+
+
+static size_t
+WriteHeader ( char * ptr, size_t size, size_t nmemb, void * data )
+{
+    VolUpload::Response * rsp = (VolUpload::Response*) data;
+    std::string           hdr(ptr, size * nmemb);
+
+    if ( hdr.size() > 5 && ::strncasecmp(hdr.c_str(), "etag:", 5) == 0 ) {
+        size_t start = hdr.find_first_not_of(" \t", 5);
+        size_t end   = hdr.find_last_not_of(" \t\r\n");
+        if ( start != std::string::npos && end >= start )
+            rsp->etag = hdr.substr(start, end - start + 1);
+    }
+
+    return size * nmemb;
+}
+
+// -------------------------------------------------------------- //
+
+VolUpload::VolUpload()
+    : _pathstyle(false)
+{
+    std::call_once(CurlInit, []{ ::curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+
+VolUpload::~VolUpload()
+{
+    for ( size_t i = 0; i < _handles.size(); ++i )
+        ::curl_easy_cleanup((CURL*) _handles[i]);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Parses the s3://bucket[/prefix] target and loads the endpoint and
+  *  credentials. Without AWS_ENDPOINT_URL the regional AWS endpoint is
+  *  used, addressing the bucket virtual host style.
+ **/
+bool
+VolUpload::init ( const std::string & target )
+{
+    std::string endpoint;
+    std::string path;
+    size_t      indx;
+
+    if ( ! VolUpload::IsTarget(target) ) {
+        std::cout << "VolUpload: Invalid target '" << target << "'" << std::endl;
+        return false;
+    }
+
+    path    = target.substr(std::strlen(VOLGEN_UPLOAD_SCHEME));
+    indx    = path.find('/');
+    _bucket = path.substr(0, indx);
+    _prefix = ( indx == std::string::npos ) ? std::string() : path.substr(indx + 1);
+
+    if ( ! _prefix.empty() && _prefix[_prefix.size() - 1] != '/' )
+        _prefix.append("/");
+
+    if ( _bucket.empty() ) {
+        std::cout << "VolUpload: No bucket given in '" << target << "'" << std::endl;
+        return false;
+    }
+
+    _region = GetEnv("AWS_REGION", "AWS_DEFAULT_REGION");
+    _access = GetEnv("AWS_ACCESS_KEY_ID");
+    _secret = GetEnv("AWS_SECRET_ACCESS_KEY");
+    _token  = GetEnv("AWS_SESSION_TOKEN");
+    endpoint = GetEnv("AWS_ENDPOINT_URL_S3", "AWS_ENDPOINT_URL");
+
+    if ( _region.empty() )
+        _region = VOLGEN_UPLOAD_REGION;
+
+    if ( _access.empty() || _secret.empty() ) {
+        std::cout << "VolUpload: AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY must be set for '"
+                  << target << "'" << std::endl;
+        return false;
+    }
+
+    if ( endpoint.empty() ) {
+        _scheme    = "https";
+        _host      = "s3." + _region + ".amazonaws.com";
+        _pathstyle = false;
+        return true;
+    }
+
+    indx = endpoint.find("://");
+
+    if ( indx == std::string::npos ) {
+        _scheme = "https";
+        _host   = endpoint;
+    } else {
+        _scheme = endpoint.substr(0, indx);
+        _host   = endpoint.substr(indx + 3);
+    }
+
+    if ( (indx = _host.find('/')) != std::string::npos )
+        _host.erase(indx);
+
+    if ( _host.empty() || (_scheme != "http" && _scheme != "https") ) {
+        std::cout << "VolUpload: Invalid endpoint '" << endpoint << "'" << std::endl;
+        return false;
+    }
+
+    _pathstyle = true;
+
+    return true;
+}
+
+
+std::string
+VolUpload::getUrl ( const std::string & key ) const
+{
+    return std::string(VOLGEN_UPLOAD_SCHEME).append(_bucket).append("/").append(key);
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolUpload::create ( const std::string & key, std::string & uploadid )
+{
+    Request  req("POST", key);
+    Response rsp;
+
+    req.query["uploads"] = "";
+    req.headers.push_back("Content-Type: application/x-tar");
+
+    if ( ! this->perform(req, rsp) )
+        return false;
+
+    uploadid = GetElement(rsp.body, "UploadId");
+
+    if ( uploadid.empty() ) {
+        std::cout << "VolUpload: No upload id for '" << this->getUrl(key) << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+/**  Finds the most recently started upload of the key still in
+  *  progress, returning false if there is none.
+ **/
+bool
+VolUpload::findUpload ( const std::string & key, std::string & uploadid )
+{
+    std::string keymark, idmark, started;
+
+    uploadid.clear();
+
+    for (;;)
+    {
+        Request  req("GET", "");
+        Response rsp;
+        std::vector<std::string> uploads;
+
+        req.query["uploads"] = "";
+        req.query["prefix"]  = key;
+
+        if ( ! keymark.empty() ) {
+            req.query["key-marker"]       = keymark;
+            req.query["upload-id-marker"] = idmark;
+        }
+
+        if ( ! this->perform(req, rsp) )
+            return false;
+
+        GetElements(rsp.body, "Upload", uploads);
+
+        for ( size_t i = 0; i < uploads.size(); ++i )
+        {
+            std::string init = GetElement(uploads[i], "Initiated");
+
+            if ( GetElement(uploads[i], "Key") != key || init < started )
+                continue;
+
+            uploadid = GetElement(uploads[i], "UploadId");
+            started  = init;
+        }
+
+        if ( GetElement(rsp.body, "IsTruncated") != "true" )
+            break;
+
+        keymark = GetElement(rsp.body, "NextKeyMarker");
+        idmark  = GetElement(rsp.body, "NextUploadIdMarker");
+
+        if ( keymark.empty() )
+            break;
+    }
+
+    return ( ! uploadid.empty() );
+}
+
+
+bool
+VolUpload::listParts ( const std::string & key, const std::string & uploadid,
+                       UploadPartList & parts )
+{
+    std::string marker;
+
+    parts.clear();
+
+    for (;;)
+    {
+        Request  req("GET", key);
+        Response rsp;
+        std::vector<std::string> elems;
+
+        req.query["uploadId"] = uploadid;
+
+        if ( ! marker.empty() )
+            req.query["part-number-marker"] = marker;
+
+        if ( ! this->perform(req, rsp) )
+            return false;
+
+        GetElements(rsp.body, "Part", elems);
+
+        for ( size_t i = 0; i < elems.size(); ++i )
+        {
+            std::string etag = GetElement(elems[i], "ETag");
+
+            etag.erase(std::remove(etag.begin(), etag.end(), '"'), etag.end());
+            parts.push_back(UploadPart(::atoi(GetElement(elems[i], "PartNumber").c_str()),
+                                       ::strtoull(GetElement(elems[i], "Size").c_str(), NULL, 10),
+                                       etag));
+        }
+
+        marker = GetElement(rsp.body, "NextPartNumberMarker");
+
+        if ( GetElement(rsp.body, "IsTruncated") != "true" || marker.empty() )
+            break;
+    }
+
+    return true;
+}
+
+
+/**  Uploads a part with its MD5 digest, for the service to verify,
+  *  returning the ETag assigned to it.
+ **/
+bool
+VolUpload::putPart ( const std::string & key, const std::string & uploadid,
+                     int partno, const char * buf, size_t len, std::string & etag )
+{
+    Request       req("PUT", key);
+    Response      rsp;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned char b64[64];
+    unsigned int  mdlen = 0;
+
+    ::EVP_Digest(buf, len, md, &mdlen, ::EVP_md5(), NULL);
+    ::EVP_EncodeBlock(b64, md, mdlen);
+
+    req.query["partNumber"] = std::to_string(partno);
+    req.query["uploadId"]   = uploadid;
+    req.headers.push_back(std::string("Content-MD5: ").append((const char*) b64));
+    req.body = buf;
+    req.len  = len;
+
+    if ( ! this->perform(req, rsp) )
+        return false;
+
+    etag = rsp.etag;
+    etag.erase(std::remove(etag.begin(), etag.end(), '"'), etag.end());
+
+    if ( etag.empty() ) {
+        std::cout << "VolUpload: No ETag for part " << partno << " of '"
+                  << this->getUrl(key) << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+VolUpload::complete ( const std::string & key, const std::string & uploadid,
+                      const UploadPartList & parts )
+{
+    Request     req("POST", key);
+    Response    rsp;
+    std::string xml = "<CompleteMultipartUpload>";
+
+    for ( size_t i = 0; i < parts.size(); ++i ) {
+        xml.append("<Part><PartNumber>").append(std::to_string(parts[i].number));
+        xml.append("</PartNumber><ETag>\"").append(parts[i].etag).append("\"</ETag></Part>");
+    }
+    xml.append("</CompleteMultipartUpload>");
+
+    req.query["uploadId"] = uploadid;
+    req.headers.push_back("Content-Type: application/xml");
+    req.body = xml.data();
+    req.len  = xml.size();
+
+    if ( ! this->perform(req, rsp) )
+        return false;
+
+    /* the service may fail the request after sending its 200 status */
+    if ( rsp.body.find("<Error>") != std::string::npos ) {
+        std::cout << "VolUpload: Error completing '" << this->getUrl(key) << "' : "
+                  << GetElement(rsp.body, "Code") << " " << GetElement(rsp.body, "Message")
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+VolUpload::abort ( const std::string & key, const std::string & uploadid )
+{
+    Request  req("DELETE", key);
+    Response rsp;
+
+    req.query["uploadId"] = uploadid;
+
+    return this->perform(req, rsp);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Sends a request, retrying with exponential backoff and jitter on
+  *  transport errors, throttling and server errors. Other errors are
+  *  reported and not retried.
+ **/
+bool
+VolUpload::perform ( Request & req, Response & rsp )
+{
+    static thread_local std::minstd_rand  rng(std::random_device{}());
+
+    for ( int attempt = 0; ; ++attempt )
+    {
+        rsp = Response();
+
+        bool sent = this->send(req, rsp);
+
+        if ( sent && rsp.code >= 200 && rsp.code < 300 )
+            return true;
+
+        bool retry = ( ! sent || rsp.code >= 500 || rsp.code == 429 || rsp.code == 408
+                       || GetElement(rsp.body, "Code") == "RequestTimeout" );
+
+        if ( ! retry || attempt >= VOLGEN_UPLOAD_RETRIES )
+        {
+            std::cout << "VolUpload: " << req.method << " '" << this->getUrl(req.key)
+                      << "' failed : ";
+            if ( ! sent )
+                std::cout << rsp.error;
+            else
+                std::cout << rsp.code << " " << GetElement(rsp.body, "Code") << " "
+                          << GetElement(rsp.body, "Message");
+            std::cout << std::endl;
+            return false;
+        }
+
+        long ms = std::min(100L << attempt, 10000L);
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms / 2 + rng() % (ms / 2 + 1)));
+    }
+
+    return false;
+}
+
+
+/**  Makes one attempt at a request */
+bool
+VolUpload::send ( Request & req, Response & rsp )
+{
+    std::string host = _host;
+    std::string path = "/";
+    std::string url;
+    char        errbuf[CURL_ERROR_SIZE];
+
+    if ( _pathstyle )
+        path.append(UriEncode(_bucket, false)).append("/");
+    else
+        host = _bucket + "." + _host;
+
+    path.append(UriEncode(req.key, true));
+
+    /* signed anew on each attempt, leaving the caller's headers as given */
+    std::vector<std::string> headers(req.headers);
+
+    this->sign(req, host, path, headers);
+
+    url = _scheme + "://" + host + path;
+
+    std::map<std::string, std::string>::const_iterator qIter;
+
+    for ( qIter = req.query.begin(); qIter != req.query.end(); ++qIter ) {
+        url.append(( qIter == req.query.begin() ) ? "?" : "&");
+        url.append(UriEncode(qIter->first, false));
+        if ( ! qIter->second.empty() )
+            url.append("=").append(UriEncode(qIter->second, false));
+    }
+
+    CURL *              curl = (CURL*) this->getHandle();
+    struct curl_slist * hdrs = NULL;
+
+    if ( curl == NULL ) {
+        rsp.error = "no curl handle";
+        return false;
+    }
+
+    for ( size_t i = 0; i < headers.size(); ++i )
+        hdrs = ::curl_slist_append(hdrs, headers[i].c_str());
+
+    /* no waiting on 100-continue before sending each part */
+    hdrs = ::curl_slist_append(hdrs, "Expect:");
+
+    req.sent  = 0;
+    errbuf[0] = '\0';
+
+    ::curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    ::curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdrs);
+    ::curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    ::curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+    ::curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+    ::curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteBody);
+    ::curl_easy_setopt(curl, CURLOPT_WRITEDATA, &rsp.body);
+    ::curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, WriteHeader);
+    ::curl_easy_setopt(curl, CURLOPT_HEADERDATA, &rsp);
+
+    if ( req.method == "PUT" ) {
+        ::curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+        ::curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadBody);
+        ::curl_easy_setopt(curl, CURLOPT_READDATA, &req);
+        ::curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, (curl_off_t) req.len);
+    } else if ( req.method == "POST" ) {
+        ::curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        ::curl_easy_setopt(curl, CURLOPT_POSTFIELDS, ( req.body ) ? req.body : "");
+        ::curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) req.len);
+    } else if ( req.method != "GET" ) {
+        ::curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, req.method.c_str());
+    }
+
+    CURLcode res = ::curl_easy_perform(curl);
+
+    if ( res == CURLE_OK )
+        ::curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &rsp.code);
+    else
+        rsp.error = ( errbuf[0] != '\0' ) ? errbuf : ::curl_easy_strerror(res);
+
+    ::curl_slist_free_all(hdrs);
+    this->putHandle(curl);
+
+    return ( res == CURLE_OK );
+}
+
+
+/**  Adds the SigV4 date, payload hash and authorization headers of a
+  *  request to 'headers'. Only the host and x-amz-* headers are signed.
+ **/
+void
+VolUpload::sign ( const Request & req, const std::string & host, const std::string & path,
+                  std::vector<std::string> & headers )
+{
+    char        amzdate[32];
+    time_t      now = ::time(NULL);
+    struct tm   tm;
+    std::string query, canon, scope, tosign, skey, hash;
+
+    ::gmtime_r(&now, &tm);
+    ::strftime(amzdate, sizeof(amzdate), "%Y%m%dT%H%M%SZ", &tm);
+
+    std::string date(amzdate, 8);
+
+    hash  = Sha256Hex(req.body, req.len);
+    scope = date + "/" + _region + "/s3/aws4_request";
+
+    std::map<std::string, std::string>::const_iterator qIter;
+
+    for ( qIter = req.query.begin(); qIter != req.query.end(); ++qIter ) {
+        if ( ! query.empty() )
+            query.append("&");
+        query.append(UriEncode(qIter->first, false)).append("=");
+        query.append(UriEncode(qIter->second, false));
+    }
+
+    std::string names = "host;x-amz-content-sha256;x-amz-date";
+    std::string hdrs  = "host:" + host + "\n"
+                        + "x-amz-content-sha256:" + hash + "\n"
+                        + "x-amz-date:" + amzdate + "\n";
+
+    if ( ! _token.empty() ) {
+        names.append(";x-amz-security-token");
+        hdrs.append("x-amz-security-token:").append(_token).append("\n");
+    }
+
+    canon  = req.method + "\n" + path + "\n" + query + "\n" + hdrs + "\n" + names + "\n" + hash;
+    tosign = std::string("AWS4-HMAC-SHA256\n") + amzdate + "\n" + scope + "\n"
+             + Sha256Hex(canon.data(), canon.size());
+
+    skey = HmacSha256("AWS4" + _secret, date);
+    skey = HmacSha256(skey, _region);
+    skey = HmacSha256(skey, "s3");
+    skey = HmacSha256(skey, "aws4_request");
+
+    std::string sig = HmacSha256(skey, tosign);
+
+    headers.push_back("Host: " + host);
+    headers.push_back("x-amz-content-sha256: " + hash);
+    headers.push_back(std::string("x-amz-date: ") + amzdate);
+
+    if ( ! _token.empty() )
+        headers.push_back("x-amz-security-token: " + _token);
+
+    headers.push_back("Authorization: AWS4-HMAC-SHA256 Credential=" + _access + "/" + scope
+                      + ", SignedHeaders=" + names + ", Signature="
+                      + VolManifest::ToHex((const unsigned char*) sig.data(), sig.size()));
+}
+
+// -------------------------------------------------------------- //
+
+/**  Returns a handle from the cache, keeping its open connection for
+  *  the next request made with it.
+ **/
+void*
+VolUpload::getHandle()
+{
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        if ( ! _handles.empty() ) {
+            CURL * curl = (CURL*) _handles.back();
+            _handles.pop_back();
+            ::curl_easy_reset(curl);
+            return curl;
+        }
+    }
+
+    return ::curl_easy_init();
+}
+
+
+void
+VolUpload::putHandle ( void * handle )
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _handles.push_back(handle);
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolUpload::IsTarget ( const std::string & target )
+{
+    return( target.compare(0, std::strlen(VOLGEN_UPLOAD_SCHEME), VOLGEN_UPLOAD_SCHEME) == 0 );
+}
+
+
+std::string
+VolUpload::GetMD5Hex ( const char * buf, size_t len )
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int  mdlen = 0;
+
+    ::EVP_Digest(buf, len, md, &mdlen, ::EVP_md5(), NULL);
+
+    return VolManifest::ToHex(md, mdlen);
+}
+
+}  // namespace
+
+// _VOLGEN_VOLUPLOAD_CPP_
@@ -0,0 +1,496 @@
+/**
+  * @file   VolVerify.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLVERIFY_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+}
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+#include <openssl/evp.h>
+
+#include "VolVerify.h"
+#include "VolArchive.h"
+#include "FileReader.h"
+#include "BufferPool.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace volgen {
+
+
+/**  A chunk of file data handed from the reader to a hasher. A null
+  *  buffer with 'last' set marks the end of the file.
+ **/
+struct VerifyChunk {
+    char *   buf;
+    size_t   len;
+    bool     last;
+};
+
+
+/**  Hash state for one file. Chunks of the same file are hashed in
+  *  order by at most one pool thread at a time.
+ **/
+struct VerifyJob {
+    std::mutex               lock;
+    std::deque<VerifyChunk>  chunks;
+    EVP_MD_CTX *             ctx;
+    std::string              digest;
+    bool                     scheduled;
+    bool                     failed;
+
+    VerifyJob() : ctx(NULL), scheduled(false), failed(false) {}
+};
+
+
+static void
+DrainJob ( VerifyJob * job, BufferPool * bufs )
+{
+    for (;;)
+    {
+        VerifyChunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(job->lock);
+            if ( job->chunks.empty() ) {
+                job->scheduled = false;
+                return;
+            }
+            chunk = job->chunks.front();
+            job->chunks.pop_front();
+        }
+
+        if ( chunk.buf != NULL ) {
+            EVP_DigestUpdate(job->ctx, chunk.buf, chunk.len);
+            bufs->put(chunk.buf);
+        }
+
+        if ( chunk.last ) {
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int  mdlen = 0;
+
+            EVP_DigestFinal_ex(job->ctx, md, &mdlen);
+            EVP_MD_CTX_free(job->ctx);
+            job->ctx    = NULL;
+            job->digest = VolManifest::ToHex(md, mdlen);
+        }
+    }
+}
+
+
+static void
+FeedJob ( VerifyJob * job, char * buf, size_t len, bool last,
+          ThreadPool & pool, BufferPool & bufs )
+{
+    VerifyChunk chunk = { buf, len, last };
+    bool        sched = false;
+
+    {
+        std::unique_lock<std::mutex> lock(job->lock);
+        job->chunks.push_back(chunk);
+        if ( ! job->scheduled )
+            job->scheduled = sched = true;
+    }
+
+    if ( sched ) {
+        BufferPool * bp = &bufs;
+        pool.push([job, bp] { DrainJob(job, bp); });
+    }
+}
+
+
+/**  Checks a symlink of the media against the recorded target. Links
+  *  staged to a meta dir volume point at the source link in turn, so
+  *  a chain of links is followed until the target matches.
+ **/
+static bool
+CheckLink ( const std::string & path, const std::string & target, int & err )
+{
+    std::string cur = path;
+    char        link[PATH_MAX];
+
+    for ( int hops = 0; hops < 8; ++hops )
+    {
+        ssize_t len = ::readlink(cur.c_str(), link, sizeof(link));
+
+        if ( len < 0 ) {
+            err = errno;
+            return false;
+        }
+
+        std::string dest(link, len);
+
+        if ( dest.compare(target) == 0 )
+            return true;
+        if ( dest.empty() || dest[0] != '/' )
+            break;
+
+        cur = dest;
+    }
+
+    err = 0;
+    return false;
+}
+
+// -------------------------------------------------------------- //
+
+VolVerify::VolVerify ( const VolManifest & manifest, const std::string & root )
+    : _manifest(manifest),
+      _root(root)
+{}
+
+
+/**  Verifies every manifest entry found under the media root,
+  *  reporting each missing or mismatched file. A root that is a
+  *  file is read as a tar image of the volume.
+ **/
+bool
+VolVerify::run ( size_t nthreads )
+{
+    struct stat sb;
+
+    if ( ::stat(_root.c_str(), &sb) == 0 && S_ISREG(sb.st_mode) )
+        return this->runImage(nthreads);
+
+    const ManifestEntryList & entries = _manifest.getEntries();
+
+    std::vector<size_t>     order;
+    std::vector<VerifyJob>  jobs(entries.size());
+
+    this->orderEntries(order);
+
+    {
+        BufferPool  bufs((nthreads * 2) + 2, VOLGEN_READ_BUFSZ, VOLGEN_IOALIGN);
+        ThreadPool  pool(nthreads);
+        FileReader  reader(0);
+
+        for ( size_t i = 0; i < order.size(); ++i )
+        {
+            const ManifestEntry & entry = entries[order[i]];
+            VerifyJob *           job   = &jobs[order[i]];
+            std::string           path  = _root + "/" + entry.name;
+            int                   err   = 0;
+
+            if ( entry.isLink() )
+            {
+                if ( CheckLink(path, entry.link, err) ) {
+                    _result.verified++;
+                } else if ( err == ENOENT ) {
+                    std::cout << "  MISSING   " << entry.name << std::endl;
+                    _result.missing++;
+                } else if ( err != 0 ) {
+                    std::cout << "  ERROR     " << entry.name << " : "
+                              << strerror(err) << std::endl;
+                    _result.errors++;
+                } else {
+                    std::cout << "  MISMATCH  " << entry.name << " : link to '"
+                              << entry.link << "' expected" << std::endl;
+                    _result.mismatch++;
+                }
+                continue;
+            }
+
+            if ( ! reader.open(path) ) {
+                if ( reader.getError() == ENOENT ) {
+                    std::cout << "  MISSING   " << entry.name << std::endl;
+                    _result.missing++;
+                } else {
+                    std::cout << "  ERROR     " << entry.name << " : "
+                              << strerror(reader.getError()) << std::endl;
+                    _result.errors++;
+                }
+                continue;
+            }
+
+            if ( (uint64_t) reader.getStat().st_size != entry.size ) {
+                std::cout << "  SIZE      " << entry.name << " : expected "
+                          << entry.size << ", found " << reader.getStat().st_size
+                          << std::endl;
+                _result.sizediff++;
+                reader.close();
+                continue;
+            }
+
+            if ( entry.digest.empty() ) {
+                _result.verified++;
+                reader.close();
+                continue;
+            }
+
+            job->ctx = EVP_MD_CTX_new();
+            EVP_DigestInit_ex(job->ctx, EVP_sha256(), NULL);
+
+            for (;;)
+            {
+                char *  buf = bufs.get();
+                ssize_t rd  = reader.read(buf, bufs.bufsize());
+
+                if ( rd <= 0 ) {
+                    bufs.put(buf);
+                    job->failed = ( rd < 0 );
+                    FeedJob(job, NULL, 0, true, pool, bufs);
+                    break;
+                }
+
+                FeedJob(job, buf, rd, false, pool, bufs);
+            }
+
+            _result.bytes += reader.getOffset();
+            reader.close();
+        }
+
+        pool.wait();
+    }
+
+    this->checkDigests(jobs);
+
+    return _result.ok();
+}
+
+
+/**  Verifies the manifest entries against the members of a tar image,
+  *  located by a scan of its headers. Member data is read in image
+  *  order, so the image is read in a single pass.
+ **/
+bool
+VolVerify::runImage ( size_t nthreads )
+{
+    const ManifestEntryList & entries = _manifest.getEntries();
+
+    std::vector<VerifyJob>  jobs(entries.size());
+    TarMemberMap            members;
+
+    int fd = ::open(_root.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( fd < 0 || ! VolArchive::ScanImage(fd, members) ) {
+        std::cout << "VolVerify: Error reading image '" << _root << "' : "
+                  << (( fd < 0 ) ? strerror(errno) : "not a tar image") << std::endl;
+        if ( fd >= 0 )
+            ::close(fd);
+        _result.errors++;
+        return false;
+    }
+
+    std::vector<std::pair<uint64_t, size_t> > order;
+
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        const ManifestEntry &        entry = entries[i];
+        TarMemberMap::const_iterator mIter = members.find(entry.name);
+
+        if ( mIter == members.end() ) {
+            std::cout << "  MISSING   " << entry.name << std::endl;
+            _result.missing++;
+            continue;
+        }
+
+        const TarMember & m = mIter->second;
+
+        if ( entry.isLink() || m.type == '2' )
+        {
+            if ( m.type == '2' && entry.isLink() && m.link.compare(entry.link) == 0 ) {
+                _result.verified++;
+            } else {
+                std::cout << "  MISMATCH  " << entry.name << " : link to '"
+                          << entry.link << "' expected" << std::endl;
+                _result.mismatch++;
+            }
+            continue;
+        }
+
+        if ( m.size != entry.size ) {
+            std::cout << "  SIZE      " << entry.name << " : expected "
+                      << entry.size << ", found " << m.size << std::endl;
+            _result.sizediff++;
+            continue;
+        }
+
+        if ( entry.digest.empty() ) {
+            _result.verified++;
+            continue;
+        }
+
+        order.push_back(std::make_pair(m.offset, i));
+    }
+
+    std::sort(order.begin(), order.end());
+
+    {
+        BufferPool  bufs((nthreads * 2) + 2, VOLGEN_READ_BUFSZ, VOLGEN_IOALIGN);
+        ThreadPool  pool(nthreads);
+
+        for ( size_t i = 0; i < order.size(); ++i )
+        {
+            VerifyJob * job  = &jobs[order[i].second];
+            uint64_t    off  = order[i].first;
+            uint64_t    left = entries[order[i].second].size;
+
+            job->ctx = EVP_MD_CTX_new();
+            EVP_DigestInit_ex(job->ctx, EVP_sha256(), NULL);
+
+            while ( left > 0 )
+            {
+                char *  buf = bufs.get();
+                size_t  len = ( left < bufs.bufsize() ) ? left : bufs.bufsize();
+                ssize_t rd;
+
+                while ( (rd = ::pread(fd, buf, len, off)) < 0 && errno == EINTR )
+                    ;
+
+                if ( rd <= 0 ) {
+                    bufs.put(buf);
+                    job->failed = true;
+                    break;
+                }
+
+                FeedJob(job, buf, rd, false, pool, bufs);
+                off  += rd;
+                left -= rd;
+                _result.bytes += rd;
+            }
+
+            FeedJob(job, NULL, 0, true, pool, bufs);
+        }
+
+        pool.wait();
+    }
+
+    ::close(fd);
+
+    this->checkDigests(jobs);
+
+    return _result.ok();
+}
+
+
+/**  Compares the digests of the hashed files with the manifest */
+void
+VolVerify::checkDigests ( const std::vector<VerifyJob> & jobs )
+{
+    const ManifestEntryList & entries = _manifest.getEntries();
+
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        if ( jobs[i].digest.empty() )
+            continue;
+
+        if ( jobs[i].failed ) {
+            std::cout << "  ERROR     " << entries[i].name << " : read error" << std::endl;
+            _result.errors++;
+        } else if ( jobs[i].digest.compare(entries[i].digest) != 0 ) {
+            std::cout << "  MISMATCH  " << entries[i].name << std::endl;
+            _result.mismatch++;
+        } else {
+            _result.verified++;
+        }
+    }
+}
+
+// -------------------------------------------------------------- //
+
+/**  Returns the physical offset of the first extent of a file */
+static bool
+FirstExtent ( const std::string & path, uint64_t & phys )
+{
+    uint64_t        fbuf[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(uint64_t)];
+    struct fiemap * fm = (struct fiemap*) fbuf;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if ( fd < 0 )
+        return false;
+
+    std::memset(fbuf, 0, sizeof(fbuf));
+    fm->fm_length       = FIEMAP_MAX_OFFSET;
+    fm->fm_extent_count = 1;
+
+    int r = ::ioctl(fd, FS_IOC_FIEMAP, fm);
+    int e = errno;
+    ::close(fd);
+
+    if ( r < 0 ) {
+        errno = e;
+        return false;
+    }
+
+    phys = ( fm->fm_mapped_extents > 0 ) ? fm->fm_extents[0].fe_physical : 0;
+
+    return true;
+}
+
+
+/**  Orders the manifest entries by their physical location on the
+  *  media, using the first extent reported by FIEMAP. Filesystems
+  *  without FIEMAP support (eg. iso9660) are ordered by inode number,
+  *  which for iso9660 is derived from the directory record offset.
+ **/
+void
+VolVerify::orderEntries ( std::vector<size_t> & order )
+{
+    const ManifestEntryList & entries = _manifest.getEntries();
+
+    std::vector<std::pair<uint64_t, size_t> > keys(entries.size());
+    bool usefie = true;
+
+    for ( size_t i = 0; i < entries.size() && usefie; ++i )
+    {
+        std::string path = _root + "/" + entries[i].name;
+        uint64_t    key  = 0;
+
+        if ( ! FirstExtent(path, key) && (errno == EOPNOTSUPP || errno == ENOTTY) )
+            usefie = false;
+
+        keys[i] = std::make_pair(key, i);
+    }
+
+    for ( size_t i = 0; i < entries.size() && ! usefie; ++i )
+    {
+        std::string path = _root + "/" + entries[i].name;
+        struct stat sb;
+
+        keys[i] = std::make_pair(0, i);
+        if ( ::lstat(path.c_str(), &sb) == 0 )
+            keys[i].first = sb.st_ino;
+    }
+
+    std::stable_sort(keys.begin(), keys.end());
+
+    order.clear();
+    order.reserve(keys.size());
+
+    for ( size_t i = 0; i < keys.size(); ++i )
+        order.push_back(keys[i].second);
+}
+
+}  // namespace
+
+// _VOLGEN_VOLVERIFY_CPP_
@@ -0,0 +1,455 @@
+/**
+  * @file   VolWatch.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLWATCH_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+}
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+
+#include "VolWatch.h"
+
+#include "util/StringUtils.h"
+using namespace tcanetpp;
+
+
+namespace volgen {
+
+
+VolWatch::VolWatch ( VolGen * vgen )
+    : _vgen(vgen),
+      _fd(-1),
+      _mntfd(-1),
+      _interval(VOLGEN_WATCH_INTERVAL_MS),
+      _fanotify(false),
+      _dirty(false),
+      _run(false)
+{}
+
+
+VolWatch::~VolWatch()
+{
+    if ( _fd >= 0 )
+        ::close(_fd);
+    if ( _mntfd >= 0 )
+        ::close(_mntfd);
+}
+
+// -------------------------------------------------------------- //
+
+/**  Initializes the notification interface, preferring a fanotify
+  *  filesystem mark and falling back to per-directory inotify watches.
+ **/
+bool
+VolWatch::init()
+{
+    if ( this->initFanotify() )
+        return true;
+
+    return this->initInotify();
+}
+
+
+bool
+VolWatch::initFanotify()
+{
+#ifdef FAN_REPORT_DFID_NAME
+    const std::string & path = _vgen->getPath();
+
+    _fd = ::fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK,
+                          O_RDONLY | O_LARGEFILE);
+    if ( _fd < 0 )
+        return false;
+
+    uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO
+                  | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_ONDIR;
+
+    if ( ::fanotify_mark(_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask,
+                         AT_FDCWD, path.c_str()) < 0 )
+    {
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    /* directory handles are resolved relative to this mount */
+    _mntfd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if ( _mntfd < 0 ) {
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _fanotify = true;
+    std::cout << "VolWatch: using fanotify filesystem mark on " << path << std::endl;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool
+VolWatch::initInotify()
+{
+    _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if ( _fd < 0 ) {
+        std::cout << "VolWatch::init() Error in inotify_init: "
+            << strerror(errno) << std::endl;
+        return false;
+    }
+
+    DirTree::Node * node = _vgen->getTree().find(_vgen->getPath());
+
+    if ( node == NULL ) {
+        std::cout << "VolWatch::init() Error locating path: "
+            << _vgen->getPath() << std::endl;
+        return false;
+    }
+
+    if ( ! this->addWatches(node) )
+        return false;
+
+    std::cout << "VolWatch: using inotify, " << _wds.size()
+              << " directories watched" << std::endl;
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolWatch::addWatches ( DirTree::Node * node )
+{
+    if ( ! this->addWatch("/" + node->getAbsoluteName()) )
+        return false;
+
+    DirTree::NodeMap & nodemap = node->getChildren();
+    DirTree::NodeMapIter nIter;
+
+    for ( nIter = nodemap.begin(); nIter != nodemap.end(); ++nIter ) {
+        if ( ! this->addWatches(nIter->second) )
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+VolWatch::addWatch ( const std::string & path )
+{
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                  | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+    int wd = ::inotify_add_watch(_fd, path.c_str(), mask);
+
+    if ( wd < 0 ) {
+        if ( errno == ENOSPC ) {
+            std::cout << "VolWatch::addWatch() Watch limit reached, increase "
+                << "fs.inotify.max_user_watches" << std::endl;
+            return false;
+        }
+        std::cout << "VolWatch::addWatch() Error for '" << path << "' : "
+            << strerror(errno) << std::endl;
+        return true;
+    }
+
+    _wds[wd]       = path;
+    _wpaths[path]  = wd;
+
+    return true;
+}
+
+
+void
+VolWatch::removeWatches ( const std::string & path )
+{
+    std::string prefix = path + "/";
+
+    WatchPathMap::iterator wIter = _wpaths.find(path);
+
+    if ( wIter != _wpaths.end() ) {
+        ::inotify_rm_watch(_fd, wIter->second);
+        _wds.erase(wIter->second);
+        _wpaths.erase(wIter);
+    }
+
+    /* siblings such as 'path-x' sort between 'path' and 'path/' */
+    wIter = _wpaths.lower_bound(prefix);
+
+    while ( wIter != _wpaths.end() && StringUtils::StartsWith(wIter->first, prefix) )
+    {
+        ::inotify_rm_watch(_fd, wIter->second);
+        _wds.erase(wIter->second);
+        _wpaths.erase(wIter++);
+    }
+}
+
+// -------------------------------------------------------------- //
+
+/**  Runs the event loop until stopped. The plan is rewritten once
+  *  events have been quiet for the configured interval, or at least
+  *  every ten intervals under a continuous stream of events.
+ **/
+void
+VolWatch::run ( const std::string & planfile )
+{
+    typedef std::chrono::steady_clock  Clock;
+
+    struct pollfd      pfd;
+    Clock::time_point  lastplan = Clock::now();
+    std::chrono::milliseconds maxwait(_interval * 10);
+
+    pfd.fd     = _fd;
+    pfd.events = POLLIN;
+    _run       = true;
+
+    while ( _run )
+    {
+        pfd.revents = 0;
+
+        int r = ::poll(&pfd, 1, _interval);
+
+        if ( r < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            std::cout << "VolWatch::run() Error in poll: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        if ( r > 0 ) {
+            bool res = (_fanotify) ? this->readFanotify() : this->readInotify();
+            if ( ! res )
+                break;
+        }
+
+        if ( _dirty && (r == 0 || (Clock::now() - lastplan) >= maxwait) )
+        {
+            _vgen->createVolumes();
+            _vgen->writePlan(planfile);
+            _dirty   = false;
+            lastplan = Clock::now();
+        }
+    }
+
+    return;
+}
+
+
+void
+VolWatch::stop()
+{
+    _run = false;
+}
+
+
+void
+VolWatch::setInterval ( int msecs )
+{
+    _interval = msecs;
+}
+
+
+bool
+VolWatch::isFanotify() const
+{
+    return _fanotify;
+}
+
+// -------------------------------------------------------------- //
+
+bool
+VolWatch::readFanotify()
+{
+#ifdef FAN_REPORT_DFID_NAME
+    char     buf[VOLGEN_WATCH_EVBUFSZ] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+    char     lpath[PATH_MAX];
+    ssize_t  len;
+
+    while ( (len = ::read(_fd, buf, sizeof(buf))) > 0 )
+    {
+        struct fanotify_event_metadata * md = (struct fanotify_event_metadata*) buf;
+
+        for ( ; FAN_EVENT_OK(md, len); md = FAN_EVENT_NEXT(md, len) )
+        {
+            if ( md->mask & FAN_Q_OVERFLOW ) {
+                this->rescan();
+                continue;
+            }
+
+            struct fanotify_event_info_fid * fid = (struct fanotify_event_info_fid*) (md + 1);
+
+            if ( fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME )
+                continue;
+
+            struct file_handle * fh   = (struct file_handle*) fid->handle;
+            const char *         name = (const char*) (fh->f_handle + fh->handle_bytes);
+
+            if ( ::strcmp(name, ".") == 0 )
+                continue;
+
+            int dfd = ::open_by_handle_at(_mntfd, fh, O_RDONLY | O_PATH);
+            if ( dfd < 0 )
+                continue;  // parent is already gone
+
+            std::string fdpath = "/proc/self/fd/" + StringUtils::ToString(dfd);
+            ssize_t     lsz    = ::readlink(fdpath.c_str(), lpath, sizeof(lpath) - 1);
+            ::close(dfd);
+
+            if ( lsz <= 0 )
+                continue;
+
+            lpath[lsz] = '\0';
+
+            std::string path = lpath;
+            path.append("/").append(name);
+
+            this->pathChanged(path, (md->mask & FAN_ONDIR),
+                              (md->mask & (FAN_DELETE | FAN_MOVED_FROM)));
+        }
+    }
+
+    if ( len < 0 && errno != EAGAIN ) {
+        std::cout << "VolWatch: Error reading fanotify events: " << strerror(errno) << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+
+bool
+VolWatch::readInotify()
+{
+    char     buf[VOLGEN_WATCH_EVBUFSZ] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t  len;
+
+    while ( (len = ::read(_fd, buf, sizeof(buf))) > 0 )
+    {
+        const struct inotify_event * ev;
+
+        for ( char * ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len )
+        {
+            ev = (const struct inotify_event*) ptr;
+
+            if ( ev->mask & IN_Q_OVERFLOW ) {
+                this->rescan();
+                continue;
+            }
+
+            WatchMap::iterator wIter = _wds.find(ev->wd);
+
+            if ( wIter == _wds.end() )
+                continue;
+
+            if ( ev->mask & IN_IGNORED ) {
+                _wpaths.erase(wIter->second);
+                _wds.erase(wIter);
+                continue;
+            }
+
+            if ( ev->len == 0 )
+                continue;
+
+            std::string path = wIter->second;
+            path.append("/").append(ev->name);
+
+            this->pathChanged(path, (ev->mask & IN_ISDIR),
+                              (ev->mask & (IN_DELETE | IN_MOVED_FROM)));
+        }
+    }
+
+    if ( len < 0 && errno != EAGAIN ) {
+        std::cout << "VolWatch: Error reading inotify events: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+/**  Applies a single change to the tree. */
+void
+VolWatch::pathChanged ( const std::string & path, bool isdir, bool removed )
+{
+    const std::string & root = _vgen->getPath();
+
+    if ( ! StringUtils::StartsWith(path, root + "/") )
+        return;
+    if ( _vgen->isExcluded(path) )
+        return;
+
+    if ( removed ) {
+        _vgen->removePath(path);
+        if ( isdir && ! _fanotify )
+            this->removeWatches(path);
+    } else if ( isdir ) {
+        _vgen->readPath(path);
+        if ( ! _fanotify ) {
+            DirTree::Node * node = _vgen->getTree().find(path);
+            if ( node != NULL )
+                this->addWatches(node);
+        }
+    } else {
+        _vgen->updateFile(path);
+    }
+
+    _dirty = true;
+}
+
+
+/**  Events were lost, so rebuild the tree from scratch */
+void
+VolWatch::rescan()
+{
+    std::cout << "VolWatch: event queue overflow, rescanning "
+              << _vgen->getPath() << std::endl;
+
+    if ( ! _fanotify )
+        this->removeWatches(_vgen->getPath());
+
+    _vgen->getTree().clear();
+    _vgen->read();
+
+    if ( ! _fanotify ) {
+        DirTree::Node * node = _vgen->getTree().find(_vgen->getPath());
+        if ( node != NULL )
+            this->addWatches(node);
+    }
+
+    _dirty = true;
+}
+
+}  // namespace
+
+// _VOLGEN_VOLWATCH_CPP_
@@ -0,0 +1,990 @@
+/**
+  * @file   VolWriter.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_VOLWRITER_CPP_
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "VolWriter.h"
+#include "VolArchive.h"
+#include "VolUpload.h"
+#include "FileReader.h"
+#include "BufferPool.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace volgen {
+
+
+/**  A buffer of archive data for the writer. The final chunk of each
+  *  volume has 'last' set and may have no buffer. A 'header' chunk is
+  *  written at the start of the image rather than appended, and a
+  *  'meta' chunk's buffer belongs to the target's meta pool.
+ **/
+struct WriteChunk {
+    char *   buf;
+    size_t   len;
+    size_t   vol;
+    bool     last;
+    bool     header;
+    bool     meta;
+};
+
+
+struct ChunkQueue {
+    std::mutex               lock;
+    std::condition_variable  cond;
+    std::deque<WriteChunk>   chunks;
+
+    void push ( const WriteChunk & chunk )
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->lock);
+            chunks.push_back(chunk);
+        }
+        cond.notify_one();
+    }
+
+    WriteChunk pop()
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+        cond.wait(lock, [this]{ return ! chunks.empty(); });
+
+        WriteChunk chunk = chunks.front();
+        chunks.pop_front();
+
+        return chunk;
+    }
+};
+
+
+/**  The ring and state of a single target. When encrypting, the reader
+  *  feeds 'plain' and the writer is fed by the encryption stage, with
+  *  the image header and index in buffers of their own so the stage
+  *  never waits on the ring. An object storage target has an 'upload'
+  *  client in place of a path on disk.
+ **/
+struct WriteTarget {
+    std::string                  path;
+    bool                         device;
+    VolUpload *                  upload;
+    std::vector<size_t>          vols;
+    std::vector<IndexEntryList>  files;
+    BufferPool                   bufs;
+    BufferPool                   meta;
+    ChunkQueue                   ready;
+    ChunkQueue                   plain;
+    const VolCrypt *             crypt;
+    std::atomic<bool>            failed;
+    std::atomic<size_t>          errors;
+    uint64_t                     bytes;
+
+    WriteTarget ( const std::string & tpath, bool isdev, size_t ring, const VolCrypt * vcrypt,
+                  VolUpload * vupload = NULL )
+        : path(tpath),
+          device(isdev),
+          upload(vupload),
+          bufs(ring, VOLGEN_WRITER_BUFSZ, VOLGEN_IOALIGN),
+          meta(( vcrypt ) ? 2 : 0, VOLGEN_WRITER_BUFSZ, VOLGEN_IOALIGN),
+          crypt(vcrypt),
+          failed(false),
+          errors(0),
+          bytes(0)
+    {}
+
+    ~WriteTarget()
+    {
+        if ( upload != NULL )
+            delete upload;
+    }
+
+    void push ( const WriteChunk & chunk )
+    {
+        if ( crypt != NULL )
+            plain.push(chunk);
+        else
+            ready.push(chunk);
+    }
+};
+
+
+/**  Builds the archive stream of a volume into ring buffers, handing
+  *  each to the writer as it fills.
+ **/
+struct ArchiveStream {
+    WriteTarget *     tgt;
+    size_t            vol;
+    char *            buf;
+    size_t            fill;
+    uint64_t          offset;
+    IndexEntryList *  files;
+
+    ArchiveStream ( WriteTarget * target, size_t volume, IndexEntryList * index = NULL )
+        : tgt(target),
+          vol(volume),
+          buf(NULL),
+          fill(0),
+          offset(0),
+          files(index)
+    {}
+
+    void append ( const char * data, size_t len )
+    {
+        while ( len > 0 )
+        {
+            if ( buf == NULL ) {
+                buf  = tgt->bufs.get();
+                fill = 0;
+            }
+
+            size_t n = std::min(len, tgt->bufs.bufsize() - fill);
+
+            if ( data != NULL ) {
+                std::memcpy(buf + fill, data, n);
+                data += n;
+            } else {
+                std::memset(buf + fill, 0, n);
+            }
+
+            fill   += n;
+            len    -= n;
+            offset += n;
+
+            if ( fill == tgt->bufs.bufsize() ) {
+                WriteChunk chunk = { buf, fill, vol, false, false, false };
+                tgt->push(chunk);
+                buf = NULL;
+            }
+        }
+    }
+
+    /* pads the stream so every write is aligned for O_DIRECT; the
+     * extra zero blocks follow the end of archive marker */
+    void finish()
+    {
+        this->append(NULL, VOLGEN_TAR_EOFSZ);
+
+        if ( buf != NULL && fill % VOLGEN_IOALIGN != 0 )
+            this->append(NULL, VOLGEN_IOALIGN - (fill % VOLGEN_IOALIGN));
+
+        WriteChunk chunk = { buf, fill, vol, true, false, false };
+
+        if ( buf == NULL )
+            chunk.len = 0;
+
+        tgt->push(chunk);
+        buf = NULL;
+    }
+};
+
+
+static bool
+AddMember ( ArchiveStream & strm, FileReader & reader, const ManifestEntry & entry )
+{
+    std::string hdr;
+    struct stat sb;
+
+    if ( ::lstat(entry.source.c_str(), &sb) == 0 && S_ISLNK(sb.st_mode) )
+    {
+        char   link[PATH_MAX];
+        ssize_t len = ::readlink(entry.source.c_str(), link, sizeof(link));
+
+        if ( len < 0 )
+            return false;
+
+        VolArchive::AddHeader(hdr, entry.name, 0, sb.st_mtime, 0777, '2',
+                              std::string(link, len));
+        strm.append(hdr.data(), hdr.length());
+
+        if ( strm.files != NULL ) {
+            strm.files->push_back(IndexEntry(entry.name, 0, 0, strm.offset));
+            strm.files->back().link.assign(link, len);
+        }
+        return true;
+    }
+
+    if ( ! reader.open(entry.source) )
+        return false;
+
+    const struct stat & rsb  = reader.getStat();
+    uint64_t            left = rsb.st_size;
+    const char *        data = NULL;
+    ssize_t             rd;
+
+    VolArchive::AddHeader(hdr, entry.name, rsb.st_size, rsb.st_mtime, rsb.st_mode);
+    strm.append(hdr.data(), hdr.length());
+
+    if ( strm.files != NULL )
+        strm.files->push_back(IndexEntry(entry.name, 0, rsb.st_size, strm.offset));
+
+    while ( left > 0 && (rd = reader.read(&data)) > 0 )
+    {
+        size_t len = ( (uint64_t) rd > left ) ? left : rd;
+        strm.append(data, len);
+        left -= len;
+    }
+
+    /* zero fill a file that shrank so the header stays correct */
+    strm.append(NULL, left + VolArchive::GetPadding(rsb.st_size));
+    reader.close();
+
+    return ( left == 0 );
+}
+
+
+/**  Reader side of a target, streaming each of its volumes in turn */
+static void
+ReadVolumes ( WriteTarget * tgt, const std::vector<VolManifest> * vols )
+{
+    FileReader reader(1024 * 1024);
+
+    for ( size_t i = 0; i < tgt->vols.size(); ++i )
+    {
+        const ManifestEntryList & entries = (*vols)[tgt->vols[i]].getEntries();
+        ArchiveStream             strm(tgt, tgt->vols[i], ( tgt->crypt ) ? &tgt->files[i] : NULL);
+
+        for ( size_t n = 0; n < entries.size() && ! tgt->failed; ++n )
+        {
+            if ( ! AddMember(strm, reader, entries[n]) ) {
+                std::cout << "VolWriter: Error reading '" << entries[n].source << "'" << std::endl;
+                tgt->errors++;
+            }
+        }
+
+        strm.finish();
+    }
+}
+
+
+/**  Seals the segments of a chunk in parallel, in place */
+static bool
+SealChunk ( WriteTarget * tgt, const CryptHeader & hdr, ThreadPool * pool,
+            char * buf, size_t len, uint64_t first, CryptTagList & tags )
+{
+    size_t            nsegs = (len + hdr.segsz - 1) / hdr.segsz;
+    std::latch        done(nsegs);
+    std::atomic<bool> ok(true);
+
+    tags.resize(first + nsegs);
+
+    for ( size_t s = 0; s < nsegs; ++s )
+    {
+        char *     seg  = buf + s * hdr.segsz;
+        size_t     slen = std::min((size_t) hdr.segsz, len - s * hdr.segsz);
+        CryptTag * tag  = &tags[first + s];
+
+        pool->push([tgt, &hdr, &done, &ok, seg, slen, tag, first, s] {
+            if ( ! tgt->crypt->seal(hdr, first + s, seg, slen, *tag) )
+                ok = false;
+            done.count_down();
+        });
+    }
+
+    done.wait();
+
+    return ok;
+}
+
+
+/**  Encryption stage of a target. Each volume's image starts with a
+  *  header block, followed by the sealed archive, then by the sealed
+  *  index; the completed header is then rewritten at the start. After
+  *  a failure chunks are still passed on, emptied, so nothing stalls.
+ **/
+static void
+EncryptVolumes ( WriteTarget * tgt, ThreadPool * pool )
+{
+    for ( size_t i = 0; i < tgt->vols.size(); ++i )
+    {
+        CryptHeader   hdr;
+        CryptTagList  tags;
+        std::string   index;
+        uint64_t      length = 0;
+        bool          ok     = tgt->crypt->initHeader(hdr);
+
+        WriteChunk head = { tgt->meta.get(), VOLGEN_CRYPT_HDRSZ, tgt->vols[i], false, false, true };
+        VolCrypt::PackHeader(hdr, head.buf);
+        tgt->ready.push(head);
+
+        for (;;)
+        {
+            WriteChunk chunk = tgt->plain.pop();
+            bool       last  = chunk.last;
+
+            if ( chunk.buf != NULL && chunk.len > 0 )
+            {
+                if ( ok )
+                    ok = SealChunk(tgt, hdr, pool, chunk.buf, chunk.len, length / hdr.segsz, tags);
+                if ( ! ok )
+                    chunk.len = 0;
+                length += chunk.len;
+            }
+
+            chunk.last = false;
+            tgt->ready.push(chunk);
+
+            if ( last )
+                break;
+        }
+
+        VolCrypt::PackIndex(index, length, tags, tgt->files[i]);
+        tgt->files[i].clear();
+
+        ok = ok && tgt->crypt->seal(hdr, VOLGEN_CRYPT_INDEXSEG, &index[0], index.size(), hdr.indextag);
+
+        if ( ! ok ) {
+            std::cout << "VolWriter: Error encrypting volume for '" << tgt->path << "'" << std::endl;
+            tgt->failed = true;
+            index.clear();
+        }
+
+        hdr.indexoff = VOLGEN_CRYPT_HDRSZ + length;
+        hdr.indexlen = index.size();
+
+        for ( size_t off = 0; off < index.size(); )
+        {
+            WriteChunk chunk = { tgt->meta.get(), 0, tgt->vols[i], false, false, true };
+            size_t     n     = std::min(index.size() - off, tgt->meta.bufsize());
+
+            std::memcpy(chunk.buf, index.data() + off, n);
+            off += n;
+
+            if ( n % VOLGEN_IOALIGN != 0 ) {
+                std::memset(chunk.buf + n, 0, VOLGEN_IOALIGN - (n % VOLGEN_IOALIGN));
+                n += VOLGEN_IOALIGN - (n % VOLGEN_IOALIGN);
+            }
+
+            chunk.len = n;
+            tgt->ready.push(chunk);
+        }
+
+        WriteChunk tail = { tgt->meta.get(), VOLGEN_CRYPT_HDRSZ, tgt->vols[i], true, true, true };
+
+        if ( ok )
+            VolCrypt::PackHeader(hdr, tail.buf);
+        else
+            tail.len = 0;
+
+        tgt->ready.push(tail);
+    }
+}
+
+
+static bool
+WriteFull ( int fd, const char * buf, size_t len, bool & direct )
+{
+    size_t off = 0;
+
+    while ( off < len )
+    {
+        ssize_t wr = ::write(fd, buf + off, len - off);
+
+        if ( wr < 0 ) {
+            if ( errno == EINTR )
+                continue;
+            if ( errno == EINVAL && direct ) {
+                int flags = ::fcntl(fd, F_GETFL);
+                ::fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+                direct = false;
+                continue;
+            }
+            return false;
+        }
+        off += wr;
+    }
+
+    return true;
+}
+
+
+/**  Writer side of a target, draining the ring to each volume's image.
+  *  The ring is drained even after an error so the reader never stalls.
+ **/
+static void
+WriteVolumes ( WriteTarget * tgt, const std::vector<VolManifest> * vols )
+{
+    for ( size_t i = 0; i < tgt->vols.size(); ++i )
+    {
+        const std::string & volname = (*vols)[tgt->vols[i]].getName();
+        std::string         image   = tgt->path;
+        bool                direct  = true;
+        uint64_t            bytes   = 0;
+        int                 flags   = O_WRONLY | O_CLOEXEC;
+        int                 fd;
+
+        if ( ! tgt->device ) {
+            image  = VolWriter::GetImageName(tgt->path, volname);
+            flags |= O_CREAT | O_TRUNC;
+            if ( tgt->crypt != NULL )
+                image.append(VOLGEN_CRYPT_EXT);
+        }
+
+        fd = ::open(image.c_str(), flags | O_DIRECT, 0644);
+
+        if ( fd < 0 && errno == EINVAL ) {
+            fd     = ::open(image.c_str(), flags, 0644);
+            direct = false;
+        }
+
+        if ( fd < 0 ) {
+            std::cout << "VolWriter: Error opening '" << image << "' : "
+                << strerror(errno) << std::endl;
+            tgt->failed = true;
+        }
+
+        for (;;)
+        {
+            WriteChunk chunk = tgt->ready.pop();
+
+            if ( chunk.buf != NULL ) {
+                bool wrote = true;
+
+                if ( fd >= 0 && chunk.header )
+                    wrote = ( chunk.len == 0 || ::pwrite(fd, chunk.buf, chunk.len, 0) == (ssize_t) chunk.len );
+                else if ( fd >= 0 )
+                    wrote = WriteFull(fd, chunk.buf, chunk.len, direct);
+
+                if ( ! wrote ) {
+                    std::cout << "VolWriter: Error writing '" << image << "' : "
+                        << strerror(errno) << std::endl;
+                    tgt->failed = true;
+                    ::close(fd);
+                    fd = -1;
+                }
+                if ( ! chunk.header )
+                    bytes += chunk.len;
+
+                if ( chunk.meta )
+                    tgt->meta.put(chunk.buf);
+                else
+                    tgt->bufs.put(chunk.buf);
+            }
+
+            if ( chunk.last )
+                break;
+        }
+
+        if ( fd < 0 )
+            continue;
+
+        if ( tgt->failed ) {
+            ::close(fd);
+            continue;
+        }
+
+        if ( ::fdatasync(fd) < 0 || ::close(fd) < 0 ) {
+            std::cout << "VolWriter: Error writing '" << image << "' : "
+                << strerror(errno) << std::endl;
+            tgt->failed = true;
+            continue;
+        }
+
+        tgt->bytes += bytes;
+
+        std::ostringstream msg;
+        msg << "Wrote " << volname << " to " << image << " ("
+            << (bytes / (1024 * 1024)) << " Mb"
+            << (( direct ) ? ", direct" : "") << ")" << std::endl;
+        std::cout << msg.str();
+    }
+}
+
+
+/**  The parts of a volume being uploaded. Each part is sent by the
+  *  pool from a buffer of its own, returned once the part is sent. A
+  *  part already held by the service from an earlier attempt at the
+  *  same upload is kept when its size and digest match.
+ **/
+struct PartUpload {
+    VolUpload *                 s3;
+    BufferPool *                bufs;
+    std::string                 key;
+    std::string                 uploadid;
+    std::map<int, UploadPart>   prior;
+    UploadPartList              parts;
+    std::mutex                  lock;
+    std::condition_variable     cond;
+    size_t                      pending;
+    size_t                      resumed;
+    std::atomic<bool>           failed;
+
+    PartUpload ( VolUpload * upload, BufferPool * pool, const std::string & okey )
+        : s3(upload),
+          bufs(pool),
+          key(okey),
+          pending(0),
+          resumed(0),
+          failed(false)
+    {}
+
+    void send ( ThreadPool & pool, int partno, char * buf, size_t len )
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->lock);
+            if ( parts.size() < (size_t) partno )
+                parts.resize(partno);
+            pending++;
+        }
+
+        pool.push([this, partno, buf, len] {
+            std::map<int, UploadPart>::const_iterator pIter = prior.find(partno);
+            UploadPart part(partno, len);
+            bool       reused = false;
+            bool       ok     = ! failed;
+
+            if ( ok && pIter != prior.end() && pIter->second.size == len
+                 && pIter->second.etag == VolUpload::GetMD5Hex(buf, len) )
+            {
+                part.etag = pIter->second.etag;
+                reused    = true;
+            }
+            else if ( ok )
+            {
+                ok = s3->putPart(key, uploadid, partno, buf, len, part.etag);
+            }
+
+            bufs->put(buf);
+
+            {
+                std::unique_lock<std::mutex> lock(this->lock);
+                parts[partno - 1] = part;
+                if ( ! ok )
+                    failed = true;
+                if ( reused )
+                    resumed++;
+                pending--;
+                /* under the lock, as the waiter may then release this */
+                cond.notify_all();
+            }
+        });
+    }
+
+    bool wait()
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+        cond.wait(lock, [this]{ return pending == 0; });
+        return ! failed;
+    }
+};
+
+
+/**  Returns the size of a volume's image from the current size of its
+  *  members, as written by ReadVolumes() and EncryptVolumes().
+ **/
+static uint64_t
+GetImageSize ( const VolManifest & vol, bool crypt )
+{
+    const ManifestEntryList & entries = vol.getEntries();
+    uint64_t    size  = VOLGEN_TAR_EOFSZ + VOLGEN_IOALIGN;
+    uint64_t    index = 24;
+    struct stat sb;
+
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        const ManifestEntry & entry = entries[i];
+
+        if ( ::lstat(entry.source.c_str(), &sb) < 0 )
+            continue;
+
+        if ( S_ISLNK(sb.st_mode) ) {
+            char        link[PATH_MAX];
+            ssize_t     len = ::readlink(entry.source.c_str(), link, sizeof(link));
+            std::string hdr;
+
+            if ( len < 0 )
+                continue;
+
+            VolArchive::AddHeader(hdr, entry.name, 0, sb.st_mtime, 0777, '2',
+                                  std::string(link, len));
+            size  += hdr.length();
+            index += len;
+        } else {
+            size  += VolArchive::GetEntrySize(entry.name, sb.st_size);
+        }
+
+        index += 24 + entry.name.length();
+    }
+
+    if ( crypt ) {
+        index += (size / VOLGEN_CRYPT_SEGMENT + 1) * VOLGEN_CRYPT_TAGLEN;
+        size  += VOLGEN_CRYPT_HDRSZ + index + VOLGEN_IOALIGN;
+    }
+
+    return size;
+}
+
+
+/**  Returns the part size for uploading an image of 'imagesz' in no
+  *  more than VOLGEN_UPLOAD_MAXPARTS parts, or 0 when even parts of
+  *  the largest size allowed are too few.
+ **/
+static size_t
+GetPartSize ( uint64_t imagesz )
+{
+    uint64_t partsz = (imagesz + VOLGEN_UPLOAD_MAXPARTS - 1) / VOLGEN_UPLOAD_MAXPARTS;
+
+    partsz = std::max(partsz, (uint64_t) VOLGEN_UPLOAD_PARTSZ);
+    partsz = (partsz + VOLGEN_IOALIGN - 1) / VOLGEN_IOALIGN * VOLGEN_IOALIGN;
+
+    return ( partsz > VOLGEN_UPLOAD_MAXPARTSZ ) ? 0 : partsz;
+}
+
+
+/**  Writer side of an object storage target. The ring is copied into
+  *  parts, uploaded 'conns' at a time over as many connections, so
+  *  memory is bounded by the ring and one part buffer per connection.
+  *  Parts are VOLGEN_UPLOAD_PARTSZ, or larger for a volume that would
+  *  need more than VOLGEN_UPLOAD_MAXPARTS of them. An unfinished
+  *  upload of the same image left by an earlier run is resumed rather
+  *  than started anew. When encrypting, the first part is held back
+  *  until the final header is written into it.
+ **/
+static void
+UploadVolumes ( WriteTarget * tgt, const std::vector<VolManifest> * vols, size_t conns )
+{
+    std::vector<size_t> partszs(tgt->vols.size());
+    size_t              maxpart = VOLGEN_UPLOAD_PARTSZ;
+
+    for ( size_t i = 0; i < tgt->vols.size(); ++i ) {
+        partszs[i] = GetPartSize(GetImageSize((*vols)[tgt->vols[i]], tgt->crypt != NULL));
+        maxpart    = std::max(maxpart, partszs[i]);
+    }
+
+    BufferPool parts(conns + (( tgt->crypt ) ? 2 : 1), maxpart, VOLGEN_IOALIGN);
+    ThreadPool pool(conns);
+
+    for ( size_t i = 0; i < tgt->vols.size(); ++i )
+    {
+        const std::string & volname = (*vols)[tgt->vols[i]].getName();
+        std::string         image   = volname + VOLGEN_IMAGE_EXT;
+        UploadPartList      prior;
+        char *              pbuf   = NULL;
+        char *              first  = NULL;
+        size_t              pfill  = 0;
+        size_t              partsz = partszs[i];
+        int                 partno = 1;
+        uint64_t            bytes  = 0;
+        bool                ok     = ! tgt->failed;
+
+        if ( tgt->crypt != NULL )
+            image.append(VOLGEN_CRYPT_EXT);
+
+        PartUpload up(tgt->upload, &parts, tgt->upload->getKey(image));
+
+        if ( ok && partsz == 0 ) {
+            std::cout << "VolWriter: " << volname << " is too large for "
+                << VOLGEN_UPLOAD_MAXPARTS << " parts of at most "
+                << (VOLGEN_UPLOAD_MAXPARTSZ / (1024 * 1024)) << " Mb" << std::endl;
+            ok = false;
+        }
+
+        if ( ok && tgt->upload->findUpload(up.key, up.uploadid)
+                && tgt->upload->listParts(up.key, up.uploadid, prior) )
+        {
+            for ( size_t p = 0; p < prior.size(); ++p )
+                up.prior[prior[p].number] = prior[p];
+
+            std::ostringstream msg;
+            msg << "Resuming upload of " << tgt->upload->getUrl(up.key) << " ("
+                << prior.size() << " parts sent before)" << std::endl;
+            std::cout << msg.str();
+        }
+        else if ( ok )
+        {
+            ok = tgt->upload->create(up.key, up.uploadid);
+        }
+
+        for (;;)
+        {
+            WriteChunk chunk = tgt->ready.pop();
+
+            if ( chunk.buf != NULL && ok && chunk.header )
+            {
+                if ( chunk.len > 0 )
+                    std::memcpy(( first != NULL ) ? first : pbuf, chunk.buf, chunk.len);
+            }
+            else if ( chunk.buf != NULL && ok )
+            {
+                for ( size_t off = 0; off < chunk.len; )
+                {
+                    if ( pbuf == NULL ) {
+                        pbuf  = parts.get();
+                        pfill = 0;
+                    }
+
+                    size_t n = std::min(chunk.len - off, partsz - pfill);
+
+                    std::memcpy(pbuf + pfill, chunk.buf + off, n);
+                    pfill += n;
+                    off   += n;
+
+                    if ( pfill < partsz )
+                        continue;
+
+                    if ( partno == 1 && tgt->crypt != NULL )
+                        first = pbuf;
+                    else
+                        up.send(pool, partno, pbuf, pfill);
+
+                    pbuf = NULL;
+                    partno++;
+                }
+
+                bytes += chunk.len;
+
+                if ( partno > VOLGEN_UPLOAD_MAXPARTS ) {
+                    std::cout << "VolWriter: " << tgt->upload->getUrl(up.key) << " exceeds "
+                        << VOLGEN_UPLOAD_MAXPARTS << " parts" << std::endl;
+                    ok = false;
+                }
+            }
+
+            if ( chunk.buf != NULL ) {
+                if ( chunk.meta )
+                    tgt->meta.put(chunk.buf);
+                else
+                    tgt->bufs.put(chunk.buf);
+            }
+
+            if ( chunk.last )
+                break;
+        }
+
+        ok = ok && ! tgt->failed;
+
+        if ( first != NULL ) {
+            if ( ok )
+                up.send(pool, 1, first, partsz);
+            else
+                parts.put(first);
+        }
+        if ( pbuf != NULL ) {
+            if ( ok )
+                up.send(pool, partno, pbuf, pfill);
+            else
+                parts.put(pbuf);
+        }
+
+        ok = up.wait() && ok;
+        ok = ok && tgt->upload->complete(up.key, up.uploadid, up.parts);
+
+        if ( ! ok ) {
+            if ( ! up.uploadid.empty() )
+                std::cout << "VolWriter: Upload of " << tgt->upload->getUrl(up.key)
+                    << " is incomplete, run again to resume it" << std::endl;
+            tgt->failed = true;
+            continue;
+        }
+
+        tgt->bytes += bytes;
+
+        std::ostringstream msg;
+        msg << "Uploaded " << volname << " to " << tgt->upload->getUrl(up.key) << " ("
+            << (bytes / (1024 * 1024)) << " Mb, " << up.parts.size() << " parts";
+        if ( up.resumed > 0 )
+            msg << ", " << up.resumed << " resumed";
+        msg << ")" << std::endl;
+        std::cout << msg.str();
+    }
+}
+
+// -------------------------------------------------------------- //
+
+VolWriter::VolWriter ( const std::vector<std::string> & targets, size_t ring )
+    : _targets(targets),
+      _crypt(NULL),
+      _conns(VOLGEN_UPLOAD_CONNS),
+      _ring(( ring < 2 ) ? 2 : ring),
+      _bytes(0)
+{}
+
+
+VolWriter::~VolWriter()
+{
+    for ( size_t i = 0; i < _outs.size(); ++i )
+        delete _outs[i];
+}
+
+// -------------------------------------------------------------- //
+
+/**  Queues a volume, given by its manifest, for writing. Only the
+  *  entry names and sources are used.
+ **/
+void
+VolWriter::add ( const VolManifest & manifest )
+{
+    _vols.push_back(manifest);
+}
+
+
+/**  Encrypts the images written with the given keyed VolCrypt */
+void
+VolWriter::setCrypt ( const VolCrypt * crypt )
+{
+    _crypt = crypt;
+}
+
+
+/**  Sets the number of parts uploaded at once to each object storage
+  *  target, each over a connection of its own.
+ **/
+void
+VolWriter::setConnections ( size_t conns )
+{
+    _conns = ( conns == 0 ) ? VOLGEN_UPLOAD_CONNS : conns;
+}
+
+
+/**  Writes all queued volumes, returning false on any error */
+bool
+VolWriter::run()
+{
+    if ( ! this->init() )
+        return false;
+
+    {
+        ThreadPool   pool(_outs.size() * (( _crypt ) ? 3 : 2));
+        ThreadPool * cpool = ( _crypt ) ? new ThreadPool() : NULL;
+
+        for ( size_t i = 0; i < _outs.size(); ++i )
+        {
+            WriteTarget * tgt = _outs[i];
+            const std::vector<VolManifest> * vols = &_vols;
+
+            size_t conns = _conns;
+
+            if ( tgt->upload != NULL )
+                pool.push([tgt, vols, conns] { UploadVolumes(tgt, vols, conns); });
+            else
+                pool.push([tgt, vols] { WriteVolumes(tgt, vols); });
+            if ( cpool != NULL )
+                pool.push([tgt, cpool] { EncryptVolumes(tgt, cpool); });
+            pool.push([tgt, vols] { ReadVolumes(tgt, vols); });
+        }
+
+        pool.wait();
+
+        if ( cpool != NULL )
+            delete cpool;
+    }
+
+    bool result = true;
+
+    for ( size_t i = 0; i < _outs.size(); ++i )
+    {
+        _bytes += _outs[i]->bytes;
+
+        if ( _outs[i]->failed || _outs[i]->errors > 0 ) {
+            std::cout << "VolWriter: Target '" << _outs[i]->path << "' failed with "
+                << _outs[i]->errors << " read error(s)" << std::endl;
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+
+/**  Validates the targets and assigns the volumes to them in turn */
+bool
+VolWriter::init()
+{
+    if ( _targets.empty() ) {
+        std::cout << "VolWriter: No targets given" << std::endl;
+        return false;
+    }
+
+    for ( size_t i = 0; i < _targets.size(); ++i )
+    {
+        struct stat sb;
+
+        if ( VolUpload::IsTarget(_targets[i]) )
+        {
+            VolUpload * upload = new VolUpload();
+
+            if ( ! upload->init(_targets[i]) ) {
+                delete upload;
+                return false;
+            }
+
+            _outs.push_back(new WriteTarget(_targets[i], false, _ring, _crypt, upload));
+            continue;
+        }
+
+        if ( ::stat(_targets[i].c_str(), &sb) < 0
+            || ! (S_ISDIR(sb.st_mode) || S_ISBLK(sb.st_mode)) )
+        {
+            std::cout << "VolWriter: Target '" << _targets[i]
+                << "' is not a directory or block device" << std::endl;
+            return false;
+        }
+
+        _outs.push_back(new WriteTarget(_targets[i], S_ISBLK(sb.st_mode), _ring, _crypt));
+    }
+
+    for ( size_t v = 0; v < _vols.size(); ++v )
+        _outs[v % _outs.size()]->vols.push_back(v);
+
+    for ( size_t i = 0; i < _outs.size(); ++i )
+        _outs[i]->files.resize(_outs[i]->vols.size());
+
+    for ( size_t i = 0; i < _outs.size(); ++i ) {
+        if ( _outs[i]->device && _outs[i]->vols.size() > 1 ) {
+            std::cout << "VolWriter: Device '" << _outs[i]->path << "' can hold only one of "
+                << _vols.size() << " volumes; give one device per volume" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------- //
+
+std::string
+VolWriter::GetImageName ( const std::string & target, const std::string & volname )
+{
+    std::string name = target;
+
+    if ( name.empty() || name[name.length() - 1] != '/' )
+        name.append("/");
+
+    return name.append(volname).append(VOLGEN_IMAGE_EXT);
+}
+
+}  // namespace
+
+// _VOLGEN_VOLWRITER_CPP_
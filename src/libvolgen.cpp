@@ -0,0 +1,355 @@
+/**
+  * @file   libvolgen.cpp
+  *
+  * Copyright (c) 2009-2025 Timothy C. Arland <tcarland@gmail.com>
+  *
+  * VolGen is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * VolGen is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with VolGen.  If not, see <https://www.gnu.org/licenses/>.
+  *
+ **/
+#define _VOLGEN_LIBVOLGEN_CPP_
+
+extern "C" {
+#include <sys/stat.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+}
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "libvolgen.h"
+#include "VolGen.h"
+using namespace volgen;
+
+
+static_assert(VOLGEN_TYPE_DIR == VOLGEN_ITEM_DIR, "item type mismatch");
+static_assert(VOLGEN_TYPE_FILE == VOLGEN_ITEM_FILE, "item type mismatch");
+static_assert(VOLGEN_TYPE_BUNDLE == VOLGEN_ITEM_BUNDLE, "item type mismatch");
+
+
+struct volgen_s {
+    VolGen  vgen;
+    bool    read;
+
+    explicit volgen_s ( const std::string & path )
+        : vgen(path), read(false)
+    {}
+};
+
+
+/**  The plan handle keeps the C views of the items alongside the
+  *  result, so the pointers handed out stay valid until it is freed.
+ **/
+struct volgen_plan_s {
+    PlanResult                                result;
+    std::vector< std::vector<volgen_item_t> > items;
+};
+
+
+static void
+SetVolume ( const PlanVolume & pvol, const std::vector<volgen_item_t> & items,
+            volgen_volume_t * vol )
+{
+    vol->name   = pvol.name.c_str();
+    vol->size   = pvol.size;
+    vol->nitems = items.size();
+    vol->items  = ( items.empty() ) ? NULL : &items[0];
+}
+
+// -------------------------------------------------------------- //
+
+extern "C" {
+
+
+int
+volgen_abi_version ( void )
+{
+    return VOLGEN_ABI_VERSION;
+}
+
+
+const char*
+volgen_version ( void )
+{
+    return VOLGEN_VERSION;
+}
+
+
+/**  Creates a handle for the tree at 'path'. The engine links volumes
+  *  to absolute paths, so the path is resolved as the volgen binary
+  *  resolves its own, and must exist.
+ **/
+volgen_t*
+volgen_create ( const char * path )
+{
+    char  rpath[PATH_MAX];
+
+    if ( path == NULL || ::realpath(path, rpath) == NULL )
+        return NULL;
+
+    try {
+        return new volgen_s(rpath);
+    } catch ( ... ) {
+        return NULL;
+    }
+}
+
+
+void
+volgen_destroy ( volgen_t * vg )
+{
+    delete vg;
+}
+
+
+int
+volgen_set_volume_size ( volgen_t * vg, size_t mb )
+{
+    if ( vg == NULL || mb == 0 )
+        return -1;
+
+    vg->vgen.setVolumeSize(mb);
+
+    return 0;
+}
+
+
+int
+volgen_set_strategy ( volgen_t * vg, const char * name )
+{
+    if ( vg == NULL || name == NULL )
+        return -1;
+
+    int strategy = VolGen::GetStrategy(name);
+
+    if ( strategy < 0 || strategy >= VOLGEN_PACK_MAX )
+        return -1;
+
+    vg->vgen.setStrategy(strategy);
+
+    return 0;
+}
+
+
+int
+volgen_set_bundle_size ( volgen_t * vg, size_t kb )
+{
+    if ( vg == NULL )
+        return -1;
+
+    vg->vgen.setBundleSize(kb);
+
+    return 0;
+}
+
+
+int
+volgen_set_link_mode ( volgen_t * vg, const char * name )
+{
+    if ( vg == NULL || name == NULL )
+        return -1;
+
+    int mode = VolGen::GetLinkMode(name);
+
+    if ( mode < 0 || mode >= VOLGEN_LINK_MAX )
+        return -1;
+
+    vg->vgen.setLinkMode(mode);
+
+    return 0;
+}
+
+
+int
+volgen_set_threads ( volgen_t * vg, size_t threads )
+{
+    if ( vg == NULL )
+        return -1;
+
+    vg->vgen.setThreads(threads);
+
+    return 0;
+}
+
+
+int
+volgen_set_exclude ( volgen_t * vg, const char * path )
+{
+    if ( vg == NULL || path == NULL )
+        return -1;
+
+    vg->vgen.setExcludePath(path);
+
+    return 0;
+}
+
+
+/**  Reads the tree, passing each directory and file to 'fn', if given,
+  *  from the calling thread as it is read. The tree may be read once.
+ **/
+int
+volgen_scan ( volgen_t * vg, volgen_entry_fn fn, void * arg )
+{
+    if ( vg == NULL || vg->read )
+        return -1;
+
+    try {
+        if ( fn != NULL ) {
+            vg->vgen.setTreeVisitor([fn, arg] ( const TreeEntry & e ) {
+                volgen_entry_t entry = { e.path.c_str(), e.size, e.disksize,
+                                         e.dir, e.symlink };
+                fn(&entry, arg);
+            });
+        }
+
+        vg->read = vg->vgen.read();
+
+        vg->vgen.setTreeVisitor(TreeVisitor());
+    } catch ( ... ) {
+        vg->vgen.setTreeVisitor(TreeVisitor());
+        return -1;
+    }
+
+    return ( vg->read ) ? 0 : -1;
+}
+
+
+/**  Plans the tree read by volgen_scan(), passing each volume to 'fn',
+  *  if given, as it is completed. The volume passed is only valid for
+  *  the duration of the call; the returned plan holds every volume
+  *  until volgen_plan_free().
+ **/
+volgen_plan_t*
+volgen_plan ( volgen_t * vg, volgen_volume_fn fn, void * arg )
+{
+    volgen_plan_t * plan = NULL;
+
+    if ( vg == NULL || ! vg->read )
+        return NULL;
+
+    try {
+        plan = new volgen_plan_s();
+
+        plan->result = vg->vgen.plan([plan, fn, arg] ( const PlanVolume & pvol ) {
+            std::vector<volgen_item_t> items(pvol.entries.size());
+
+            for ( size_t i = 0; i < pvol.entries.size(); ++i ) {
+                const PlanEntry & e = pvol.entries[i];
+                volgen_item_t     item = { e.name.c_str(), e.path.c_str(), e.size, e.type };
+                items[i] = item;
+            }
+
+            plan->items.push_back(std::move(items));
+
+            if ( fn != NULL ) {
+                volgen_volume_t vol;
+                SetVolume(pvol, plan->items.back(), &vol);
+                fn(&vol, arg);
+            }
+        });
+    } catch ( ... ) {
+        delete plan;
+        return NULL;
+    }
+
+    // each volume is moved into the result after its visit, so point
+    // the items at the result's own strings
+    for ( size_t v = 0; v < plan->items.size(); ++v )
+    {
+        const PlanVolume & pvol = plan->result.getVolumes()[v];
+
+        for ( size_t i = 0; i < pvol.entries.size(); ++i ) {
+            plan->items[v][i].name = pvol.entries[i].name.c_str();
+            plan->items[v][i].path = pvol.entries[i].path.c_str();
+        }
+    }
+
+    return plan;
+}
+
+
+size_t
+volgen_plan_count ( const volgen_plan_t * plan )
+{
+    if ( plan == NULL )
+        return 0;
+
+    return plan->result.size();
+}
+
+
+int
+volgen_plan_volume ( const volgen_plan_t * plan, size_t indx, volgen_volume_t * vol )
+{
+    if ( plan == NULL || vol == NULL || indx >= plan->items.size() )
+        return -1;
+
+    SetVolume(plan->result.getVolumes()[indx], plan->items[indx], vol);
+
+    return 0;
+}
+
+
+size_t
+volgen_plan_skipped ( const volgen_plan_t * plan )
+{
+    if ( plan == NULL )
+        return 0;
+
+    return plan->result.getSkipped().size();
+}
+
+
+void
+volgen_plan_free ( volgen_plan_t * plan )
+{
+    delete plan;
+}
+
+
+/**  Generates the volumes of the last plan under 'voldir', creating it
+  *  if needed, along with the index and manifests when flagged.
+ **/
+int
+volgen_generate ( volgen_t * vg, const char * voldir, int flags )
+{
+    if ( vg == NULL || voldir == NULL || ! vg->read )
+        return -1;
+
+    if ( ::mkdir(voldir, S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 && errno != EEXIST ) {
+        std::cout << "volgen: Error creating volgen archive dir '" << voldir << "' : "
+            << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    try {
+        if ( ! vg->vgen.generateVolumes(voldir) )
+            return -1;
+        if ( (flags & VOLGEN_GEN_INDEX) && ! vg->vgen.generateIndex(voldir) )
+            return -1;
+        if ( (flags & VOLGEN_GEN_MANIFEST) && ! vg->vgen.generateManifests(voldir) )
+            return -1;
+    } catch ( ... ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+}  // extern "C"
+
+// _VOLGEN_LIBVOLGEN_CPP_
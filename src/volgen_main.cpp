@@ -25,9 +25,21 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <getopt.h>
+#include <csignal>
 
 #include "VolGen.h"
+#include "VolWatch.h"
+#include "VolVerify.h"
+#include "VolParity.h"
+#include "VolIndex.h"
+#include "VolCheckpoint.h"
+#include "VolCrypt.h"
+#include "VolUpload.h"
+#include "VolRestore.h"
+#include "OutputWriter.h"
+#include "ThreadPool.hpp"
 using namespace volgen;
 
 #include "util/FileUtils.h"
@@ -37,19 +49,301 @@ using namespace tcanetpp;
 
 void usage()
 {
-    std::cout << "Usage: volgen  [-a:dDhLs:V]... <directory>" << std::endl
+    std::cout << "Usage: volgen  [-a:b:c:CdDF:hI:k:l:Lmo:pP:s:S:t:T:Vv:w:WX:z:]... <directory>" << std::endl
+        << "       volgen  --key <file> --decrypt <image> [file]..." << std::endl
+        << "       volgen  [-a:t:] --verify <mountpoint|image> <volume>" << std::endl
+        << "       volgen  [-a:t:] --reconstruct <outdir> --media <dir> <volume>" << std::endl
+        << "       volgen  [-a:D] --restore-plan <path|glob|->..." << std::endl
+        << "       volgen  [-a:n:t:] --restore <outdir> --media <dir|image,...> [path|glob|-]..." << std::endl
         << "  -a | --archive <dir> : Set volgen meta directory; default is " << VOLGEN_ARCHIVEDIR << "." << std::endl
+        << "  -b | --bundle  <kb>  : Bundle files smaller than <kb> into one archive per directory." << std::endl
+        << "  -c | --connections <n> : Parts uploaded at once to each s3:// image target (default "
+        << VOLGEN_UPLOAD_CONNS << ")." << std::endl
+        << "  -C | --resume        : Resume an interrupted scan from the checkpoint in the archive" << std::endl
+        << "                         dir. A scan is checkpointed whenever volumes are generated." << std::endl
         << "  -d | --debug         : Enable debug output and file statistics." << std::endl
+        << "  -E | --decrypt <image> : Extract the given files, or all, from an encrypted image" << std::endl
+        << "                         into the current directory, decrypting only their segments." << std::endl
+        << "  -F | --format <fmt>  : Write the tree and plan as 'json', 'ndjson' or 'csv'. Unless" << std::endl
+        << "                         --output is given this is written to stdout and implies -L." << std::endl
         << "  -h | --help          : Display usage info and exit." << std::endl
         << "  -D | --detail        : Detailed volume layout. Default is a brief list." << std::endl
+        << "  -I | --image <target,...> : Also write each volume as a tar image, to the given" << std::endl
+        << "                         directories, block devices or s3://bucket[/prefix] object" << std::endl
+        << "                         storage (see AWS_ENDPOINT_URL) in turn, all at once." << std::endl
+        << "  -k | --key <file>    : Encrypt --image output (or --decrypt) with the 256 bit key in" << std::endl
+        << "                         <file>, as 32 bytes or 64 hex digits." << std::endl
+        << "  -l | --link <mode>   : Fill volumes by 'symlink' (default), 'hardlink' or 'reflink'," << std::endl
+        << "                         falling back to a hard link, then a symlink, per file." << std::endl
         << "  -L | --list          : List volume layout only, do not generate metalinks." << std::endl
+        << "  -m | --manifest      : Generate a checksum manifest for each volume." << std::endl
+        << "  -M | --media <dir>   : Directory holding the mounted volumes as <dir>/Volume_NN. With" << std::endl
+        << "                         --restore a list of volumes, images, or directories of either." << std::endl
+        << "  -n | --writers <n>   : Files written at once to each --restore device (default "
+        << VOLGEN_RESTORE_WRITERS << ")." << std::endl
+        << "  -o | --output <file> : Output file for --format." << std::endl
+        << "  -p | --profile       : Profile the scan, reporting call latencies and the directories" << std::endl
+        << "                         taking the most time (see --top)." << std::endl
+        << "  -P | --parity <n:k>  : Generate k parity volumes per n data volumes (implies -m)." << std::endl
+        << "  -r | --reconstruct <dir> : Reconstruct a lost volume from parity into <dir>." << std::endl
+        << "  -R | --restore-plan  : List the volumes holding the given paths, '-' reads stdin." << std::endl
         << "  -s | --size  <mb>    : Set volume size in Mb (default is " << VOLGEN_VOLUME_MB << ")." << std::endl
+        << "  -S | --strategy <s>  : Packing strategy, 'next' (default), 'ffd' or 'local'." << std::endl
+        << "  -t | --threads <n>   : Number of worker threads (default is one per core)." << std::endl
+        << "  -T | --top <n>       : Report only the n largest directories of the tree." << std::endl
         << "  -V | --version       : Display version info and exit." << std::endl
+        << "  -v | --verify <path> : Verify mounted media, or a tar image, against the volume manifest." << std::endl
+        << "  -w | --what-if <mb,...> : Compare plans for each size (and each -S strategy) and exit." << std::endl
+        << "  -W | --watch         : Keep the tree live and rewrite the plan file on change." << std::endl
+        << "  -x | --restore <dir> : Restore the given paths, or all, into <dir> from the --media," << std::endl
+        << "                         one volume per thread." << std::endl
+        << "  -X | --max-depth <d> : Report directories at most d levels below the target." << std::endl
+        << "  -z | --estimate <pct> : Plan by sampled compressed size plus a margin of pct percent." << std::endl
         << std::endl;
     exit(0);
 }
 
 
+static VolWatch * watcher = NULL;
+
+void sigHandler ( int )
+{
+    if ( watcher != NULL )
+        watcher->stop();
+}
+
+
+/**  Resolves a meta dir path relative to the current directory */
+std::string getArchivePath ( const std::string & curdir, const std::string & voldir )
+{
+    if ( StringUtils::StartsWith(voldir, "/") )
+        return voldir;
+
+    std::string path = curdir;
+
+    if ( ! StringUtils::EndsWith(path, "/") )
+        path.append("/");
+    path.append(voldir);
+
+    return path;
+}
+
+
+int verifyVolume ( const std::string & voldir, const std::string & media,
+                   const std::string & volname, size_t nthreads )
+{
+    std::string root = media;
+    VolManifest manifest;
+
+    if ( ! FileUtils::IsDirectory(media) && ! FileUtils::IsReadable(media) ) {
+        std::cout << "volgen: Verify target '" << media << "' is not a directory "
+            << "or a readable image." << std::endl;
+        return -1;
+    }
+
+    if ( FileUtils::IsDirectory(media + "/" + volname) )
+        root = media + "/" + volname;
+    else if ( FileUtils::IsDirectory(media) && FileUtils::IsReadable(media + "/" + volname + ".tar") )
+        root = media + "/" + volname + ".tar";
+
+    if ( ! manifest.read(VolManifest::GetManifestName(voldir, volname)) )
+        return -1;
+
+    std::cout << "volgen: Verifying " << volname << " (" << manifest.getEntries().size()
+              << " files) at " << root << std::endl;
+
+    VolVerify verify(manifest, root);
+
+    bool ok = verify.run(nthreads);
+    const VerifyResult & res = verify.getResult();
+
+    std::cout << volname << " : " << res.verified << " verified, "
+              << res.missing  << " missing, "  << res.sizediff << " size, "
+              << res.mismatch << " mismatch, " << res.errors   << " error(s) : "
+              << (res.bytes / (1024 * 1024)) << " Mb read" << std::endl;
+
+    return ( ok ) ? 0 : 1;
+}
+
+
+int reconstructVolume ( const std::string & voldir, const std::string & media,
+                        const std::string & outdir, const std::string & volname,
+                        size_t nthreads )
+{
+    if ( media.empty() ) {
+        std::cout << "volgen: --reconstruct requires --media <dir>" << std::endl;
+        return -1;
+    }
+
+    VolParity parity(voldir, 0, 0);
+
+    return ( parity.reconstruct(volname, media, outdir, nthreads) ) ? 0 : 1;
+}
+
+
+/**  Normalizes a restore query to a path relative to the index root */
+std::string getRestorePath ( const std::string & root, const std::string & query )
+{
+    std::string path = query;
+
+    if ( StringUtils::StartsWith(path, root + "/") )
+        path = path.substr(root.length() + 1);
+    while ( StringUtils::StartsWith(path, "./") )
+        path = path.substr(2);
+    while ( StringUtils::StartsWith(path, "/") )
+        path = path.substr(1);
+    while ( path.length() > 1 && StringUtils::EndsWith(path, "/") )
+        path.erase(path.length() - 1);
+
+    return path;
+}
+
+
+int restorePlan ( const std::string & voldir, const std::vector<std::string> & queries,
+                  bool show )
+{
+    typedef std::map<uint32_t, IndexEntryList>  VolumeMatches;
+
+    VolIndex       index;
+    VolumeMatches  vols;
+    IndexEntryList matches;
+    uint64_t       total = 0;
+    size_t         nomatch = 0;
+
+    if ( ! index.open(voldir + "/" + VOLGEN_INDEXFILE) )
+        return -1;
+
+    for ( size_t i = 0; i < queries.size(); ++i )
+    {
+        std::string path = getRestorePath(index.getRoot(), queries[i]);
+
+        if ( path.empty() || index.match(path, matches) == 0 ) {
+            std::cout << "volgen: No match for '" << queries[i] << "'" << std::endl;
+            nomatch++;
+        }
+    }
+
+    for ( size_t i = 0; i < matches.size(); ++i )
+        vols[matches[i].volume].push_back(matches[i]);
+
+    VolumeMatches::iterator vIter;
+    for ( vIter = vols.begin(); vIter != vols.end(); ++vIter )
+    {
+        uint64_t bytes = 0;
+        for ( size_t i = 0; i < vIter->second.size(); ++i )
+            bytes += vIter->second[i].size;
+        total += bytes;
+
+        std::cout << index.getVolumeName(vIter->first) << " : " << vIter->second.size()
+                  << " file(s) : " << (bytes / (1024 * 1024)) << " Mb" << std::endl;
+
+        if ( show ) {
+            for ( size_t i = 0; i < vIter->second.size(); ++i ) {
+                const IndexEntry & e = vIter->second[i];
+                std::cout << "   " << e.name;
+                if ( e.offset > 0 )
+                    std::cout << " (bundle @" << e.offset << ")";
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    std::cout << "volgen: Restore requires " << vols.size() << " of "
+              << index.getVolumeCount() << " volume(s), " << matches.size()
+              << " file(s), " << (total / (1024 * 1024)) << " Mb" << std::endl;
+
+    return ( nomatch > 0 ) ? 1 : 0;
+}
+
+
+int restoreFiles ( const std::string & voldir, const std::string & outdir,
+                   const std::vector<std::string> & media,
+                   const std::vector<std::string> & queries,
+                   size_t nthreads, size_t writers )
+{
+    VolIndex index;
+    size_t   nomatch = 0;
+
+    if ( media.empty() ) {
+        std::cout << "volgen: --restore requires --media <dir|image,...>" << std::endl;
+        return -1;
+    }
+
+    if ( ! index.open(voldir + "/" + VOLGEN_INDEXFILE) )
+        return -1;
+
+    VolRestore restore(index, outdir);
+
+    for ( size_t i = 0; i < media.size(); ++i )
+        restore.addMedia(media[i]);
+
+    if ( queries.empty() )
+        restore.select("");
+
+    for ( size_t i = 0; i < queries.size(); ++i )
+    {
+        std::string path = getRestorePath(index.getRoot(), queries[i]);
+
+        if ( path.empty() || restore.select(path) == 0 ) {
+            std::cout << "volgen: No match for '" << queries[i] << "'" << std::endl;
+            nomatch++;
+        }
+    }
+
+    struct timespec start, end;
+    ::clock_gettime(CLOCK_MONOTONIC, &start);
+
+    bool ok = restore.run(nthreads, writers);
+
+    ::clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const RestoreResult & res = restore.getResult();
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double mb   = res.bytes / (1024.0 * 1024.0);
+
+    std::cout << "volgen: Restored " << res.files << " file(s), " << (uint64_t) mb
+              << " Mb in " << secs << "s (" << (uint64_t) ((secs > 0) ? mb / secs : 0)
+              << " Mb/s) : " << res.errors << " error(s), " << res.missing
+              << " on missing volumes" << std::endl;
+
+    return ( ok && nomatch == 0 ) ? 0 : 1;
+}
+
+
+/**  Parses a comma separated list of volume sizes */
+bool parseSizes ( const std::string & str, std::vector<size_t> & sizes )
+{
+    std::vector<std::string> fields;
+    StringUtils::split(str, ',', std::back_inserter(fields));
+
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        long sz = ::atol(fields[i].c_str());
+        if ( sz <= 0 )
+            return false;
+        sizes.push_back(sz);
+    }
+
+    return ( ! sizes.empty() );
+}
+
+
+/**  Parses a comma separated list of packing strategies */
+bool parseStrategies ( const std::string & str, std::vector<int> & strategies )
+{
+    std::vector<std::string> fields;
+    StringUtils::split(str, ',', std::back_inserter(fields));
+
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        int strategy = VolGen::GetStrategy(fields[i]);
+        if ( strategy < 0 )
+            return false;
+        strategies.push_back(strategy);
+    }
+
+    return ( ! strategies.empty() );
+}
+
+
 void version()
 {
     std::cout << "volgen " << VOLGEN_VERSION << std::endl
@@ -63,27 +357,90 @@ int main ( int argc, char **argv )
     std::string  curdir, target, voldir;
     char         optChar;
     char *       dirstr = NULL;
+    char *       vfystr = NULL;
+    char *       rcnstr = NULL;
+    char *       medstr = NULL;
+    char *       outstr = NULL;
+    char *       keystr = NULL;
+    char *       decstr = NULL;
+    char *       rststr = NULL;
+    int          format = VOLGEN_FORMAT_TEXT;
+    bool         quiet  = false;
+    int          ndata  = 0;
+    int          nparity = 0;
     long         volsz  = VOLGEN_VOLUME_MB;
     bool         debug  = false;
     bool         dogen  = true;
     bool         show   = false;
+    bool         watch  = false;
+    bool         mfest  = false;
+    bool         rplan  = false;
+    bool         resume = false;
+    bool         prof   = false;
+
+    std::vector<size_t>  whatif;
+    std::vector<int>     strategies;
+    std::vector<std::string>  images;
+    long         nthrds = 0;
+    long         bundle = 0;
+    long         conns  = 0;
+    long         writers = VOLGEN_RESTORE_WRITERS;
+    long         topn   = 0;
+    long         mdepth = -1;
+    long         margin = -1;
+    int          lmode  = VOLGEN_LINK_SYMLINK;
 
     static struct option l_opts[] = { {"archive", required_argument, 0, 'a'},
+                                      {"bundle",  required_argument, 0, 'b'},
+                                      {"connections", required_argument, 0, 'c'},
+                                      {"resume",  no_argument, 0, 'C'},
                                       {"debug",   no_argument, 0, 'd'},
                                       {"help",    no_argument, 0, 'h'},
                                       {"detail",  no_argument, 0, 'D'}, 
+                                      {"decrypt", required_argument, 0, 'E'},
+                                      {"format",  required_argument, 0, 'F'},
+                                      {"image",   required_argument, 0, 'I'},
+                                      {"key",     required_argument, 0, 'k'},
+                                      {"link",    required_argument, 0, 'l'},
                                       {"list",    no_argument, 0, 'L'}, 
+                                      {"manifest", no_argument, 0, 'm'},
+                                      {"media",   required_argument, 0, 'M'},
+                                      {"writers", required_argument, 0, 'n'},
+                                      {"output",  required_argument, 0, 'o'},
+                                      {"parity",  required_argument, 0, 'P'},
+                                      {"profile", no_argument, 0, 'p'},
+                                      {"reconstruct", required_argument, 0, 'r'},
+                                      {"restore-plan", no_argument, 0, 'R'},
+                                      {"restore", required_argument, 0, 'x'},
                                       {"size", required_argument, 0, 's'},
-                                      {"version", no_argument, 0, 'V'}
+                                      {"strategy", required_argument, 0, 'S'},
+                                      {"threads", required_argument, 0, 't'},
+                                      {"top",     required_argument, 0, 'T'},
+                                      {"max-depth", required_argument, 0, 'X'},
+                                      {"version", no_argument, 0, 'V'},
+                                      {"verify",  required_argument, 0, 'v'},
+                                      {"what-if", required_argument, 0, 'w'},
+                                      {"watch",   no_argument, 0, 'W'},
+                                      {"estimate", required_argument, 0, 'z'},
+                                      {0, 0, 0, 0}
                                     };
     int optindx = 0;
 
-    while ( (optChar = ::getopt_long(argc, argv, "a:dDhLs:V", l_opts, &optindx)) != EOF )
+    while ( (optChar = ::getopt_long(argc, argv, "a:b:c:CdDE:F:hI:k:l:LmM:n:o:pP:r:Rs:S:t:T:Vv:w:Wx:X:z:", l_opts, &optindx)) != EOF )
     {
         switch ( optChar ) {
             case 'a':
                 dirstr = ::strdup(optarg);
                 break;
+            case 'b':
+                bundle = ::atoi(optarg);
+                break;
+            case 'c':
+                conns = ::atoi(optarg);
+                break;
+            case 'C':
+                resume = true;
+                break;
             case 'd':
                 debug = true;
                 show  = true;
@@ -91,29 +448,257 @@ int main ( int argc, char **argv )
             case 'D':
                 show  = true;
                 break;
+            case 'E':
+                decstr = ::strdup(optarg);
+                break;
+            case 'F':
+                format = OutputWriter::GetFormat(optarg);
+                if ( format < 0 ) {
+                    std::cout << "volgen: Invalid format '" << optarg << "'" << std::endl;
+                    usage();
+                }
+                break;
             case 'h':
                 usage();
                 break;
+            case 'I':
+                StringUtils::split(optarg, ',', std::back_inserter(images));
+                break;
+            case 'k':
+                keystr = ::strdup(optarg);
+                break;
+            case 'l':
+                lmode = VolGen::GetLinkMode(optarg);
+                if ( lmode < 0 ) {
+                    std::cout << "volgen: Invalid link mode '" << optarg << "'" << std::endl;
+                    usage();
+                }
+                break;
             case 'L':
                 dogen = false;
                 break;
+            case 'm':
+                mfest = true;
+                break;
+            case 'M':
+                medstr = ::strdup(optarg);
+                break;
+            case 'n':
+                writers = ::atoi(optarg);
+                break;
+            case 'o':
+                outstr = ::strdup(optarg);
+                break;
+            case 'p':
+                prof = true;
+                break;
+            case 'P':
+                if ( ::sscanf(optarg, "%d:%d", &ndata, &nparity) != 2
+                    || ndata < 1 || nparity < 1 )
+                {
+                    std::cout << "volgen: Invalid parity '" << optarg
+                        << "', expected <n>:<k>" << std::endl;
+                    usage();
+                }
+                mfest = true;
+                break;
+            case 'r':
+                rcnstr = ::strdup(optarg);
+                break;
+            case 'R':
+                rplan = true;
+                break;
             case 's':
                 volsz = ::atoi(optarg);
                 break;
+            case 'S':
+                if ( ! parseStrategies(optarg, strategies) ) {
+                    std::cout << "volgen: Invalid strategy '" << optarg << "'" << std::endl;
+                    usage();
+                }
+                break;
+            case 't':
+                nthrds = ::atoi(optarg);
+                break;
+            case 'T':
+                topn = ::atol(optarg);
+                break;
             case 'V':
                 version();
                 break;
+            case 'v':
+                vfystr = ::strdup(optarg);
+                break;
+            case 'w':
+                if ( ! parseSizes(optarg, whatif) ) {
+                    std::cout << "volgen: Invalid size list '" << optarg << "'" << std::endl;
+                    usage();
+                }
+                dogen = false;
+                break;
+            case 'W':
+                watch = true;
+                dogen = false;
+                break;
+            case 'x':
+                rststr = ::strdup(optarg);
+                break;
+            case 'X':
+                mdepth = ::atol(optarg);
+                break;
+            case 'z':
+                margin = ::atol(optarg);
+                if ( margin < 0 ) {
+                    std::cout << "volgen: Invalid margin '" << optarg << "'" << std::endl;
+                    usage();
+                }
+                break;
         }
     }
 
     if ( argc < 2 )
         usage();
 
+    if ( decstr != NULL )
+    {
+        std::vector<std::string> names(argv + optind, argv + argc);
+        VolCrypt crypt;
+
+        if ( keystr == NULL ) {
+            std::cout << "volgen: --decrypt requires --key <file>" << std::endl;
+            usage();
+        }
+
+        if ( ! crypt.loadKey(keystr) )
+            return -1;
+
+        int r = ( crypt.extract(decstr, names, VolGen::GetCurrentPath()) ) ? 0 : 1;
+
+        ::free(keystr);
+        ::free(decstr);
+
+        return r;
+    }
+
+    if ( rststr != NULL )
+    {
+        std::vector<std::string> media, queries;
+        std::string line;
+
+        voldir = ( dirstr != NULL ) ? dirstr : VOLGEN_ARCHIVEDIR;
+        voldir = getArchivePath(VolGen::GetCurrentPath(), voldir);
+
+        if ( medstr != NULL )
+            StringUtils::split(medstr, ',', std::back_inserter(media));
+
+        for ( int i = optind; i < argc; ++i ) {
+            if ( std::string(argv[i]).compare("-") != 0 ) {
+                queries.push_back(argv[i]);
+                continue;
+            }
+            while ( std::getline(std::cin, line) ) {
+                StringUtils::Trim(line);
+                if ( ! line.empty() )
+                    queries.push_back(line);
+            }
+        }
+
+        int r = restoreFiles(voldir, rststr, media, queries, nthrds,
+                             ( writers > 0 ) ? writers : VOLGEN_RESTORE_WRITERS);
+
+        ::free(dirstr);
+        ::free(medstr);
+        ::free(rststr);
+
+        return r;
+    }
+
     if ( optind == argc ) {
         std::cout << "volgen: No target defined" << std::endl;
         usage();
     }
 
+    if ( strategies.size() > 1 && whatif.empty() ) {
+        std::cout << "volgen: Multiple strategies require --what-if" << std::endl;
+        usage();
+    }
+
+    if ( ! images.empty() && ! dogen ) {
+        std::cout << "volgen: --image requires volume generation" << std::endl;
+        usage();
+    }
+
+    if ( keystr != NULL && images.empty() ) {
+        std::cout << "volgen: --key requires --image or --decrypt" << std::endl;
+        usage();
+    }
+
+    if ( resume && watch ) {
+        std::cout << "volgen: --resume is not supported with --watch" << std::endl;
+        usage();
+    }
+
+    if ( margin >= 0 && watch ) {
+        std::cout << "volgen: --estimate is not supported with --watch" << std::endl;
+        usage();
+    }
+
+    if ( rplan )
+    {
+        std::vector<std::string> queries;
+        std::string line;
+
+        voldir = ( dirstr != NULL ) ? dirstr : VOLGEN_ARCHIVEDIR;
+        voldir = getArchivePath(VolGen::GetCurrentPath(), voldir);
+        ::free(dirstr);
+
+        for ( int i = optind; i < argc; ++i ) {
+            if ( std::string(argv[i]).compare("-") != 0 ) {
+                queries.push_back(argv[i]);
+                continue;
+            }
+            while ( std::getline(std::cin, line) ) {
+                StringUtils::Trim(line);
+                if ( ! line.empty() )
+                    queries.push_back(line);
+            }
+        }
+
+        return restorePlan(voldir, queries, show);
+    }
+
+    if ( vfystr != NULL || rcnstr != NULL )
+    {
+        std::string media = ( medstr != NULL ) ? medstr : "";
+        int         r     = 0;
+
+        voldir = ( dirstr != NULL ) ? dirstr : VOLGEN_ARCHIVEDIR;
+        voldir = getArchivePath(VolGen::GetCurrentPath(), voldir);
+
+        if ( nthrds <= 0 )
+            nthrds = ThreadPool::DefaultThreads();
+
+        if ( vfystr != NULL )
+            r = verifyVolume(voldir, vfystr, argv[optind], nthrds);
+        else
+            r = reconstructVolume(voldir, media, rcnstr, argv[optind], nthrds);
+
+        ::free(dirstr);
+        ::free(medstr);
+        ::free(vfystr);
+        ::free(rcnstr);
+
+        return r;
+    }
+
+    /* stdout is reserved for the formatted output, written to fd 1
+     * directly, so any diagnostics go to stderr */
+    if ( format != VOLGEN_FORMAT_TEXT && outstr == NULL ) {
+        quiet = true;
+        dogen = false;
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     target  = argv[optind];
     int cd  = ::chdir(target.c_str());
 
@@ -142,50 +727,171 @@ int main ( int argc, char **argv )
     curdir = VolGen::GetCurrentPath();
 
     if ( ! StringUtils::StartsWith(voldir, "/") ) {
-        std::string tmp = voldir;
-        voldir = curdir;
+        voldir = getArchivePath(curdir, voldir);
+        if ( ! quiet )
+            std::cout << "volgen: Archive dir set to " << voldir << std::endl;
+    }
 
-        if ( ! StringUtils::EndsWith(voldir, "/") )
-            voldir.append("/");
-        voldir.append(tmp);
+    std::string ckptfile = voldir + "/" + VOLGEN_CKPTFILE;
 
-        std::cout << "volgen: Archive dir set to " << voldir << std::endl;
+    if ( resume && ! FileUtils::IsReadable(ckptfile) ) {
+        std::cout << "volgen Error: no checkpoint found in '" << voldir << "'" << std::endl;
+        return -1;
     }
 
-    if ( FileUtils::IsDirectory(voldir) && dogen ) {
+    if ( FileUtils::IsDirectory(voldir) && dogen && ! resume ) {
         std::cout << "volgen Error: directory already exists. Aborting..." << std::endl;
         return -1;
-    } else if ( FileUtils::IsReadable(voldir) && dogen ) {
+    } else if ( ! FileUtils::IsDirectory(voldir) && FileUtils::IsReadable(voldir) && dogen ) {
         std::cout << "volgen Error: non-directory '" << voldir << "' already exists. Aborting..."
             << std::endl;
         return -1;
     }
 
-    VolGen  vgen(curdir);
+    VolGen    vgen(curdir);
+    VolCrypt  crypt;
+
+    if ( keystr != NULL ) {
+        bool keyed = crypt.loadKey(keystr);
+        ::free(keystr);
+        if ( ! keyed )
+            return -1;
+    }
 
     vgen.setVolumeSize(volsz);
+    vgen.setThreads(nthrds);
+    vgen.setBundleSize(( bundle > 0 ) ? bundle : 0);
+    vgen.setLinkMode(lmode);
+
+    if ( ! strategies.empty() )
+        vgen.setStrategy(strategies.front());
     vgen.setDebug(debug);
+    vgen.setExcludePath(voldir);
+
+    if ( dogen || resume )
+    {
+        if ( ! resume && ::mkdir(voldir.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 ) {
+            std::cout << "volgen: Error creating volgen archive dir '" << voldir << "' : "
+                << strerror(errno) << std::endl;
+            return -1;
+        }
+        if ( ! vgen.setCheckpoint(ckptfile, resume) )
+            return -1;
+        if ( ! quiet )
+            vgen.displayCheckpoint();
+    }
+
+    vgen.setReportLimits(( topn > 0 ) ? topn : 0, ( mdepth >= 0 ) ? mdepth : -1);
+
+    if ( prof )
+        vgen.setProfile(( topn > 0 ) ? topn : VOLGEN_PROFILE_TOP);
 
     if ( ! vgen.read() ) {
         std::cout << "volgen: Fatal error reading directory" << std::endl;
         return -1;
     }
 
-    if ( dogen && ::mkdir(voldir.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 ) {
-        std::cout << "volgen: Error creating volgen archive dir '" << voldir << "' : "
-            << strerror(errno) << std::endl;
+    if ( prof && ! quiet )
+        vgen.displayProfile();
+
+    if ( margin >= 0 ) {
+        vgen.setEstimate(margin);
+        if ( ! vgen.estimate() )
+            return -1;
+        if ( ! quiet )
+            vgen.displayEstimate();
+    }
+
+    if ( format == VOLGEN_FORMAT_TEXT )
+        vgen.displayTree();
+
+    if ( ! whatif.empty() )
+    {
+        if ( strategies.empty() )
+            strategies.push_back(vgen.getStrategy());
+
+        vgen.compareVolumes(std::cout, whatif, strategies);
+
+        std::cout << "volgen finished." << std::endl;
+        return 0;
     }
 
-    vgen.displayTree();
     vgen.createVolumes();
-    vgen.displayVolumes(show);
 
-    if ( dogen )
-        vgen.generateVolumes(voldir);
+    if ( format == VOLGEN_FORMAT_TEXT )
+    {
+        vgen.displayVolumes(show);
+    }
     else
+    {
+        OutputWriter writer;
+
+        if ( outstr != NULL && ! writer.open(outstr) )
+            return -1;
+
+        if ( ! vgen.writeOutput(writer, format) || ! writer.close() ) {
+            std::cout << "volgen: Error writing output : "
+                << strerror(writer.getError()) << std::endl;
+            return -1;
+        }
+
+        ::free(outstr);
+
+        if ( quiet )
+            return 0;
+    }
+
+    if ( watch )
+    {
+        std::string planfile = voldir + "/" + VOLGEN_PLANFILE;
+
+        if ( ! FileUtils::IsDirectory(voldir)
+            && ::mkdir(voldir.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH) < 0 )
+        {
+            std::cout << "volgen: Error creating volgen archive dir '" << voldir << "' : "
+                << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        VolWatch  vwatch(&vgen);
+
+        if ( ! vwatch.init() ) {
+            std::cout << "volgen: Failed to initialize filesystem watch" << std::endl;
+            return -1;
+        }
+
+        watcher = &vwatch;
+        ::signal(SIGINT,  &sigHandler);
+        ::signal(SIGTERM, &sigHandler);
+
+        vgen.writePlan(planfile);
+        std::cout << "volgen: Watching " << curdir << ", plan file is "
+                  << planfile << std::endl;
+
+        vwatch.run(planfile);
+        watcher = NULL;
+
+        std::cout << "volgen finished." << std::endl;
+        return 0;
+    }
+
+    bool ok = true;
+
+    if ( dogen ) {
+        ok  = vgen.generateVolumes(voldir);
+        ok &= vgen.generateIndex(voldir);
+        if ( ! images.empty() )
+            ok &= vgen.generateImages(voldir, images, ( crypt.isKeyed() ) ? &crypt : NULL,
+                                      ( conns > 0 ) ? conns : 0);
+        if ( mfest )
+            ok &= vgen.generateManifests(voldir);
+        if ( ndata > 0 )
+            ok &= vgen.generateParity(voldir, ndata, nparity);
+        ::unlink(ckptfile.c_str());
+    } else
         std::cout << "volgen: List only, no volumes generated." << std::endl;
 
     std::cout << "volgen finished." << std::endl;
 
-    return 0;
+    return ( ok ) ? 0 : 1;
 }
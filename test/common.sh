@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+#
+#  common.sh
+#
+#  @file    common.sh
+#  @author  Timothy C. Arland <tcarland at gmail dot com>
+#
+#  Shared helpers of the volgen tests, sourced by each test/t_*.sh.
+#  Tests run in a scratch directory with $VOLGEN set to the binary.
+#
+
+VOLGEN=${VOLGEN:-volgen}
+
+fail() {
+    echo "FAIL: $*"
+    exit 1
+}
+
+skip() {
+    echo "$*"
+    exit 77
+}
+
+# run a command, failing the test if it does not succeed
+check() {
+    "$@" || fail "'$*' returned $?"
+}
+
+# mkfile <path> <bytes> : a file of random content
+mkfile() {
+    mkdir -p "$(dirname "$1")"
+    head -c "$2" /dev/urandom > "$1"
+}
+
+# mktree <dir> : a small tree of nested directories, files of several
+# sizes and a symlink to each of a file and a directory
+mktree() {
+    local dir="$1"
+    local d f
+
+    for d in a a/b a/b/c d e; do
+        mkdir -p "$dir/$d"
+        for f in 1 2 3; do
+            mkfile "$dir/$d/small$f" $(( f * 1000 ))
+        done
+        mkfile "$dir/$d/large" $(( 600 * 1024 ))
+    done
+
+    ln -s small1 "$dir/a/filelink"
+    ln -s ../d "$dir/a/dirlink"
+}
+
+# volumes <voldir> : the number of volumes generated in a meta dir
+volumes() {
+    ls -d "$1"/Volume_[0-9]*/ 2>/dev/null | wc -l
+}
@@ -0,0 +1,107 @@
+/**
+  * @file libvolgen_test.c
+  *
+  * Plans a tree through the libvolgen C interface, printing the plan
+  * for t_libvolgen.sh to compare with the volgen binary.
+  *
+  *   libvolgen_test <path> <size_mb> <strategy> [voldir]
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvolgen.h"
+
+
+typedef struct {
+    size_t  dirs;
+    size_t  files;
+    size_t  volumes;
+} counts_t;
+
+
+static void
+on_entry ( const volgen_entry_t * entry, void * arg )
+{
+    counts_t * c = (counts_t*) arg;
+
+    if ( entry->dir )
+        c->dirs++;
+    else
+        c->files++;
+}
+
+
+static void
+on_volume ( const volgen_volume_t * vol, void * arg )
+{
+    ((counts_t*) arg)->volumes++;
+    (void) vol;
+}
+
+
+#define CHECK(cond, msg)  do { if ( ! (cond) ) { \
+    fprintf(stderr, "libvolgen_test: %s\n", msg); return 1; } } while (0)
+
+
+int
+main ( int argc, char ** argv )
+{
+    counts_t         c;
+    volgen_t *       vg;
+    volgen_plan_t *  plan;
+    volgen_volume_t  vol;
+    size_t           v, i;
+
+    if ( argc < 4 ) {
+        fprintf(stderr, "usage: libvolgen_test <path> <size_mb> <strategy> [voldir]\n");
+        return 1;
+    }
+
+    memset(&c, 0, sizeof(c));
+
+    CHECK(volgen_abi_version() == VOLGEN_ABI_VERSION, "ABI version mismatch");
+    CHECK(volgen_create(NULL) == NULL, "created without a path");
+    CHECK(volgen_create("no/such/dir") == NULL, "created for a missing path");
+
+    vg = volgen_create(argv[1]);
+    CHECK(vg != NULL, "volgen_create failed");
+
+    CHECK(volgen_set_volume_size(vg, 0) == -1, "accepted a zero volume size");
+    CHECK(volgen_set_strategy(vg, "bogus") == -1, "accepted a bogus strategy");
+    CHECK(volgen_set_link_mode(vg, "bogus") == -1, "accepted a bogus link mode");
+    CHECK(volgen_plan(vg, NULL, NULL) == NULL, "planned before the scan");
+
+    CHECK(volgen_set_volume_size(vg, (size_t) atoi(argv[2])) == 0, "volgen_set_volume_size failed");
+    CHECK(volgen_set_strategy(vg, argv[3]) == 0, "volgen_set_strategy failed");
+    CHECK(volgen_scan(vg, on_entry, &c) == 0, "volgen_scan failed");
+    CHECK(volgen_scan(vg, NULL, NULL) == -1, "scanned the tree twice");
+
+    plan = volgen_plan(vg, on_volume, &c);
+    CHECK(plan != NULL, "volgen_plan failed");
+    CHECK(c.volumes == volgen_plan_count(plan), "visited volumes differ from the plan");
+    CHECK(volgen_plan_volume(plan, c.volumes, &vol) == -1, "volume index out of range accepted");
+
+    printf("Entries : %zu dir(s), %zu file(s)\n", c.dirs, c.files);
+    printf("Number of volumes = %zu\n", volgen_plan_count(plan));
+
+    for ( v = 0; v < volgen_plan_count(plan); ++v )
+    {
+        CHECK(volgen_plan_volume(plan, v, &vol) == 0, "volgen_plan_volume failed");
+        printf("%s : %zu item(s)\n", vol.name, vol.nitems);
+
+        for ( i = 0; i < vol.nitems; ++i )
+            printf("   %s\n", vol.items[i].name);
+    }
+    printf("Skipped = %zu\n", volgen_plan_skipped(plan));
+
+    volgen_plan_free(plan);
+
+    if ( argc > 4 )
+        CHECK(volgen_generate(vg, argv[4], VOLGEN_GEN_MANIFEST | VOLGEN_GEN_INDEX) == 0,
+              "volgen_generate failed");
+
+    volgen_destroy(vg);
+
+    return 0;
+}
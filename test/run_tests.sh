@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+#
+#  run_tests.sh
+#
+#  @file    run_tests.sh
+#  @author  Timothy C. Arland <tcarland at gmail dot com>
+#
+#  Runs the behavioral tests of volgen, each test/t_*.sh in a scratch
+#  directory of its own.
+#
+PNAME=${0##*/}
+TESTDIR=$(dirname "$(realpath "$0")")
+
+usage="
+Synopsis:
+  $PNAME [volgen] [test]...
+
+Runs the given tests, or all of test/t_*.sh, against the volgen binary
+given (default is ./volgen). A test exits 0 on success, 77 when it is
+skipped, or non-zero on failure.
+"
+
+if [[ "$1" == "-h" || "$1" == "--help" ]]; then
+    echo "$usage"
+    exit 0
+fi
+
+VOLGEN=$(realpath "${1:-./volgen}")
+shift
+
+if [ ! -x "$VOLGEN" ]; then
+    echo "$PNAME: volgen binary '$VOLGEN' not found, build it first."
+    exit 1
+fi
+
+tests=("$@")
+if [ ${#tests[@]} -eq 0 ]; then
+    tests=("$TESTDIR"/t_*.sh)
+fi
+
+pass=0
+fail=0
+skip=0
+
+for t in "${tests[@]}"; do
+    name=$(basename "$t" .sh)
+    scratch=$(mktemp -d "${TMPDIR:-/tmp}/volgen_${name}.XXXXXX")
+    log="$scratch/test.log"
+
+    ( cd "$scratch" && VOLGEN="$VOLGEN" TESTDIR="$TESTDIR" bash "$TESTDIR/${name}.sh" ) > "$log" 2>&1
+    rt=$?
+
+    if [ $rt -eq 0 ]; then
+        echo "PASS  $name"
+        (( pass++ ))
+        rm -rf "$scratch"
+    elif [ $rt -eq 77 ]; then
+        echo "SKIP  $name : $(tail -1 "$log")"
+        (( skip++ ))
+        rm -rf "$scratch"
+    else
+        echo "FAIL  $name (see $log)"
+        tail -5 "$log" | sed 's/^/      /'
+        (( fail++ ))
+    fi
+done
+
+echo "$PNAME: $pass passed, $fail failed, $skip skipped"
+
+exit $(( fail > 0 ))
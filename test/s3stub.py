@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+#
+#  s3stub.py
+#
+#  A minimal stand-in for the multipart upload API of an S3 service,
+#  used by t_upload.sh. Requests are checked against their SigV4
+#  signature and Content-MD5, completed objects are stored under
+#  <root>/<bucket>/<key>, and the size of each of their parts is
+#  listed in <root>/.parts. The port is written to <root>/.port.
+#  Unfinished uploads are kept in <root>/.uploads, so a restarted
+#  stub can resume them.
+#
+#    s3stub.py <root> [fail-once] [kill-after <n>]
+#
+#  'fail-once' answers the first attempt at each part with a 503, and
+#  'kill-after' exits once <n> parts have been stored.
+#
+import base64
+import hashlib
+import hmac
+import json
+import os
+import re
+import sys
+import threading
+import time
+import urllib.parse
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+ACCESS = "testkey"
+SECRET = "testsecret"
+MINPART = 5 * 1024 * 1024
+
+root = sys.argv[1]
+failonce = "fail-once" in sys.argv
+killafter = int(sys.argv[sys.argv.index("kill-after") + 1]) if "kill-after" in sys.argv else 0
+uploads = {}
+failed = set()
+stored = 0
+lock = threading.Lock()
+
+
+def save():
+    with open(f"{root}/.uploads.tmp", "w") as f:
+        json.dump(uploads, f)
+    os.rename(f"{root}/.uploads.tmp", f"{root}/.uploads")
+
+
+def quote(s, path=False):
+    return urllib.parse.quote(s, safe="-_.~" + ("/" if path else ""))
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def reply(self, code, body=b"", headers=None):
+        self.send_response(code)
+        for k, v in (headers or {}).items():
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def error(self, code, name, msg):
+        self.reply(code, f"<Error><Code>{name}</Code><Message>{msg}</Message></Error>".encode())
+
+    def verify(self, body):
+        auth = self.headers.get("Authorization", "")
+        if not auth.startswith("AWS4-HMAC-SHA256 "):
+            return "no authorization"
+        fields = dict(p.strip().split("=", 1) for p in auth[17:].split(","))
+        cred = fields["Credential"].split("/")
+        signed = fields["SignedHeaders"].split(";")
+        if cred[0] != ACCESS:
+            return "bad access key"
+        for h in signed + ["authorization"]:
+            if len(self.headers.get_all(h, [])) != 1:
+                return f"header {h} given {len(self.headers.get_all(h, []))} times"
+        payload = self.headers.get("x-amz-content-sha256")
+        if payload != hashlib.sha256(body).hexdigest():
+            return "payload hash mismatch"
+        url = urllib.parse.urlsplit(self.path)
+        query = urllib.parse.parse_qsl(url.query, keep_blank_values=True)
+        creq = "\n".join([self.command,
+                          quote(urllib.parse.unquote(url.path), True),
+                          "&".join(f"{quote(k)}={quote(v)}" for k, v in sorted(query)),
+                          "".join(f"{h}:{self.headers.get(h).strip()}\n" for h in signed),
+                          ";".join(signed),
+                          payload])
+        sts = "\n".join(["AWS4-HMAC-SHA256", self.headers.get("x-amz-date"), "/".join(cred[1:]),
+                         hashlib.sha256(creq.encode()).hexdigest()])
+        key = ("AWS4" + SECRET).encode()
+        for part in cred[1:]:
+            key = hmac.new(key, part.encode(), hashlib.sha256).digest()
+        sig = hmac.new(key, sts.encode(), hashlib.sha256).hexdigest()
+        return None if sig == fields["Signature"] else "signature mismatch"
+
+    def handle_request(self):
+        n = int(self.headers.get("Content-Length", "0") or 0)
+        body = self.rfile.read(n) if n else b""
+        err = self.verify(body)
+        if err:
+            return self.error(403, "SignatureDoesNotMatch", err)
+
+        url = urllib.parse.urlsplit(self.path)
+        query = dict(urllib.parse.parse_qsl(url.query, keep_blank_values=True))
+        bucket, _, key = urllib.parse.unquote(url.path).lstrip("/").partition("/")
+        uid = query.get("uploadId")
+
+        if self.command == "POST" and "uploads" in query:
+            uid = uuid.uuid4().hex
+            with lock:
+                uploads[uid] = {"key": key, "parts": {},
+                                "init": time.strftime("%Y-%m-%dT%H:%M:%S.000Z", time.gmtime())}
+                save()
+            return self.reply(200, (f"<InitiateMultipartUploadResult><Bucket>{bucket}</Bucket>"
+                                    f"<Key>{key}</Key><UploadId>{uid}</UploadId>"
+                                    "</InitiateMultipartUploadResult>").encode())
+
+        if self.command == "GET" and "uploads" in query:
+            with lock:
+                found = "".join(f"<Upload><Key>{u['key']}</Key><UploadId>{i}</UploadId>"
+                                f"<Initiated>{u['init']}</Initiated></Upload>"
+                                for i, u in uploads.items()
+                                if u["key"].startswith(query.get("prefix", "")))
+            return self.reply(200, ("<ListMultipartUploadsResult><IsTruncated>false</IsTruncated>"
+                                    f"{found}</ListMultipartUploadsResult>").encode())
+
+        if uid is None or uid not in uploads:
+            return self.error(404, "NoSuchUpload", "no such upload")
+
+        if self.command == "PUT" and "partNumber" in query:
+            global stored
+            md5 = hashlib.md5(body)
+            if base64.b64encode(md5.digest()).decode() != self.headers.get("Content-MD5"):
+                return self.error(400, "BadDigest", "Content-MD5 mismatch")
+            num = query["partNumber"]
+            with lock:
+                first = failonce and (uid, num) not in failed
+                failed.add((uid, num))
+            if first:
+                return self.error(503, "SlowDown", "injected")
+            path = f"{root}/.{uid}.{num}"
+            with open(path, "wb") as f:
+                f.write(body)
+            with lock:
+                uploads[uid]["parts"][num] = (md5.hexdigest(), path, len(body))
+                save()
+                stored += 1
+                if killafter and stored >= killafter:
+                    os._exit(1)
+            return self.reply(200, b"", {"ETag": f'"{md5.hexdigest()}"'})
+
+        if self.command == "GET":
+            with lock:
+                parts = dict(uploads[uid]["parts"])
+            found = "".join(f"<Part><PartNumber>{n}</PartNumber><ETag>&quot;{parts[n][0]}&quot;</ETag>"
+                            f"<Size>{parts[n][2]}</Size></Part>" for n in sorted(parts, key=int))
+            return self.reply(200, ("<ListPartsResult><IsTruncated>false</IsTruncated>"
+                                    f"{found}</ListPartsResult>").encode())
+
+        if self.command == "POST":
+            want = re.findall(rb"<PartNumber>(\d+)</PartNumber><ETag>\"([0-9a-f]+)\"</ETag>", body)
+            parts = uploads[uid]["parts"]
+            out = f"{root}/{bucket}/{key}"
+            os.makedirs(os.path.dirname(out), exist_ok=True)
+            with open(out, "wb") as o:
+                for i, (num, etag) in enumerate(want):
+                    part = parts.get(num.decode())
+                    if not part or part[0] != etag.decode():
+                        return self.error(400, "InvalidPart", f"part {int(num)}")
+                    if i < len(want) - 1 and part[2] < MINPART:
+                        return self.error(400, "EntityTooSmall", f"part {int(num)}")
+                    with open(part[1], "rb") as f:
+                        o.write(f.read())
+            with lock:
+                with open(f"{root}/.parts", "a") as f:
+                    f.write(f"{bucket}/{key} " + " ".join(str(parts[n.decode()][2]) for n, _ in want) + "\n")
+                for part in parts.values():
+                    os.unlink(part[1])
+                del uploads[uid]
+                save()
+            return self.reply(200, f"<CompleteMultipartUploadResult><Key>{key}</Key></CompleteMultipartUploadResult>".encode())
+
+        if self.command == "DELETE":
+            with lock:
+                del uploads[uid]
+                save()
+            return self.reply(204)
+
+        return self.error(400, "Unsupported", self.command + " " + self.path)
+
+    do_GET = do_PUT = do_POST = do_DELETE = handle_request
+
+
+os.makedirs(root, exist_ok=True)
+if os.path.exists(f"{root}/.uploads"):
+    with open(f"{root}/.uploads") as f:
+        uploads = json.load(f)
+server = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+with open(f"{root}/.port.tmp", "w") as f:
+    f.write(str(server.server_address[1]))
+os.rename(f"{root}/.port.tmp", f"{root}/.port")
+server.serve_forever()
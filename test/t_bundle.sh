@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+#
+#  Small files are bundled into a tar per directory whose index gives
+#  the offset of each member, and split directories are staged at any
+#  depth so the volumes can be read back through the meta dir. Small
+#  files too many for one volume are planned one by one instead.
+#
+source "$TESTDIR/common.sh"
+
+for f in $(seq 1 40); do
+    mkfile src/small/f$f $(( f * 97 ))
+    mkfile src/small/sub/g$f $(( f * 31 ))
+done
+mkfile src/small/large $(( 200 * 1024 ))
+
+# a directory deeper and larger than a volume, split into file items
+for f in 1 2 3 4 5; do
+    mkfile src/big/x/y/f$f $(( 700 * 1024 ))
+    mkfile src/big/x/z/g$f $(( 700 * 1024 ))
+done
+
+check "$VOLGEN" -s 2 -b 8 -P 2:1 -a "$PWD/meta" src > gen.out
+grep -q "Wrote [1-9][0-9]* bundle(s)$" gen.out || fail "no bundles written: $(grep -i bundle gen.out)"
+
+# every bundle is a valid tar of its directory's small files, and each
+# member is found at its indexed offset
+nbundles=0
+while read -r bundle; do
+    dir=$(dirname "$bundle")
+    rel=${dir#meta/Volume_*/}
+    idx="$dir/.volgen_bundle.idx"
+
+    rm -rf x && mkdir x
+    tar -xf "$bundle" -C x || fail "$bundle is not a valid tar"
+
+    while IFS=$'\t' read -r off size name; do
+        cmp "x/$name" "src/$rel/$name" || fail "$rel/$name differs in the bundle"
+        cmp <(tail -c +$(( off + 1 )) "$bundle" | head -c $size) "src/$rel/$name" \
+            || fail "$rel/$name not at offset $off"
+    done < "$idx"
+
+    (( nbundles++ ))
+done < <(find meta -name .volgen_bundle.tar)
+
+[ $nbundles -eq 2 ] || fail "expected 2 bundles, found $nbundles"
+
+# the volumes staged in the meta dir hold every file of the manifests
+for mf in meta/Volume_*.manifest; do
+    vol=$(basename $mf .manifest)
+    tail -n +2 $mf | cut -f4 | while read -r name; do
+        [ -e "meta/$vol/$name" ] || fail "$vol/$name not staged"
+    done || exit 1
+done
+
+grep -q "Group 1 :" gen.out || fail "parity was not generated"
+
+# a directory whose small files exceed a volume is not bundled
+for f in $(seq 1 300); do
+    mkfile many/d/f$f $(( 8 * 1024 ))
+done
+check "$VOLGEN" -s 1 -b 16 -D -m -a "$PWD/meta3" many > many.out
+grep "^Volume_" many.out | awk -F' : ' '{ sub(/%/, "", $3); if ( $3 + 0 > 100 ) exit 1 }' \
+    || fail "a volume is filled past its size: $(grep '^Volume_' many.out)"
+[ -z "$(find meta3 -name .volgen_bundle.tar)" ] || fail "an oversized bundle was written"
+cat meta3/Volume_*.manifest | grep -v '^#' | cut -f4 | sort > planned
+(cd many && find . -type f | sed 's,^\./,,' | sort) > expected
+cmp planned expected || fail "manifests do not hold each file once"
+"$VOLGEN" -a "$PWD/meta3" -x "$PWD/out" -M "$PWD/meta3" > restore.log 2>&1 \
+    || fail "restore failed: $(tail -3 restore.log)"
+diff -r many out || fail "restored files differ"
+
+# a file that cannot be read fails its bundle, it is not dropped quietly
+if [ $(id -u) -ne 0 ]; then
+    chmod 000 src/small/f7
+    "$VOLGEN" -s 2 -b 8 -a "$PWD/meta2" src > gen2.out && fail "unreadable file not reported"
+    grep -q "1 error(s)" gen2.out || fail "bundle error not counted"
+    chmod 644 src/small/f7
+fi
+exit 0
@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+#
+#  Images written with --key decrypt back to the source tree, a single
+#  file decrypts only its own segments, and a wrong key or altered
+#  image fails authentication.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+mkfile src/big/f 1500000
+head -c 32 /dev/urandom > key
+head -c 32 /dev/urandom > badkey
+
+mkdir img
+"$VOLGEN" -s 2 -a "$PWD/meta" -I "$PWD/img" -k "$PWD/key" src > gen.log 2>&1 || fail "encrypted run failed"
+nvol=$(volumes meta)
+[ $(ls img/*.tar.vgc | wc -l) -eq "$nvol" ] || fail "not one encrypted image per volume"
+for img in img/*.tar.vgc; do
+    tar -tf "$img" > /dev/null 2>&1 && fail "$img is not encrypted"
+done
+
+mkdir out
+for img in img/*.tar.vgc; do
+    ( cd out && "$VOLGEN" --key ../key --decrypt "../$img" ) > dec.log 2>&1 || fail "decrypt $img: $(cat dec.log)"
+done
+diff -r --no-dereference src out || fail "decrypted images differ from the source"
+
+# one small file is a single segment of the image holding it
+mkdir one
+for img in img/*.tar.vgc; do
+    ( cd one && "$VOLGEN" --key ../key --decrypt "../$img" a/b/c/small1 ) > one.log 2>&1 && break
+done
+grep -q "Extracted 1 of [0-9]* file(s) .*, 1 of [2-9] segment(s) decrypted" one.log || fail "$(cat one.log)"
+cmp src/a/b/c/small1 one/a/b/c/small1 || fail "single file differs"
+[ $(find one -type f | wc -l) -eq 1 ] || fail "extracted more than the file asked for"
+
+mkdir bad
+img=$(ls img/*.tar.vgc | head -1)
+( cd bad && "$VOLGEN" --key ../badkey --decrypt "../$img" ) > bad.log 2>&1 && fail "wrong key accepted"
+grep -q "wrong key or damaged image" bad.log || fail "wrong key: $(cat bad.log)"
+
+cp "$img" altered.vgc
+printf '\xff' | dd of=altered.vgc bs=1 seek=$(( 600 * 1024 )) conv=notrunc status=none
+( cd bad && "$VOLGEN" --key ../key --decrypt ../altered.vgc ) > alt.log 2>&1 && fail "altered image accepted"
+grep -q "Failed to decrypt '" alt.log || fail "altered segment not reported"
+# files of the intact segments are still recovered, those of the altered one are not
+while read -r f; do
+    grep -q "Failed to decrypt '${f#bad/}'" alt.log && fail "altered $f was written out"
+    cmp "$f" "src/${f#bad/}" || fail "$f differs"
+done < <(find bad -type f)
+
+exit 0
@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+#
+#  --estimate plans by sampled compressed size: compressible data packs
+#  into fewer volumes, incompressible data plans as it would without it.
+#
+source "$TESTDIR/common.sh"
+
+for n in 1 2 3 4 5 6; do
+    mkdir -p text rand
+    yes "line $n of some very compressible text" | head -c $(( 900 * 1024 )) > text/t$n
+    mkfile rand/r$n $(( 900 * 1024 ))
+done
+
+count() {
+    "$VOLGEN" -L -s 2 "$@" | sed -n 's/^Number of volumes = //p'
+}
+
+[ "$(count text)" == "3" ]       || fail "text without estimate: $(count text) volume(s)"
+[ "$(count -z 10 text)" == "1" ] || fail "text with estimate: $(count -z 10 text) volume(s)"
+[ "$(count rand)" == "3" ]       || fail "random without estimate: $(count rand) volume(s)"
+[ "$(count -z 0 rand)" == "3" ]  || fail "random with estimate: $(count -z 0 rand) volume(s)"
+
+# the plan says it is an estimate, and a larger margin only grows it
+"$VOLGEN" -L -s 2 -z 10 text | grep -q "^VolGen: Estimated compressed size .* with a 10% margin" \
+    || fail "estimate not reported"
+[ "$(count -z 10 rand)" == "6" ] || fail "margin not applied: $(count -z 10 rand) volume(s)"
+
+exit 0
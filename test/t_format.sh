@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+#
+#  Structured output on stdout stays parseable, with diagnostics on
+#  stderr, and lists the files too large for a volume as skipped.
+#
+source "$TESTDIR/common.sh"
+
+command -v python3 > /dev/null || skip "python3 is required"
+
+mktree src
+mkfile src/big/huge $(( 3 * 1024 * 1024 ))
+
+for fmt in json ndjson csv; do
+    check "$VOLGEN" -s 2 -F $fmt src > out.$fmt 2> err.$fmt
+    grep -q "larger than volume size.*big/huge" err.$fmt || fail "$fmt: warning not on stderr"
+done
+
+python3 - <<'PY' || fail "structured output is invalid"
+import csv, json
+
+d = json.load(open("out.json"))
+assert d["skipped"] == [{"name": "big/huge", "file_size": 3 * 1024 * 1024}], d["skipped"]
+assert len(d["volumes"]) >= 2
+assert sum(v["count"] for v in d["volumes"]) == sum(len(v["items"]) for v in d["volumes"])
+
+recs = [json.loads(l) for l in open("out.ndjson")]
+kinds = {r["record"] for r in recs}
+assert {"volume", "item", "skipped"} <= kinds, kinds
+assert [r["name"] for r in recs if r["record"] == "skipped"] == ["big/huge"]
+
+rows = list(csv.reader(open("out.csv")))
+assert all(len(r) == len(rows[0]) for r in rows), "ragged csv"
+assert [r[2] for r in rows if r[0] == "skipped"] == ["big/huge"]
+PY
+
+# without skipped files, and with a subdirectory that cannot be read
+rm src/big/huge
+if [ $(id -u) -ne 0 ]; then
+    chmod 000 src/e
+fi
+"$VOLGEN" -s 2 -F json src > out.json 2> err.json
+python3 -c 'import json; d = json.load(open("out.json")); assert d["skipped"] == []' \
+    || fail "json invalid without skipped files"
+chmod 755 src/e
+exit 0
@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+#
+#  --image writes every volume as a tar image, spread over the targets in
+#  turn; extracting all of them gives back the source tree.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+long=$(printf 'x%.0s' $(seq 1 120))
+mkdir -p "src/e/$long"
+mkfile "src/e/$long/f" 1000
+ln -s "$long/f" src/e/longlink
+
+mkdir img1 img2
+"$VOLGEN" -s 1 -a "$PWD/meta" -I "$PWD/img1,$PWD/img2" src > gen.log 2>&1 || fail "image run failed"
+grep -q "Volume images written, .* to 2 target(s)" gen.log || fail "no image summary"
+
+nvol=$(volumes meta)
+[ "$nvol" -gt 2 ] || fail "expected several volumes, got $nvol"
+[ $(ls img1/*.tar img2/*.tar | wc -l) -eq "$nvol" ] || fail "not one image per volume"
+[ -f img1/Volume_01.tar ] && [ -f img2/Volume_02.tar ] && [ -f img1/Volume_03.tar ] \
+    || fail "volumes not assigned to the targets in turn"
+
+mkdir out
+for img in img1/*.tar img2/*.tar; do
+    [ $(( $(stat -c %s "$img") % 4096 )) -eq 0 ] || fail "$img not padded to the alignment"
+    tar -xf "$img" -C out || fail "$img is not a valid tar"
+done
+diff -r --no-dereference src out || fail "images differ from the source"
+
+# bundled small files are written as their bundles
+rm -rf meta out img1/* img2/*
+"$VOLGEN" -s 1 -b 4 -a "$PWD/meta" -I "$PWD/img1,$PWD/img2" src > gen.log 2>&1 || fail "bundle image run failed"
+tar -tf img1/Volume_01.tar | grep -q '\.tar$' || fail "no bundle in Volume_01.tar"
+tar -tf img1/Volume_01.tar | grep -q 'small1$' && fail "bundled file stored on its own"
+
+exit 0
@@ -0,0 +1,40 @@
+#!/usr/bin/env bash
+#
+#  libvolgen plans and generates the same volumes as the volgen binary.
+#  Needs a C compiler and lib/libvolgen.so ('make solib'), or the
+#  library given by LIBVOLGEN. VOLGEN_LIBS adds any libraries it needs.
+#
+source "$TESTDIR/common.sh"
+
+CC=${CC:-cc}
+LIBVOLGEN=${LIBVOLGEN:-$TESTDIR/../lib/libvolgen.so}
+VOLGEN_LIBS=${VOLGEN_LIBS:--lstdc++ -lcrypto -lcurl -lrt -lzstd -lpthread}
+
+command -v "$CC" > /dev/null || skip "no C compiler '$CC'"
+[ -f "$LIBVOLGEN" ] || skip "no library '$LIBVOLGEN', run 'make solib'"
+LIBVOLGEN=$(realpath "$LIBVOLGEN")
+
+$CC -std=c99 -Wall -Werror -I"$TESTDIR/../include" -o libvolgen_test "$TESTDIR/libvolgen_test.c" \
+    "$LIBVOLGEN" -Wl,-rpath,"$(dirname "$LIBVOLGEN")" $VOLGEN_LIBS || fail "libvolgen_test did not build"
+
+mktree src
+mkfile src/big/huge $(( 2 * 1024 * 1024 ))
+
+for st in next ffd local; do
+    ./libvolgen_test src 1 $st > lib.out || fail "$st: $(cat lib.out)"
+    "$VOLGEN" -L -s 1 -S $st src > cli.out 2>&1
+
+    cmp <(sed -n 's/^\(Volume_[0-9]*\) : .* : \([0-9]* item(s)\)$/\1 : \2/p; /^Number of volumes/p' cli.out) \
+        <(grep -E "^(Volume_|Number of volumes)" lib.out) || fail "$st: plans differ"
+    skipped=$(grep -c "larger than volume size" cli.out)
+    grep -q "^Skipped = $skipped$" lib.out || fail "$st: skipped differs from $skipped"
+done
+
+grep -q "^Entries : 6 dir(s), 23 file(s)" lib.out || fail "scan visited $(grep Entries lib.out)"
+
+./libvolgen_test src 1 ffd "$PWD/libmeta" > /dev/null || fail "generate failed"
+"$VOLGEN" -s 1 -S ffd -m -a "$PWD/climeta" src > /dev/null 2>&1 || fail "volgen run failed"
+diff -r --no-dereference -x volgen.index libmeta climeta || fail "generated volumes differ"
+[ -f libmeta/volgen.index ] || fail "no index generated"
+
+exit 0
@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+#
+#  --link hardlink and reflink fill the volumes with real files; a file
+#  that cannot be linked falls back to a symlink.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+nfiles=$(find src -type f -o -type l | wc -l)
+
+"$VOLGEN" -s 1 -a "$PWD/meta" src > sym.log 2>&1 || fail "symlink run failed"
+[ -z "$(find meta/Volume_[0-9]* -type f)" ] || fail "symlink mode staged real files"
+
+"$VOLGEN" -s 1 -l hardlink -a "$PWD/hard" src > hard.log 2>&1 || fail "hardlink run failed"
+grep -q "^Staged 0 reflink(s), $nfiles hard link(s), 0 symlink(s)" hard.log \
+    || fail "hardlink counts: $(grep Staged hard.log)"
+
+n=0
+for vol in hard/Volume_[0-9]*; do
+    while read -r f; do
+        rel=${f#$vol/}
+        [ "$(stat -c %i "$f")" == "$(stat -c %i "src/$rel")" ] || fail "$f is not a hard link of src/$rel"
+        n=$(( n + 1 ))
+    done < <(find "$vol" -type f -o -type l)
+done
+[ "$n" -eq "$nfiles" ] || fail "$n of $nfiles files staged"
+[ -L "$(ls -d hard/Volume_[0-9]*/a/filelink)" ] || fail "tree symlink was followed"
+
+# reflink falls back to hard links where the filesystem cannot clone
+"$VOLGEN" -s 1 -l reflink -a "$PWD/ref" src > ref.log 2>&1 || fail "reflink run failed"
+counts=$(sed -n 's/^Staged \([0-9]*\) reflink(s), \([0-9]*\) hard link(s), \([0-9]*\) symlink(s).*/\1 \2 \3/p' ref.log)
+set -- $counts
+[ $(( $1 + $2 )) -eq "$nfiles" ] && [ "$3" -eq 0 ] || fail "reflink counts: $counts"
+
+# across filesystems every file falls back to a symlink
+other=/dev/shm
+if [ -d "$other" ] && [ -w "$other" ] && [ "$(stat -c %d "$other")" != "$(stat -c %d .)" ]; then
+    meta=$(mktemp -d "$other/volgen_link.XXXXXX")
+    "$VOLGEN" -s 1 -l hardlink -a "$meta/meta" src > cross.log 2>&1
+    rc=$?
+    rm -rf "$meta"
+    [ $rc -eq 0 ] || fail "cross device run failed"
+    grep -q "^Staged 0 reflink(s), 0 hard link(s), $nfiles symlink(s)" cross.log \
+        || fail "cross device counts: $(grep Staged cross.log)"
+fi
+
+exit 0
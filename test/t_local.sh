@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+#
+#  The 'local' strategy keeps directories on few volumes, and the
+#  what-if "Dir spans" column counts the volumes each directory spans
+#  beyond its first.
+#
+source "$TESTDIR/common.sh"
+
+for d in 1 2 3 4 5 6 7 8; do
+    for s in 1 2 3; do
+        mkfile src/d$d/s$s/f1 $(( (d * 37 % 11 + 1) * 61 * 1024 ))
+        mkfile src/d$d/s$s/f2 $(( (s * 53 % 7 + 1) * 83 * 1024 ))
+    done
+    mkfile src/d$d/own $(( d * 40 * 1024 ))
+done
+nfiles=$(find src -type f | wc -l)
+
+check "$VOLGEN" -w 1,2 -S next,ffd,local src > whatif.out
+
+col() {
+    grep -E "^$1 +$2 " whatif.out | awk "{ print \$$3 }"
+}
+
+# spans of every directory below the root, counted from the volumes made
+spans() {
+    for vol in "$1"/Volume_[0-9]*; do
+        ( cd "$vol" && find . -type f ) | sed "s|^\./||; s|^|${vol##*/} |"
+    done | awk '{ n = split($2, p, "/"); d = "";
+                  for ( i = 1; i < n; i++ ) { d = d "/" p[i]; seen[d, $1] = 1 } }
+                END { for ( k in seen ) { split(k, q, SUBSEP); c[q[1]]++ }
+                      for ( d in c ) s += c[d] - 1; print s + 0 }'
+}
+
+for sz in 1 2; do
+    [ "$(col $sz local 7)" -le "$(col $sz next 7)" ] || fail "$sz Mb: local spans more than next"
+    [ "$(col $sz local 7)" -le "$(col $sz ffd 7)" ]  || fail "$sz Mb: local spans more than ffd"
+    [ "$(col $sz local 3)" -le "$(col $sz next 3)" ] || fail "$sz Mb: local uses more volumes than next"
+
+    for st in next local; do
+        rm -rf meta
+        "$VOLGEN" -s $sz -S $st -l hardlink -a "$PWD/meta" src > gen.log 2>&1 || fail "$sz Mb $st run failed"
+        [ "$(volumes meta)" == "$(col $sz $st 3)" ] || fail "$sz Mb $st: volume count differs from what-if"
+        n=$(find meta/Volume_[0-9]* -type f | wc -l)
+        [ "$n" -eq "$nfiles" ] || fail "$sz Mb $st: $n of $nfiles files placed"
+        [ "$(spans meta)" == "$(col $sz $st 7)" ] || fail "$sz Mb $st: $(spans meta) spans, what-if has $(col $sz $st 7)"
+    done
+done
+
+exit 0
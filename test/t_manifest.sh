@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+#
+#  Manifests record the digest of each file, and symlinks, to files
+#  or directories, by their target without following them.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+
+check "$VOLGEN" -m -a "$PWD/meta" src
+
+mf=meta/Volume_01.manifest
+[ -f $mf ] || fail "no manifest written"
+head -1 $mf | grep -q "^# volgen manifest v1" || fail "bad manifest header"
+
+sum=$(sha256sum src/a/b/small2 | cut -d' ' -f1)
+grep -qP "^$sum\t2000\t[0-9]+\ta/b/small2$" $mf || fail "digest of a/b/small2 not recorded"
+
+grep -qP "^-\t0\t[0-9]+\ta/filelink\tsmall1$" $mf || fail "file link not recorded by target"
+grep -qP "^-\t0\t[0-9]+\ta/dirlink\t../d$" $mf || fail "directory link not recorded by target"
+
+nfiles=$(find src -type f -o -type l | wc -l)
+nlines=$(( $(wc -l < $mf) - 1 ))
+[ $nfiles -eq $nlines ] || fail "$nlines entries for $nfiles files"
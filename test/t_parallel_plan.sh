@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+#
+#  Oversized subtrees are planned in parallel, yet the plan does not
+#  depend on the number of threads.
+#
+source "$TESTDIR/common.sh"
+
+for a in 1 2 3; do
+    for b in 1 2 3; do
+        for f in 1 2 3; do
+            mkfile src/top$a/mid$b/f$f $(( (a * 7 + b * 5 + f * 3) * 23 * 1024 ))
+        done
+        mkfile src/top$a/mid$b/leaf/small $(( a * b * 1000 ))
+    done
+done
+
+plan() {
+    "$VOLGEN" -s 1 -t $1 -D -L src | sed -n '/^Number of volumes/,$p'
+}
+
+plan 1 > plan1.out
+[ $(sed -n 's/^Number of volumes = //p' plan1.out) -ge 4 ] || fail "too few volumes to split subtrees"
+
+for t in 2 3 8; do
+    cmp plan1.out <(plan $t) || fail "plan with $t threads differs from one thread"
+done
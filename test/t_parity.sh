@@ -0,0 +1,40 @@
+#!/usr/bin/env bash
+#
+#  Parity round trip: a volume deleted from the media is rebuilt from
+#  the remaining volumes and the parity files, identical to its files.
+#
+source "$TESTDIR/common.sh"
+
+for d in 1 2 3 4 5 6 7; do
+    mkfile src/dir$d/data $(( 900 * 1024 + d * 4099 ))
+    mkfile src/dir$d/sub/more $(( 300 * 1024 + d * 13 ))
+done
+ln -s data src/dir1/datalink
+
+check "$VOLGEN" -s 2 -P 3:2 -a "$PWD/meta" src > gen.out
+[ $(volumes meta) -ge 4 ] || fail "expected at least 4 volumes, got $(volumes meta)"
+grep -qP "\tdir1/datalink\tdata$" meta/Volume_01.manifest || fail "link not in Volume_01"
+ls meta/Parity_01_1.par meta/Parity_01_2.par > /dev/null || fail "parity files missing"
+
+# loses two volumes of the first group, as many as it has parity
+mkdir media
+cp -a meta/Volume_03 media/
+
+for vol in Volume_01 Volume_02; do
+    check "$VOLGEN" -a "$PWD/meta" --reconstruct "$PWD/out/$vol" --media "$PWD/media" $vol
+
+    tail -n +2 meta/$vol.manifest | cut -f4 | while read -r name; do
+        if [ -L "src/$name" ]; then
+            [ "$(readlink "out/$vol/$name")" == "$(readlink "src/$name")" ] \
+                || fail "$vol: link $name not restored"
+        else
+            cmp "src/$name" "out/$vol/$name" || fail "$vol: $name differs"
+        fi
+    done || exit 1
+done
+
+# too many losses are reported, not rebuilt
+rm -rf media/Volume_03
+"$VOLGEN" -a "$PWD/meta" --reconstruct "$PWD/out/bad" --media "$PWD/media" Volume_01 \
+    && fail "reconstructed with too few volumes"
+exit 0
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+#
+#  The plan places every file in exactly one volume, fills no volume
+#  past its size, and is the same from one run to the next.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+for d in 1 2 3; do
+    for f in 1 2 3 4; do
+        mkfile src/deep$d/x/y/f$f $(( (d * 150 + f * 90) * 1024 ))
+    done
+done
+
+check "$VOLGEN" -s 2 -D -L src > plan1.out
+check "$VOLGEN" -s 2 -D -L src > plan2.out
+cmp <(sed -n '/^Number of volumes/,$p' plan1.out) <(sed -n '/^Number of volumes/,$p' plan2.out) \
+    || fail "plans differ between runs"
+
+nvols=$(sed -n 's/^Number of volumes = //p' plan1.out)
+[ "$nvols" -ge 3 ] || fail "expected at least 3 volumes, got $nvols"
+
+grep "^Volume_" plan1.out | awk -F' : ' '{ sub(/%/, "", $3); if ( $3 + 0 > 100 ) exit 1 }' \
+    || fail "a volume is filled past its size"
+
+check "$VOLGEN" -s 2 -m -a "$PWD/meta" src > gen.out
+[ $(volumes meta) -eq "$nvols" ] || fail "$(volumes meta) volumes generated for $nvols planned"
+
+# each file is in exactly one volume manifest
+cat meta/Volume_*.manifest | grep -v '^#' | cut -f4 | sort > planned
+(cd src && find . -type f -o -type l | sed 's|^\./||' | sort) > files
+cmp planned files || fail "files not planned exactly once: $(diff planned files | head -5)"
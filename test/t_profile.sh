@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+#
+#  --profile counts every call the scan makes, and lists the directories
+#  taking the most time of their own, without changing the plan.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+for i in 1 2 3 4 5 6; do
+    mkfile src/wide/w$i/f 100
+done
+
+"$VOLGEN" -L -p -T 3 -s 1 src > prof.out 2>&1 || fail "profiled run failed"
+
+ndirs=$(find src -type d | wc -l)
+nents=$(find src -mindepth 1 | wc -l)
+
+calls() {
+    awk -v c="$1" '$1 == c { print $2 }' prof.out
+}
+
+grep -q "^VolGen: Scanned $ndirs directories in " prof.out || fail "scan summary: $(grep Scanned prof.out)"
+[ "$(calls opendir)" == "$ndirs" ]                 || fail "opendir count $(calls opendir) for $ndirs dirs"
+[ "$(calls lstat)" == "$nents" ]                   || fail "lstat count $(calls lstat) for $nents entries"
+[ "$(calls stat)" == "$nents" ]                    || fail "stat count $(calls stat) for $nents entries"
+# '.', '..' and the end of each directory
+[ "$(calls readdir)" == "$(( nents + 3 * ndirs ))" ] || fail "readdir count $(calls readdir)"
+
+# percentiles never decrease along a row
+awk '$1 ~ /^(opendir|readdir|lstat|stat)$/ {
+         for ( i = 4; i < 8; i++ ) if ( $i + 0 > $(i + 1) + 0 ) exit 1 }' prof.out \
+    || fail "percentiles out of order"
+
+# the directory table, most time of its own first, limited by --top
+sed -n '/^Self (ms)/,/^$/p' prof.out | grep "^[0-9]" > top.out
+[ $(wc -l < top.out) -eq 3 ] || fail "expected 3 directories: $(cat top.out)"
+sort -k1,1 -g -r -s top.out | cmp - top.out || fail "directories not sorted by self time"
+while read -r self subtree entries dir; do
+    [ -d "$dir" ] && [[ "$dir" == "$PWD/src"* ]] || fail "not a scanned directory: $dir"
+    [ "$entries" == "$(ls -A "$dir" | wc -l)" ] || fail "$dir: $entries entries"
+    awk -v s="$self" -v t="$subtree" 'BEGIN { exit !(s <= t) }' || fail "$dir: self exceeds subtree"
+done < top.out
+
+cmp <("$VOLGEN" -L -s 1 src | sed -n '/^Number of volumes/,$p') \
+    <(sed -n '/^Number of volumes/,$p' prof.out) || fail "profiling changed the plan"
+
+exit 0
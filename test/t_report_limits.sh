@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+#
+#  --max-depth and --top limit the directories reported, not the
+#  totals of the tree or the plan.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+mkfile src/big/f1 $(( 2 * 1024 * 1024 ))
+mkfile src/a/b/c/d/deep 1000
+
+dirs() {
+    "$VOLGEN" -L -F ndjson "$@" src | grep '"record":"dir"' | sed 's/.*"name":"\([^"]*\)".*/\1/' | sort | tr '\n' ' '
+}
+
+full=$(dirs)
+[ "$full" == ". a a/b a/b/c a/b/c/d big d e " ] || fail "full tree: '$full'"
+
+[ "$(dirs -X 0)" == ". " ]                      || fail "depth 0: '$(dirs -X 0)'"
+[ "$(dirs -X 1)" == ". a big d e " ]            || fail "depth 1: '$(dirs -X 1)'"
+[ "$(dirs -X 2)" == ". a a/b big d e " ]        || fail "depth 2: '$(dirs -X 2)'"
+[ "$(dirs -T 3)" == ". a big " ]                || fail "top 3: '$(dirs -T 3)'"
+[ "$(dirs -T 2 -X 1)" == ". big " ]             || fail "top 2 depth 1: '$(dirs -T 2 -X 1)'"
+
+# the root still totals the whole tree
+root=$("$VOLGEN" -L -F ndjson -X 0 src | grep '"name":"\."')
+echo "$root" | grep -q '"dirs":8,"files":24' || fail "root totals changed: $root"
+
+cmp <("$VOLGEN" -L -s 1 src | sed -n '/^Number of volumes/,$p') \
+    <("$VOLGEN" -L -s 1 -T 1 -X 0 src | sed -n '/^Number of volumes/,$p') \
+    || fail "report limits changed the plan"
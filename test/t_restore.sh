@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+#
+#  --restore rebuilds the tree from volume directories or tar images,
+#  bundles and symlinks included, and fails when a volume is missing.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+mkfile src/big/f 700000
+
+mkdir img
+"$VOLGEN" -s 1 -b 4 -a "$PWD/meta" -I "$PWD/img" src > gen.log 2>&1 || fail "symlink run failed"
+"$VOLGEN" -s 1 -b 4 -l hardlink -a "$PWD/hard" src > hard.log 2>&1 || fail "hardlink run failed"
+nvol=$(volumes meta)
+nfiles=$(find src -type f -o -type l | wc -l)
+
+restore() {
+    local out=$1
+    shift
+    "$VOLGEN" -a "$PWD/meta" -x "$PWD/$out" "$@" > "$out.log" 2>&1
+}
+
+# from each kind of media: symlinked volumes, copied volumes, images
+mkdir media
+cp -a hard/Volume_[0-9]* media/
+restore out1 -M "$PWD/meta" || fail "restore from volumes: $(tail -3 out1.log)"
+restore out2 -M "$PWD/media" || fail "restore from copied volumes: $(tail -3 out2.log)"
+restore out3 -M "$PWD/img" -n 2 || fail "restore from images: $(tail -3 out3.log)"
+
+for out in out1 out2 out3; do
+    grep -q "^volgen: Restored $nfiles file(s), .* : 0 error(s), 0 on missing volumes" $out.log \
+        || fail "$out: $(tail -1 $out.log)"
+    diff -r --no-dereference src $out || fail "$out differs from the source"
+done
+[ $(grep -c "^Restored Volume_[0-9]* from $PWD/img/Volume_[0-9]*.tar" out3.log) -eq "$nvol" ] \
+    || fail "not every image restored from"
+
+# selected paths only
+restore out4 -M "$PWD/img" 'a/b/c/*' d/small1 || fail "selective restore: $(tail -3 out4.log)"
+[ "$(cd out4 && find . -type f | sort | tr '\n' ' ')" == \
+  "./a/b/c/large ./a/b/c/small1 ./a/b/c/small2 ./a/b/c/small3 ./d/small1 " ] \
+    || fail "selective restore gave $(cd out4 && find . -type f)"
+cmp src/d/small1 out4/d/small1 || fail "selected file differs"
+
+# a missing volume restores the rest and fails
+last=$(ls -d media/Volume_[0-9]* | tail -1)
+rm -rf "$last"
+restore out5 -M "$PWD/media" && fail "missing volume not reported"
+grep -q "^VolRestore: ${last##*/} not found in the media, [1-9][0-9]* file(s) not restored" out5.log \
+    || fail "$(head -1 out5.log)"
+grep -q " 0 error(s), [1-9][0-9]* on missing volumes" out5.log || fail "$(tail -1 out5.log)"
+
+exit 0
@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+#
+#  The restore index maps each file to its volume, and bundle offset,
+#  so --restore-plan lists just the volumes holding the given paths.
+#
+source "$TESTDIR/common.sh"
+
+for f in 1 2 3 4; do
+    mkfile src/big/f$f $(( 700 * 1024 ))
+done
+for f in $(seq 1 20); do
+    mkfile src/small/s$f 300
+done
+
+check "$VOLGEN" -s 2 -b 8 -a "$PWD/meta" src > gen.out
+[ -f meta/volgen.index ] || fail "no restore index written"
+
+# a file is listed under the one volume it was staged to
+check "$VOLGEN" -a "$PWD/meta" -D -R big/f3 > plan.out
+vol=$(grep "^Volume_" plan.out | cut -d' ' -f1)
+[ $(grep -c "^Volume_" plan.out) -eq 1 ] || fail "one volume expected for big/f3"
+[ -e "meta/$vol/big/f3" ] || fail "big/f3 is not in $vol"
+
+# bundled files carry the offset of their data in the bundle
+check "$VOLGEN" -a "$PWD/meta" -D -R "$PWD/src/small/s1*" > plan.out
+[ $(grep -c "small/s1.* (bundle @[0-9]*)" plan.out) -eq 11 ] || fail "bundled files not listed: $(cat plan.out)"
+
+off=$(grep "small/s12 " plan.out | sed 's/.*@\([0-9]*\))/\1/')
+vol=$(grep "^Volume_" plan.out | cut -d' ' -f1)
+cmp <(tail -c +$(( off + 1 )) meta/$vol/small/.volgen_bundle.tar | head -c 300) src/small/s12 \
+    || fail "bundle offset of small/s12 is wrong"
+
+# queries from stdin, a whole directory, summed over the volumes
+printf 'big\nsmall/s2\n' | "$VOLGEN" -a "$PWD/meta" -R - > plan.out || fail "stdin query failed"
+grep -q "5 file(s), 2 Mb" plan.out || fail "wrong totals: $(tail -1 plan.out)"
+
+"$VOLGEN" -a "$PWD/meta" -R big/nothing > plan.out && fail "no match not reported"
+grep -q "No match for 'big/nothing'" plan.out || fail "no match message missing"
+exit 0
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+#
+#  A directory that cannot be read is skipped, and it and its parents
+#  are left out of the checkpoint, so --resume reads them again and
+#  then plans as a full scan does.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+p=src/deep
+for i in $(seq 1 30); do
+    p=$p/l$i
+done
+mkfile "$p/f" 1000
+mkfile src/deep/l1/g 5000
+
+"$VOLGEN" -L -s 1 src > full.out 2>&1 || fail "full scan failed"
+"$VOLGEN" -s 1 -a "$PWD/fresh" src > /dev/null 2>&1 || fail "fresh run failed"
+
+# a listing resumed from an unusable checkpoint keeps the one it writes;
+# each open directory holds a descriptor, so the deep branch runs out
+mkdir meta
+touch meta/volgen.ckpt
+( ulimit -n 16; "$VOLGEN" -C -L -s 1 -a "$PWD/meta" src > part.out 2>&1 ) \
+    || fail "scan stopped at an unreadable directory: $(tail -3 part.out)"
+grep -q "^opendir() failed for '.*/deep/l1/.*' : Too many open files" part.out \
+    || fail "no opendir error: $(tail -3 part.out)"
+grep -q "^Number of volumes = " part.out || fail "no plan without the unreadable directory"
+
+ckpt=meta/volgen.ckpt
+grep -qP "^D\t.*\t$PWD/src/a/b/c$" "$ckpt" || fail "completed subtree not recorded"
+grep -qP "^D\t.*/src/deep(/|$)" "$ckpt" && fail "unread subtree marked complete"
+grep -qP "^D\t.*\t$PWD/src$" "$ckpt" && fail "root marked complete"
+grep -q "^T$" "$ckpt" && fail "scan marked finished"
+
+"$VOLGEN" -C -s 1 -a "$PWD/meta" src > resume.out 2>&1 || fail "resume failed: $(tail -3 resume.out)"
+grep -q "^Resuming from checkpoint .*: 5 directories completed" resume.out \
+    || fail "resumed $(grep Resuming resume.out)"
+
+cmp <(sed -n '/^Number of volumes/,/^$/p' full.out) <(sed -n '/^Number of volumes/,/^$/p' resume.out) \
+    || fail "resumed plan differs from a full scan"
+diff -r --no-dereference fresh meta || fail "resumed volumes differ from a fresh run"
+[ -f "$ckpt" ] && fail "checkpoint left after a completed run"
+
+exit 0
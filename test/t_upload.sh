@@ -0,0 +1,97 @@
+#!/usr/bin/env bash
+#
+#  Images uploaded to an s3:// target, through test/s3stub.py, match
+#  the images written to disk, in parts of VOLGEN_UPLOAD_PARTSZ, and
+#  encrypted uploads decrypt back to the source. Parts failed once are
+#  sent again, and an upload cut off midway is resumed by the next run.
+#
+source "$TESTDIR/common.sh"
+
+command -v python3 > /dev/null || skip "python3 is required"
+
+partsz=$(( 16 * 1024 * 1024 ))
+
+# starts the stub on <root> with the given mode
+startstub() {
+    local root=$1
+    shift
+    rm -f "$root/.port"
+    python3 "$TESTDIR/s3stub.py" "$root" "$@" > stub.log 2>&1 &
+    stub=$!
+    for i in $(seq 1 50); do
+        [ -f "$root/.port" ] && break
+        sleep 0.1
+    done
+    [ -f "$root/.port" ] || fail "s3stub did not start: $(cat stub.log)"
+    export AWS_ENDPOINT_URL="http://127.0.0.1:$(cat "$root/.port")"
+}
+
+trap 'kill $stub 2> /dev/null' EXIT
+startstub "$PWD/s3"
+
+export AWS_ACCESS_KEY_ID=testkey
+export AWS_SECRET_ACCESS_KEY=testsecret
+
+mktree src
+mkfile src/big/f $(( 36 * 1024 * 1024 ))
+
+mkdir img
+"$VOLGEN" -s 40 -a "$PWD/meta1" -I "$PWD/img" src > disk.log 2>&1 || fail "disk run failed"
+"$VOLGEN" -s 40 -a "$PWD/meta2" -I s3://bucket/vols src > s3.log 2>&1 || fail "upload failed: $(tail -3 s3.log)"
+
+nvol=$(volumes meta2)
+[ "$nvol" -eq 2 ] || fail "expected 2 volumes, got $nvol"
+
+for img in img/*.tar; do
+    name=${img##*/}
+    obj=s3/bucket/vols/$name
+    cmp "$img" "$obj" || fail "$obj differs from $img"
+
+    size=$(stat -c %s "$img")
+    nparts=$(( (size + partsz - 1) / partsz ))
+    parts=$(grep "^bucket/vols/$name " s3/.parts | cut -d' ' -f2-)
+    set -- $parts
+    [ $# -eq "$nparts" ] || fail "$name: $# parts for $size bytes"
+    for (( p = 1; p < $#; p++ )); do
+        [ "${!p}" -eq "$partsz" ] || fail "$name: part $p of ${!p} bytes"
+    done
+    grep -q "^Uploaded ${name%.tar} to s3://bucket/vols/$name (.*, $nparts parts)" s3.log \
+        || fail "$name: upload not reported"
+done
+
+# encrypted images are uploaded sealed
+head -c 32 /dev/urandom > key
+"$VOLGEN" -s 40 -a "$PWD/meta3" -I s3://bucket/enc -k "$PWD/key" src > enc.log 2>&1 \
+    || fail "encrypted upload failed: $(tail -3 enc.log)"
+mkdir out
+for obj in s3/bucket/enc/*.tar.vgc; do
+    ( cd out && "$VOLGEN" --key ../key --decrypt "../$obj" ) > dec.log 2>&1 || fail "decrypt $obj: $(cat dec.log)"
+done
+diff -r --no-dereference src out || fail "decrypted uploads differ from the source"
+kill $stub
+
+# each part is refused once with a 503 and signed afresh when sent again
+startstub "$PWD/s3retry" fail-once
+"$VOLGEN" -s 40 -a "$PWD/meta4" -I s3://bucket/vols src > retry.log 2>&1 \
+    || fail "upload with retries failed: $(tail -3 retry.log)"
+for img in img/*.tar; do
+    cmp "$img" "s3retry/bucket/vols/${img##*/}" || fail "retried upload of ${img##*/} differs"
+done
+kill $stub
+
+# the stub exits after two parts, leaving the upload for the next run
+startstub "$PWD/s3cut" kill-after 2
+"$VOLGEN" -s 40 -a "$PWD/meta5" -I s3://bucket/vols src > cut.log 2>&1 \
+    && fail "upload succeeded though the stub went away"
+grep -q "is incomplete, run again to resume it" cut.log || fail "incomplete upload not reported: $(tail -3 cut.log)"
+
+startstub "$PWD/s3cut"
+"$VOLGEN" -s 40 -a "$PWD/meta6" -I s3://bucket/vols src > resume.log 2>&1 \
+    || fail "resumed upload failed: $(tail -3 resume.log)"
+grep -q "^Resuming upload of s3://bucket/vols/" resume.log || fail "upload not resumed"
+grep -q "^Uploaded .*, [1-9][0-9]* resumed)" resume.log || fail "no parts reused"
+for img in img/*.tar; do
+    cmp "$img" "s3cut/bucket/vols/${img##*/}" || fail "resumed upload of ${img##*/} differs"
+done
+
+exit 0
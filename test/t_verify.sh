@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+#
+#  Verify passes on an intact copy of a volume and reports files that
+#  are changed, resized, missing or relinked, read from a mounted
+#  volume or straight from a tar image.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+
+check "$VOLGEN" -m -l hardlink -a "$PWD/meta" src
+cp -a meta/Volume_01 media
+
+check "$VOLGEN" -a "$PWD/meta" --verify "$PWD/media" Volume_01 > verify.out
+grep -q "0 missing, 0 size, 0 mismatch, 0 error" verify.out || fail "intact volume: $(tail -1 verify.out)"
+
+printf 'X' | dd of=media/a/b/small1 bs=1 seek=10 conv=notrunc 2>/dev/null
+echo "extra" >> media/d/small2
+rm media/e/large
+ln -sf small2 media/a/filelink
+
+"$VOLGEN" -a "$PWD/meta" --verify "$PWD/media" Volume_01 > verify.out && fail "verify passed a damaged volume"
+
+grep -q "MISMATCH  a/b/small1" verify.out  || fail "changed file not reported"
+grep -q "SIZE      d/small2" verify.out    || fail "resized file not reported"
+grep -q "MISSING   e/large" verify.out     || fail "missing file not reported"
+grep -q "MISMATCH  a/filelink" verify.out  || fail "relinked file not reported"
+grep -q "1 missing, 1 size, 2 mismatch" verify.out || fail "wrong totals: $(tail -1 verify.out)"
+
+# a tar image is verified by its members, without mounting it
+mkdir img
+check "$VOLGEN" -m -a "$PWD/meta2" -I "$PWD/img" src
+check "$VOLGEN" -a "$PWD/meta2" --verify "$PWD/img/Volume_01.tar" Volume_01 > image.out
+grep -q "0 missing, 0 size, 0 mismatch, 0 error" image.out || fail "intact image: $(tail -1 image.out)"
+grep -q " 0 verified" image.out && fail "nothing verified in the image"
+check "$VOLGEN" -a "$PWD/meta2" --verify "$PWD/img" Volume_01 > image.out
+
+block=$(tar -R -tf img/Volume_01.tar | sed -n 's,^block \([0-9]*\): e/large$,\1,p')
+[ -n "$block" ] || fail "e/large not found in the image"
+printf 'X' | dd of=img/Volume_01.tar bs=1 seek=$(( (block + 1) * 512 + 1000 )) conv=notrunc 2>/dev/null
+
+"$VOLGEN" -a "$PWD/meta2" --verify "$PWD/img/Volume_01.tar" Volume_01 > image.out \
+    && fail "verify passed a damaged image"
+grep -q "MISMATCH  e/large" image.out || fail "changed member not reported"
+grep -q "0 missing, 0 size, 1 mismatch" image.out || fail "wrong image totals: $(tail -1 image.out)"
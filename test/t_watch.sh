@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+#
+#  Watch mode keeps the plan file current as the tree changes, and
+#  drops the watches of a subtree moved out of it.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+mkdir -p src/foo-bar src/foo.old
+mkfile src/foo/sub/deep/file 4096
+
+"$VOLGEN" -W -a "$PWD/meta" src > watch.out 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null' EXIT
+
+# waits for the plan file to (not) mention a name
+waitplan() {
+    for i in $(seq 1 50); do
+        if grep -q "$1" meta/volgen.plan 2>/dev/null; then
+            [ -z "$2" ] && return 0
+        else
+            [ -n "$2" ] && return 0
+        fi
+        sleep 0.2
+    done
+    fail "plan file never updated for '$1' : $(cat watch.out)"
+}
+
+waitplan "^   foo :"
+mkfile src/newdir/file 4096
+waitplan "^   newdir :"
+
+mv src/foo outside
+waitplan "^   foo :" gone
+
+if ! grep -q "using fanotify" watch.out; then
+    # one inotify watch per directory left in the tree
+    wfd=$(ls -l /proc/$pid/fd | awk '/inotify/ { print $9 }')
+    [ -n "$wfd" ] || fail "no inotify descriptor"
+    nwatch=$(grep -c '^inotify' /proc/$pid/fdinfo/$wfd)
+    ndirs=$(find src -type d | wc -l)
+    [ "$nwatch" -eq "$ndirs" ] || fail "$nwatch watches for $ndirs directories"
+fi
+
+kill -TERM $pid
+wait $pid || fail "watch exited with $?"
+trap - EXIT
+grep -q "volgen finished" watch.out || fail "watch did not stop cleanly"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+#
+#  What-if planning compares sizes and strategies in one scan, each
+#  row agreeing with a plan made for that size and strategy alone.
+#
+source "$TESTDIR/common.sh"
+
+mktree src
+for f in 1 2 3 4 5 6; do
+    mkfile src/big/f$f $(( f * 250 * 1024 ))
+done
+mkfile src/huge $(( 5 * 1024 * 1024 ))
+
+check "$VOLGEN" -w 1,2,4 -S next,ffd src > whatif.out
+
+[ $(grep -cE "^[124] +(next|ffd) " whatif.out) -eq 6 ] || fail "expected 6 rows: $(cat whatif.out)"
+[ -d .volgen ] && fail "what-if generated volumes"
+
+for sz in 1 2 4; do
+    for st in next ffd; do
+        row=$(grep -E "^$sz +$st " whatif.out)
+        nvols=$(echo "$row" | awk '{ print $3 }')
+        skipped=$(echo "$row" | awk '{ print $NF }')
+        "$VOLGEN" -s $sz -S $st -L src > plan.out 2>&1
+        plan=$(sed -n 's/^Number of volumes = //p' plan.out)
+        [ "$nvols" == "$plan" ] || fail "$sz Mb $st: $nvols volumes, plan has $plan"
+        nskip=$(grep -c "larger than volume size" plan.out)
+        [ "$skipped" -eq "$nskip" ] || fail "$sz Mb $st: $skipped skipped, plan skips $nskip"
+        [ "$skipped" -ge 1 ] || fail "$sz Mb $st: the 5 Mb file was not skipped"
+    done
+done
+
+"$VOLGEN" -w 1,x src | grep -q "Invalid size list '1,x'" || fail "invalid size list accepted"